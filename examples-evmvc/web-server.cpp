@@ -37,6 +37,9 @@ extern "C" {
 #include <unistd.h>
 
 #include "examples_views.h"
+#if EVMVC_FANJET_HOT_RELOAD
+#include "evmvc/fanjet/fan_hot_reload.h"
+#endif
 
 void _on_event_log(int severity, const char *msg)
 {
@@ -193,6 +196,17 @@ void register_app_cbs()
     // register fanjet views
     examples::register_engine();
     
+#if EVMVC_FANJET_HOT_RELOAD
+    // recompile the views on change
+    evmvc::fanjet::hot_reload_options hro;
+    hro.ns = "examples";
+    hro.src_dir = EVMVC_EXAMPLES_VIEWS_DIR;
+    hro.markup_langs = {"tex", "latex", "md", "markdown"};
+    hro.cxx_flags = EVMVC_EXAMPLES_HOT_RELOAD_FLAGS;
+    hro.fanjet = EVMVC_EXAMPLES_FANJET;
+    evmvc::fanjet::hot_reload(srv, hro);
+#endif
+    
     
     srv->get("/views/missing",
     [](const evmvc::request req, evmvc::response res, auto nxt){
@@ -224,6 +238,9 @@ void register_app_cbs()
     });
     
     
+    // prometheus metrics of the workers
+    srv->get("/metrics", evmvc::metrics_handler);
+    
     srv->get("/test",
     [](const evmvc::request req, evmvc::response res, auto nxt){
         res->status(evmvc::status::ok).send(
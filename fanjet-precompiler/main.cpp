@@ -24,30 +24,63 @@ SOFTWARE.
 
 #include <string>
 #include <iostream>
+#include <thread>
+#include <atomic>
 #include <boost/program_options.hpp>
 #include <evmvc/fanjet/fanjet.h>
 
 namespace po = boost::program_options;
 namespace bfs = boost::filesystem;
 
+struct fanjet_file
+{
+    bfs::path src;
+    std::string filename;
+    std::string view_path;
+    std::string fan_src;
+    std::string hash;
+    std::vector<std::string> deps;
+    bool changed;
+};
+
 void march_dir(
+    std::vector<fanjet_file>& files,
+    const bfs::path& src
+);
+
+void load_files(
+    std::vector<fanjet_file>& files,
+    const bfs::path& root
+);
+
+evmvc::json load_manifest(
+    const bfs::path& fn,
+    const std::string& opts
+);
+
+size_t diff_manifest(
+    std::vector<fanjet_file>& files,
+    const evmvc::json& manifest,
+    const bfs::path& dest
+);
+
+void parse_files(
+    size_t jobs,
     bool dbg,
+    bool split,
     const std::vector<std::string>& markup_langs,
     std::vector<evmvc::fanjet::ast::document>& docs,
-    const bfs::path& root,
-    const std::string& ns,
-    const bfs::path& src,
-    const bfs::path& dest
+    std::vector<fanjet_file>& files,
+    const evmvc::json& manifest,
+    const std::string& ns
 );
 
-void process_fanjet_file(
+evmvc::fanjet::ast::document process_fanjet_file(
     bool dbg,
+    bool split,
     const std::vector<std::string>& markup_langs,
-    std::vector<evmvc::fanjet::ast::document>& docs,
-    const bfs::path& root,
     const std::string& ns,
-    const bfs::path& src,
-    const bfs::path& dest
+    const fanjet_file& file
 );
 
 void save_docs(
@@ -57,6 +90,26 @@ void save_docs(
     const bfs::path& dest
 );
 
+void save_manifest(
+    const bfs::path& fn,
+    const std::string& opts,
+    std::vector<evmvc::fanjet::ast::document>& docs,
+    std::vector<fanjet_file>& files
+);
+
+void save_sources(
+    const bfs::path& fn,
+    const std::vector<evmvc::fanjet::ast::document>& docs
+);
+
+bool write_if_changed(const bfs::path& fn, const std::string& src);
+
+void bench_files(
+    size_t rounds,
+    const std::vector<std::string>& markup_langs,
+    const std::vector<fanjet_file>& files
+);
+
 md::log::logger& log()
 {
     static md::log::logger l = nullptr;
@@ -99,6 +152,19 @@ int main(int argc, char** argv)
         po::value<std::string>()->required(),
         "views precompiled destination directory."
     )
+    ("split",
+        "generate one translation unit per view, "
+        "the include only declares their registration."
+    )
+    ("jobs,j",
+        po::value<size_t>()->default_value(0),
+        "number of parsing threads, defaults to the number of cores."
+    )
+    ("bench",
+        po::value<size_t>(),
+        "tokenize and parse the views n times and report the timings, "
+        "nothing is generated."
+    )
     ;
     
     po::positional_options_description p;
@@ -181,39 +247,57 @@ int main(int argc, char** argv)
             bfs::create_directories(dest);
         
         dbg = vm.count("debug") > 0;
+        bool split = vm.count("split") > 0;
+        size_t jobs = vm["jobs"].as<size_t>();
+        if(jobs == 0)
+            jobs = std::max(1u, std::thread::hardware_concurrency());
+        
+        std::string ns = vm["namespace"].as<std::string>();
+        std::string opts = fmt::format(
+            "{}|{}|{}|{}", ns, dbg, split, md::join(langs, ",")
+        );
+        bfs::path manifest_fn =
+            dest / (vm["include"].as<std::string>() + ".deps.json");
+        
+        std::vector<fanjet_file> files;
+        march_dir(files, vm["src"].as<std::string>());
+        load_files(files, vm["src"].as<std::string>());
+        
+        if(vm.count("bench")){
+            bench_files(vm["bench"].as<size_t>(), langs, files);
+            return 0;
+        }
+        
+        evmvc::json manifest = load_manifest(manifest_fn, opts);
+        size_t changed = diff_manifest(files, manifest, dest);
+        log()->info("{} of {} views changed", changed, files.size());
         
         std::vector<evmvc::fanjet::ast::document> docs;
-        march_dir(
-            dbg,
-            langs,
-            docs,
-            vm["src"].as<std::string>(),
-            vm["namespace"].as<std::string>(),
-            vm["src"].as<std::string>(),
-            vm["dest"].as<std::string>()
-        );
+        parse_files(jobs, dbg, split, langs, docs, files, manifest, ns);
         
-        auto now = std::chrono::system_clock::now();
-        std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-        auto ct = std::ctime(&now_time);
-        std::stringstream ss;
-        ss << "generated by libevmvc fanjet tool v0.1.0 on: " << ct;
-        std::string gen_notice = ss.str();
+        // no timestamp, unchanged views must generate the same output
+        std::string gen_notice = "generated by libevmvc fanjet tool v0.1.0\n";
         
         std::string include_src;
         evmvc::fanjet::parser::generate_code(
             gen_notice,
             include_src,
-            vm["namespace"].as<std::string>(),
+            ns,
             docs,
-            dbg
+            dbg,
+            split
         );
         
         save_docs(
             vm["include"].as<std::string>(),
             include_src,
             docs,
-            vm["dest"].as<std::string>()
+            dest
+        );
+        save_manifest(manifest_fn, opts, docs, files);
+        if(split)
+            save_sources(
+                dest / (vm["include"].as<std::string>() + ".mk"), docs
             );
         
         return 0;
@@ -261,38 +345,20 @@ int main(int argc, char** argv)
 
 
 void march_dir(
-    bool dbg,
-    const std::vector<std::string>& markup_langs,
-    std::vector<evmvc::fanjet::ast::document>& docs,
-    const bfs::path& root,
-    const std::string& ns,
-    const bfs::path& src,
-    const bfs::path& dest)
+    std::vector<fanjet_file>& files,
+    const bfs::path& src)
 {
     for(bfs::directory_entry& x : bfs::directory_iterator(src)){
         switch(x.status().type()){
             case bfs::file_type::directory_file:
-                march_dir(
-                    dbg,
-                    markup_langs,
-                    docs,
-                    root,
-                    ns,
-                    x.path(),
-                    dest
-                );
+                march_dir(files, x.path());
                 break;
                 
             case bfs::file_type::regular_file:
-                process_fanjet_file(
-                    dbg,
-                    markup_langs,
-                    docs,
-                    root,
-                    ns,
-                    x.path(),
-                    dest
-                );
+                if(x.path().extension() != ".fan")
+                    break;
+                files.emplace_back();
+                files.back().src = x.path();
                 break;
                 
             default:
@@ -303,73 +369,220 @@ void march_dir(
     }
 }
 
-void process_fanjet_file(
-    bool dbg,
-    const std::vector<std::string>& markup_langs,
-    std::vector<evmvc::fanjet::ast::document>& docs,
-    const bfs::path& root,
-    const std::string& ns,
-    const bfs::path& src,
-    const bfs::path& dest)
+void load_files(
+    std::vector<fanjet_file>& files,
+    const bfs::path& root)
 {
-    try{
-        log()->debug("parsing source: '{}'", src.string());
-        
-        if(src.extension() != ".fan")
-            return;
-        
-        bfs::ifstream fin(src);
+    // keeps the generated output stable between runs
+    std::sort(
+        files.begin(), files.end(),
+        [](const fanjet_file& a, const fanjet_file& b){
+            return a.src < b.src;
+        }
+    );
+    
+    for(auto& f : files){
+        bfs::ifstream fin(f.src);
         std::ostringstream ostrm;
         ostrm << fin.rdbuf();
-        std::string fan_src = ostrm.str();
+        f.fan_src = ostrm.str();
         fin.close();
         
-        std::string view_path = src.parent_path().string();
+        f.filename = bfs::absolute(f.src).string();
+        
+        // FNV-1a
+        uint64_t h = 14695981039346656037ULL;
+        for(unsigned char c : f.fan_src){
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        f.hash = fmt::format("{:016x}", h);
+        
+        std::string view_path = f.src.parent_path().string();
         if(view_path.size() > root.size())
             view_path = view_path.substr(root.size());
         else
             view_path = "";
         
-        // std::string view_path = 
-        //     src.parent_path().string().substr(
-        //         root.size()
-        //     );
-        if(*(view_path.crend()) != '/')
+        if(view_path.empty() || *view_path.rbegin() != '/')
             view_path += "/";
         view_path += 
-            src.filename().string().substr(
-                0, src.filename().size() - src.extension().string().size()
+            f.src.filename().string().substr(
+                0, f.src.filename().size() - f.src.extension().string().size()
             );
+        f.view_path = view_path;
+        f.changed = true;
+    }
+}
+
+evmvc::json load_manifest(
+    const bfs::path& fn,
+    const std::string& opts)
+{
+    if(!bfs::exists(fn))
+        return evmvc::json::object();
+    
+    // a new fanjet tool may generate a different output
+    boost::system::error_code ec;
+    std::time_t exe_time = bfs::last_write_time("/proc/self/exe", ec);
+    if(!ec && bfs::last_write_time(fn) < exe_time)
+        return evmvc::json::object();
+    
+    try{
+        bfs::ifstream fin(fn);
+        std::ostringstream ostrm;
+        ostrm << fin.rdbuf();
+        evmvc::json m = evmvc::json::parse(ostrm.str());
+        if(!m.is_object() || m.value("options", "") != opts ||
+            !m.count("views")
+        )
+            return evmvc::json::object();
+        return m;
+        
+    }catch(const std::exception& err){
+        log()->warn(
+            "ignoring invalid manifest '{}'\n{}", fn.string(), err.what()
+        );
+        return evmvc::json::object();
+    }
+}
+
+size_t diff_manifest(
+    std::vector<fanjet_file>& files,
+    const evmvc::json& manifest,
+    const bfs::path& dest)
+{
+    if(!manifest.count("views"))
+        return files.size();
+    
+    const evmvc::json& views = manifest.at("views");
+    // added or removed views may change how the others are resolved
+    if(views.size() != files.size())
+        return files.size();
+    
+    std::unordered_map<std::string, fanjet_file*> by_name;
+    for(auto& f : files){
+        auto it = views.find(f.filename);
+        if(it == views.end()){
+            for(auto& rf : files)
+                rf.changed = true;
+            return files.size();
+        }
+        by_name.emplace(f.filename, &f);
+        
+        if(it->at("hash").get<std::string>() != f.hash ||
+            !bfs::exists(dest / it->at("i_filename").get<std::string>()) ||
+            !bfs::exists(dest / it->at("h_filename").get<std::string>())
+        )
+            continue;
+        
+        f.deps = it->at("deps").get<std::vector<std::string>>();
+        f.changed = false;
+    }
+    
+    // views inheriting from a changed view are generated again
+    bool updated = true;
+    while(updated){
+        updated = false;
+        for(auto& f : files){
+            if(f.changed)
+                continue;
+            for(auto& d : f.deps){
+                auto it = by_name.find(d);
+                if(it == by_name.end() || it->second->changed){
+                    f.changed = true;
+                    updated = true;
+                    break;
+                }
+            }
+        }
+    }
+    
+    size_t n = 0;
+    for(auto& f : files)
+        if(f.changed)
+            ++n;
+    return n;
+}
+
+void parse_files(
+    size_t jobs,
+    bool dbg,
+    bool split,
+    const std::vector<std::string>& markup_langs,
+    std::vector<evmvc::fanjet::ast::document>& docs,
+    std::vector<fanjet_file>& files,
+    const evmvc::json& manifest,
+    const std::string& ns)
+{
+    docs.resize(files.size());
+    std::vector<std::exception_ptr> errs(files.size());
+    std::atomic<size_t> next(0);
+    
+    auto work = [&](){
+        for(size_t i = next++; i < files.size(); i = next++){
+            try{
+                if(files[i].changed)
+                    docs[i] = process_fanjet_file(
+                        dbg, split, markup_langs, ns, files[i]
+                    );
+                else
+                    docs[i] = evmvc::fanjet::parser::manifest_doc(
+                        manifest.at("views").at(files[i].filename)
+                    );
+            }catch(...){
+                errs[i] = std::current_exception();
+            }
+        }
+    };
+    
+    std::vector<std::thread> pool;
+    for(size_t i = 1; i < jobs && i < files.size(); ++i)
+        pool.emplace_back(work);
+    work();
+    for(auto& t : pool)
+        t.join();
+    
+    for(auto& err : errs)
+        if(err)
+            std::rethrow_exception(err);
+}
+
+evmvc::fanjet::ast::document process_fanjet_file(
+    bool dbg,
+    bool split,
+    const std::vector<std::string>& markup_langs,
+    const std::string& ns,
+    const fanjet_file& file)
+{
+    try{
+        log()->debug("parsing source: '{}'", file.src.string());
         
         evmvc::fanjet::ast::document doc = 
             evmvc::fanjet::parser::generate_doc(
-                src,
+                file.src,
                 ns,
-                view_path,
+                file.view_path,
                 markup_langs,
-                fan_src,
+                file.fan_src,
                 dbg
             );
         
-        bfs::path dest_fn = dest / doc->i_filename;
-        if(bfs::exists(dest_fn)){
-            struct stat src_stat;
-            stat(src.c_str(), &src_stat);
-            struct stat dest_stat;
-            stat(dest_fn.c_str(), &dest_stat);
-            
-            if(std::difftime(src_stat.st_mtime, dest_stat.st_mtime) < 0)
-                doc->skip_gen = true;
-        }
+        // named after the source file to be known by the build system
+        if(split)
+            doc->c_filename = evmvc::fanjet::ast::norm_vname(
+                file.view_path.substr(file.view_path[0] == '/' ? 1 : 0) +
+                ".fan", "-"
+            ) + ".cpp";
         
-        docs.emplace_back(doc);
+        return doc;
         
     }catch(const md::error::stacked_error& serr){
         log()->error(
             "{}\n\n{}\n\n{}\n{}:{}\n\n"
             "Usage: fanjet [options] src-path dest-path",
             serr.what(),
-            src.string(),
+            file.src.string(),
             serr.func(), serr.file(), serr.line()
         );
         throw -1;
@@ -377,7 +590,7 @@ void process_fanjet_file(
     }catch(const std::exception& error){
         std::string err_msg = fmt::format(
             "{}\nsrc: {}",
-            error.what(), src.string()
+            error.what(), file.src.string()
         );
         
         throw MD_ERR(err_msg);
@@ -393,39 +606,106 @@ void save_docs(
     if(!bfs::exists(dest))
         bfs::create_directories(dest);
     
-    bfs::path fn = dest / include_filename;
-    if(bfs::exists(fn))
-        bfs::remove(fn);
-    bfs::ofstream fout(fn);
-    fout << include_src;
-    fout.close();
-    
+    size_t n = write_if_changed(dest / include_filename, include_src);
     for(auto d : docs){
-        if(d->skip_gen)
-            continue;
-        
-        fn = dest / d->i_filename;
-        if(bfs::exists(fn))
-            bfs::remove(fn);
-        fout.open(fn);
-        fout << d->i_src;
-        fout.close();
-        
-        fn = dest / d->h_filename;
-        if(bfs::exists(fn))
-            bfs::remove(fn);
-        fout.open(fn);
-        fout << d->h_src;
-        fout.close();
-        
-        fn = dest / d->c_filename;
-        if(bfs::exists(fn))
-            bfs::remove(fn);
-        if(!d->c_src.empty()){
-            fout.open(fn);
-            fout << d->h_src;
-            fout.close();
+        if(!d->skip_gen){
+            n += write_if_changed(dest / d->i_filename, d->i_src);
+            n += write_if_changed(dest / d->h_filename, d->h_src);
+        }
+        if(!d->c_src.empty())
+            n += write_if_changed(dest / d->c_filename, d->c_src);
+    }
+    log()->info("{} files updated", n);
+}
+
+void save_manifest(
+    const bfs::path& fn,
+    const std::string& opts,
+    std::vector<evmvc::fanjet::ast::document>& docs,
+    std::vector<fanjet_file>& files)
+{
+    evmvc::json views = evmvc::json::object();
+    for(size_t i = 0; i < docs.size(); ++i){
+        auto doc = docs[i];
+        auto& f = files[i];
+        if(f.changed){
+            f.deps.clear();
+            for(auto ii : doc->inherits_items)
+                f.deps.emplace_back(
+                    evmvc::fanjet::ast::find(docs, doc, ii->path)->filename
+                );
         }
         
+        evmvc::json e = evmvc::fanjet::parser::manifest_entry(doc);
+        e["hash"] = f.hash;
+        e["deps"] = f.deps;
+        views[f.filename] = e;
     }
+    
+    // always rewritten, its time is compared with the fanjet tool
+    bfs::ofstream fout(fn, std::ios::trunc);
+    fout << evmvc::json{{"options", opts}, {"views", views}}.dump(1);
+    fout.close();
+}
+
+void save_sources(
+    const bfs::path& fn,
+    const std::vector<evmvc::fanjet::ast::document>& docs)
+{
+    // the translation units to build, as a make variable
+    std::string src = "FANJET_SOURCES :=";
+    for(auto d : docs)
+        src += " \\\n    " + d->c_filename;
+    src += "\n";
+    write_if_changed(fn, src);
+}
+
+bool write_if_changed(const bfs::path& fn, const std::string& src)
+{
+    if(bfs::exists(fn) && bfs::file_size(fn) == src.size()){
+        bfs::ifstream fin(fn, std::ios::binary);
+        std::ostringstream ostrm;
+        ostrm << fin.rdbuf();
+        if(ostrm.str() == src)
+            return false;
+    }
+    
+    bfs::ofstream fout(fn, std::ios::binary | std::ios::trunc);
+    fout << src;
+    fout.close();
+    return true;
+}
+
+void bench_files(
+    size_t rounds,
+    const std::vector<std::string>& markup_langs,
+    const std::vector<fanjet_file>& files)
+{
+    size_t bytes = 0;
+    for(auto& f : files)
+        bytes += f.fan_src.size();
+    
+    auto run = [&](const char* name, std::function<void(const std::string&)> fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for(size_t r = 0; r < rounds; ++r)
+            for(auto& f : files)
+                fn(f.fan_src);
+        double secs = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+        
+        std::cout << fmt::format(
+            "{:<10} {} views x {} rounds: {:.3f}s, {:.2f} MB/s\n",
+            name, files.size(), rounds, secs,
+            secs > 0 ? (bytes * rounds) / secs / 1048576 : 0
+        );
+    };
+    
+    run("tokenize", [](const std::string& src){
+        evmvc::fanjet::ast::tokenizer::tokenize(src);
+    });
+    run("parse", [&markup_langs](const std::string& src){
+        evmvc::fanjet::parser::parse(markup_langs, src);
+    });
 }
@@ -44,6 +44,16 @@ inline void send_error(
 }
 
 
+// logger of the route the request objects are attached to
+inline md::log::logger request_logger(
+    const wp_connection& conn, const route& rt)
+{
+    auto c = conn.lock();
+    return (c ? c->log() : md::log::default_logger())->add_child(
+        rt ? rt->log()->path() : md::log::default_logger()->path()
+    );
+}
+
 inline evmvc::response create_http_response(
     wp_connection conn,
     http_version ver,
@@ -58,30 +68,35 @@ inline evmvc::response create_http_response(
     static uint64_t cur_id = 0;
     uint64_t rid = ++cur_id;
     
-    md::log::logger log = c->log()->add_child(rr->log()->path());
-    evmvc::http_cookies cks = std::make_shared<evmvc::http_cookies_t>(
-        rid, log, rr->_route, uri, hdrs
+    // the request objects are allocated in the parser arena
+    const sp_request_arena& arena = c->parser()->arena();
+    
+    evmvc::http_cookies cks = std::allocate_shared<evmvc::http_cookies_t>(
+        arena_allocator<evmvc::http_cookies_t>(arena),
+        rid, conn, rr->_route, hdrs
     );
     /*
         uint64_t id,
         http_version ver,
         wp_connection conn,
-        md::log::logger log,
         const evmvc::route& rt,
         url uri,
         evmvc::method met,
         md::string_view smet,
         header_map hdrs,
         const http_cookies& http_cookies_t,
-        const std::vector<std::shared_ptr<evmvc::http_param>>& p
+        evmvc::http_params_t&& p,
+        const sp_request_arena& arena
     */
-    evmvc::request req = std::make_shared<evmvc::request_t>(
-        rid, ver, conn, log, rr->_route, uri,
+    evmvc::request req = std::allocate_shared<evmvc::request_t>(
+        arena_allocator<evmvc::request_t>(arena),
+        rid, ver, conn, rr->_route, uri,
         c->parser()->method(), c->parser()->method_string(),
-        hdrs, cks, rr->params
+        hdrs, cks, std::move(rr->params), arena
     );
-    evmvc::response res = std::make_shared<evmvc::response_t>(
-        rid, req, conn, log, rr->_route, uri, cks
+    evmvc::response res = std::allocate_shared<evmvc::response_t>(
+        arena_allocator<evmvc::response_t>(arena),
+        rid, req, conn, rr->_route, uri, cks, arena
     );
     req->_res = res;
     return res;
@@ -0,0 +1,306 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_access_log_h
+#define _libevmvc_access_log_h
+
+#include "stable_headers.h"
+#include "configuration.h"
+#include "methods.h"
+#include "log_ring.h"
+#include "cached_clock.h"
+
+// longest request path kept in an access record
+#define EVMVC_ACCESS_LOG_MAX_PATH 2048
+#define EVMVC_ACCESS_LOG_MAX_ADDR 64
+
+namespace evmvc {
+
+/*
+    fixed part of an access record, followed by the remote address
+    and the request path. The binary format writes each record as
+    its uint32 size, the int64 time in ns and the record itself.
+*/
+struct access_record
+{
+    uint64_t req_id;
+    uint64_t bytes;
+    uint64_t duration_us;
+    uint16_t status;
+    uint16_t port;
+    uint8_t method;
+    uint8_t addr_len;
+    uint16_t path_len;
+};
+
+/**
+ * Worker side, copies the record in the worker ring,
+ * returns false when the ring is full.
+ */
+inline bool write_access_record(
+    log_ring& ring, uint64_t id, evmvc::method met,
+    md::string_view addr, uint16_t port, md::string_view path,
+    int status, uint64_t bytes, uint64_t duration_us)
+{
+    char buf[
+        sizeof(access_record) +
+        EVMVC_ACCESS_LOG_MAX_ADDR + EVMVC_ACCESS_LOG_MAX_PATH
+    ];
+    
+    access_record* r = (access_record*)buf;
+    r->req_id = id;
+    r->bytes = bytes;
+    r->duration_us = duration_us;
+    r->status = (uint16_t)status;
+    r->port = port;
+    r->method = (uint8_t)met;
+    r->addr_len = (uint8_t)std::min(
+        addr.size(), (size_t)EVMVC_ACCESS_LOG_MAX_ADDR
+    );
+    r->path_len = (uint16_t)std::min(
+        path.size(), (size_t)EVMVC_ACCESS_LOG_MAX_PATH
+    );
+    
+    char* p = buf + sizeof(access_record);
+    memcpy(p, addr.data(), r->addr_len);
+    memcpy(p + r->addr_len, path.data(), r->path_len);
+    
+    return ring.write(
+        md::log::log_level::info, "",
+        md::string_view(
+            buf, sizeof(access_record) + r->addr_len + r->path_len
+        )
+    );
+}
+
+/*
+    master side of the access log, the records of every worker ring
+    are batched and written to the file on the master event loop.
+*/
+class access_log_writer
+{
+public:
+    access_log_writer(
+        const access_log_options& opts, const bfs::path& filename,
+        md::log::logger log)
+        : _opts(opts), _filename(filename), _log(log),
+        _pid(getpid()), _fd(-1), _size(0),
+        _buf(evbuffer_new()), _timer(nullptr)
+    {
+        _open();
+        
+        if(_opts.flush_ms > 0){
+            _timer = event_new(
+                global::ev_base(), -1, EV_PERSIST,
+                access_log_writer::_on_timer, this
+            );
+            timeval tv = md::date::ms_to_timeval(_opts.flush_ms);
+            event_add(_timer, &tv);
+        }
+    }
+    
+    ~access_log_writer()
+    {
+        // the forked workers inherit the writer of the master
+        if(_pid != getpid())
+            return;
+        
+        if(_timer){
+            event_del(_timer);
+            event_free(_timer);
+        }
+        flush();
+        if(_opts.sync != access_log_sync::none && _fd != -1)
+            fsync(_fd);
+        if(_fd != -1)
+            ::close(_fd);
+        evbuffer_free(_buf);
+    }
+    
+    access_log_writer(const access_log_writer&) = delete;
+    access_log_writer& operator=(const access_log_writer&) = delete;
+    
+    const bfs::path& filename() const { return _filename;}
+    
+    void append(int64_t time, md::string_view rec)
+    {
+        if(rec.size() < sizeof(access_record))
+            return;
+        
+        if(_opts.format == access_log_format::binary){
+            uint32_t size = (uint32_t)rec.size();
+            evbuffer_add(_buf, &size, sizeof(size));
+            evbuffer_add(_buf, &time, sizeof(time));
+            evbuffer_add(_buf, rec.data(), rec.size());
+        }else
+            _json(_buf, time, rec);
+        
+        if(evbuffer_get_length(_buf) >= _opts.flush_size)
+            flush();
+    }
+    
+    void flush()
+    {
+        size_t len = evbuffer_get_length(_buf);
+        if(len == 0 || _fd == -1)
+            return;
+        
+        if(_opts.max_size > 0 && _size > 0 && _size + len > _opts.max_size)
+            _rotate();
+        
+        while(evbuffer_get_length(_buf) > 0){
+            int n = evbuffer_write(_buf, _fd);
+            if(n < 0){
+                if(errno == EINTR)
+                    continue;
+                _log->error(MD_ERR(
+                    "Unable to write the access log '{}', errno: {}",
+                    _filename.string(), errno
+                ));
+                evbuffer_drain(_buf, evbuffer_get_length(_buf));
+                return;
+            }
+            _size += n;
+        }
+        
+        if(_opts.sync == access_log_sync::flush)
+            fdatasync(_fd);
+    }
+    
+    /**
+     * Renders a record as a json line,
+     * the binary records are read with the same function.
+     */
+    static std::string to_json(int64_t time, md::string_view rec)
+    {
+        evbuffer* b = evbuffer_new();
+        _json(b, time, rec);
+        std::string s(evbuffer_get_length(b), '\0');
+        evbuffer_remove(b, &s[0], s.size());
+        evbuffer_free(b);
+        return s;
+    }
+    
+private:
+    void _open()
+    {
+        _fd = ::open(
+            _filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640
+        );
+        if(_fd == -1){
+            _log->error(MD_ERR(
+                "Unable to open the access log '{}', errno: {}",
+                _filename.string(), errno
+            ));
+            return;
+        }
+        
+        struct stat st;
+        _size = fstat(_fd, &st) == 0 ? st.st_size : 0;
+    }
+    
+    void _rotate()
+    {
+        if(_opts.sync == access_log_sync::rotate)
+            fsync(_fd);
+        ::close(_fd);
+        
+        std::string fn = _filename.string();
+        if(_opts.max_files > 1){
+            for(size_t i = _opts.max_files -1; i > 0; --i){
+                std::string src = i == 1 ?
+                    fn : fn + "." + md::num_to_str(i -1, false);
+                std::string dst = fn + "." + md::num_to_str(i, false);
+                rename(src.c_str(), dst.c_str());
+            }
+        }else
+            unlink(fn.c_str());
+        
+        _open();
+    }
+    
+    static void _json(evbuffer* b, int64_t time, md::string_view rec)
+    {
+        const access_record* r = (const access_record*)rec.data();
+        const char* addr = rec.data() + sizeof(access_record);
+        const char* path = addr + r->addr_len;
+        
+        int64_t sec = time / 1000000000;
+        int64_t days = sec >= 0 ? sec / 86400 : (sec - 86399) / 86400;
+        unsigned sod = (unsigned)(sec - days * 86400);
+        int64_t y;
+        unsigned m, d;
+        _internal::civil_from_days(days, y, m, d);
+        
+        auto met = to_string((evmvc::method)r->method);
+        evbuffer_add_printf(b,
+            "{\"time\":\"%04d-%02u-%02uT%02u:%02u:%02u.%03uZ\","
+            "\"id\":%" PRIu64 ",\"method\":\"%.*s\",\"path\":\"",
+            (int)y, m, d, sod / 3600, sod / 60 % 60, sod % 60,
+            (unsigned)(time / 1000000 % 1000),
+            r->req_id, (int)met.size(), met.data()
+        );
+        _escape(b, md::string_view(path, r->path_len));
+        evbuffer_add_printf(b,
+            "\",\"status\":%u,\"bytes\":%" PRIu64
+            ",\"duration_us\":%" PRIu64 ",\"remote\":\"",
+            (unsigned)r->status, r->bytes, r->duration_us
+        );
+        _escape(b, md::string_view(addr, r->addr_len));
+        evbuffer_add_printf(b, "\",\"port\":%u}\n", (unsigned)r->port);
+    }
+    
+    static void _escape(evbuffer* b, md::string_view s)
+    {
+        json_escape_to(s, [b](const char* d, size_t l){
+            evbuffer_add(b, d, l);
+        });
+    }
+    
+    static void _on_timer(int /*fd*/, short /*events*/, void* arg)
+    {
+        ((access_log_writer*)arg)->flush();
+    }
+    
+    access_log_options _opts;
+    bfs::path _filename;
+    md::log::logger _log;
+    pid_t _pid;
+    int _fd;
+    size_t _size;
+    evbuffer* _buf;
+    event* _timer;
+};
+
+namespace _internal {
+// created by the master before the workers are forked
+inline std::unique_ptr<access_log_writer>& access_log()
+{
+    static std::unique_ptr<access_log_writer> _writer;
+    return _writer;
+}
+}//::_internal
+
+}//::evmvc
+#endif //_libevmvc_access_log_h
@@ -188,6 +188,24 @@ public:
 
         this->initialize();
 
+        // every worker sees the metrics of the others
+        _internal::metrics().map(
+            _options.worker_count + EVMVC_METRICS_SPARE_SLOTS
+        );
+
+        _internal::tracing().configure(_options.tracing, _options.log_dir);
+        _internal::offload().configure(_options.offload);
+
+        // the master writes the records of the worker rings
+        if(_options.access_log.enabled && !_internal::access_log())
+            _internal::access_log() = std::make_unique<access_log_writer>(
+                _options.access_log,
+                _options.access_log.filename.empty() ?
+                    _options.log_dir / "access.log" :
+                    _options.access_log.filename,
+                _log
+            );
+
         std::vector<http_worker> twks;
         for(size_t i = 0; i < _options.worker_count; ++i){
             http_worker w = std::make_shared<evmvc::http_worker_t>(
@@ -358,6 +376,7 @@ public:
         this->_workers.clear();
         this->_servers.clear();
         this->_router.reset();
+        _internal::access_log().reset();
 
         if(free_ev_base)
             event_base_free(global::ev_base());
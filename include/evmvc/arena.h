@@ -0,0 +1,188 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_arena_h
+#define _libevmvc_arena_h
+
+#include "stable_headers.h"
+
+#ifndef EVMVC_REQUEST_ARENA_SIZE
+    #define EVMVC_REQUEST_ARENA_SIZE 8192
+#endif
+
+namespace evmvc {
+
+/*
+    monotonic arena backing the objects of a request,
+    memory is only released when the arena is rewound or destroyed.
+*/
+class request_arena
+{
+    struct block
+    {
+        char* data;
+        size_t size;
+    };
+    
+public:
+    request_arena(size_t block_size = EVMVC_REQUEST_ARENA_SIZE)
+        : _block_size(block_size), _cur(0), _pos(0), _used(0)
+    {
+        _add_block(block_size);
+    }
+    
+    ~request_arena()
+    {
+        for(auto& b : _blocks)
+            ::operator delete(b.data);
+    }
+    
+    request_arena(const request_arena&) = delete;
+    request_arena& operator=(const request_arena&) = delete;
+    
+    size_t used() const { return _used;}
+    size_t capacity() const
+    {
+        size_t c = 0;
+        for(auto& b : _blocks)
+            c += b.size;
+        return c;
+    }
+    size_t block_count() const { return _blocks.size();}
+    
+    void* allocate(size_t size, size_t align)
+    {
+        void* p = _align(size, align);
+        if(!p){
+            _next_block(size + align);
+            p = _align(size, align);
+        }
+        _pos = ((char*)p - _blocks[_cur].data) + size;
+        _used += size;
+        return p;
+    }
+    
+    void deallocate(void* p, size_t size)
+    {
+    }
+    
+    /**
+     * Releases everything allocated, when the last request overflowed
+     * the blocks are merged so the next one fits in a single block.
+     */
+    void rewind()
+    {
+        if(_blocks.size() > 1){
+            size_t total = capacity();
+            for(auto& b : _blocks)
+                ::operator delete(b.data);
+            _blocks.clear();
+            _add_block(total);
+        }
+        _cur = 0;
+        _pos = 0;
+        _used = 0;
+    }
+    
+private:
+    void* _align(size_t size, size_t align)
+    {
+        block& b = _blocks[_cur];
+        void* p = b.data + _pos;
+        size_t left = b.size - _pos;
+        return std::align(align, size, p, left);
+    }
+    
+    void _next_block(size_t min_size)
+    {
+        _add_block(std::max(_block_size, min_size));
+        _cur = _blocks.size() -1;
+        _pos = 0;
+    }
+    
+    void _add_block(size_t size)
+    {
+        _blocks.push_back(block{(char*)::operator new(size), size});
+    }
+    
+    size_t _block_size;
+    std::vector<block> _blocks;
+    size_t _cur;
+    size_t _pos;
+    size_t _used;
+};
+typedef std::shared_ptr<request_arena> sp_request_arena;
+
+/*
+    allocator of the request objects, each allocation keeps
+    the arena alive until released.
+*/
+template<typename T>
+class arena_allocator
+{
+    template<typename U>
+    friend class arena_allocator;
+    
+public:
+    typedef T value_type;
+    
+    arena_allocator(const sp_request_arena& arena)
+        : _arena(arena)
+    {
+    }
+    
+    template<typename U>
+    arena_allocator(const arena_allocator<U>& o)
+        : _arena(o._arena)
+    {
+    }
+    
+    T* allocate(size_t n)
+    {
+        return (T*)_arena->allocate(n * sizeof(T), alignof(T));
+    }
+    
+    void deallocate(T* p, size_t n)
+    {
+        _arena->deallocate(p, n * sizeof(T));
+    }
+    
+    template<typename U>
+    bool operator==(const arena_allocator<U>& o) const
+    {
+        return _arena == o._arena;
+    }
+    
+    template<typename U>
+    bool operator!=(const arena_allocator<U>& o) const
+    {
+        return _arena != o._arena;
+    }
+    
+private:
+    sp_request_arena _arena;
+};
+
+}//::evmvc
+#endif //_libevmvc_arena_h
@@ -0,0 +1,222 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_cached_clock_h
+#define _libevmvc_cached_clock_h
+
+#include "stable_headers.h"
+#include "global.h"
+
+#include <sys/time.h>
+
+// length of an IMF-fixdate, "Sun, 06 Nov 1994 08:49:37 GMT"
+#define EVMVC_HTTP_DATE_LEN 29
+
+namespace evmvc {
+
+namespace _internal {
+// days since 1970-01-01 of a proleptic gregorian date
+inline int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+inline void civil_from_days(int64_t z, int64_t& y, unsigned& m, unsigned& d)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = (int64_t)yoe + era * 400 + (m <= 2);
+}
+
+inline void put_2d(char* out, unsigned v)
+{
+    out[0] = '0' + v / 10;
+    out[1] = '0' + v % 10;
+}
+}//::_internal
+
+/**
+ * Formats t as an RFC 7231 IMF-fixdate without any locale,
+ * out must hold EVMVC_HTTP_DATE_LEN chars.
+ */
+inline size_t format_http_date(int64_t t, char* out)
+{
+    static const char* wdays = "SunMonTueWedThuFriSat";
+    static const char* months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    
+    int64_t days = t >= 0 ? t / 86400 : (t - 86399) / 86400;
+    unsigned sod = (unsigned)(t - days * 86400);
+    int64_t y;
+    unsigned m, d;
+    _internal::civil_from_days(days, y, m, d);
+    unsigned wd = (unsigned)(((days + 4) % 7 + 7) % 7);
+    
+    memcpy(out, wdays + wd * 3, 3);
+    out[3] = ',';
+    out[4] = ' ';
+    _internal::put_2d(out + 5, d);
+    out[7] = ' ';
+    memcpy(out + 8, months + (m -1) * 3, 3);
+    out[11] = ' ';
+    _internal::put_2d(out + 12, (unsigned)(y / 100) % 100);
+    _internal::put_2d(out + 14, (unsigned)(y % 100));
+    out[16] = ' ';
+    _internal::put_2d(out + 17, sod / 3600);
+    out[19] = ':';
+    _internal::put_2d(out + 20, sod / 60 % 60);
+    out[22] = ':';
+    _internal::put_2d(out + 23, sod % 60);
+    memcpy(out + 25, " GMT", 4);
+    return EVMVC_HTTP_DATE_LEN;
+}
+
+inline std::string format_http_date(int64_t t)
+{
+    char buf[EVMVC_HTTP_DATE_LEN];
+    return std::string(buf, format_http_date(t, buf));
+}
+
+/**
+ * Parses an IMF-fixdate, the obsolete formats are rejected
+ * and should be handled as an invalid date.
+ */
+inline bool parse_http_date(md::string_view s, int64_t& t)
+{
+    static const char* months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    
+    const char* p = s.data();
+    if(s.size() != EVMVC_HTTP_DATE_LEN || p[3] != ',' ||
+        memcmp(p + 25, " GMT", 4) != 0
+    )
+        return false;
+    
+    auto num = [p](size_t pos, size_t len, unsigned& v)->bool{
+        v = 0;
+        for(size_t i = pos; i < pos + len; ++i){
+            if(p[i] < '0' || p[i] > '9')
+                return false;
+            v = v * 10 + (p[i] - '0');
+        }
+        return true;
+    };
+    
+    unsigned m = 0;
+    while(m < 12 && memcmp(months + m * 3, p + 8, 3) != 0)
+        ++m;
+    
+    unsigned d, y, hh, mm, ss;
+    if(m == 12 || !num(5, 2, d) || !num(12, 4, y) ||
+        !num(17, 2, hh) || !num(20, 2, mm) || !num(23, 2, ss) ||
+        d < 1 || d > 31 || hh > 23 || mm > 59 || ss > 60
+    )
+        return false;
+    
+    t = _internal::days_from_civil(y, m +1, d) * 86400 +
+        hh * 3600 + mm * 60 + ss;
+    return true;
+}
+
+/*
+    wall clock of the process cached by libevent for the current
+    loop iteration, the Date header is rendered once per second.
+*/
+class cached_clock
+{
+public:
+    cached_clock()
+        : _sec(INT64_MIN)
+    {
+        memcpy(_line, "Date: ", 6);
+        memcpy(_line + 6 + EVMVC_HTTP_DATE_LEN, "\r\n", 2);
+    }
+    
+    struct timeval now() const
+    {
+        struct timeval tv;
+        if(event_base_gettimeofday_cached(global::ev_base(), &tv) != 0)
+            gettimeofday(&tv, nullptr);
+        return tv;
+    }
+    
+    int64_t now_ms() const
+    {
+        struct timeval tv = now();
+        return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    }
+    
+    int64_t now_ns() const
+    {
+        struct timeval tv = now();
+        return (int64_t)tv.tv_sec * 1000000000 + (int64_t)tv.tv_usec * 1000;
+    }
+    
+    // current IMF-fixdate
+    md::string_view date()
+    {
+        _refresh();
+        return md::string_view(_line + 6, EVMVC_HTTP_DATE_LEN);
+    }
+    
+    // "Date: ...\r\n" header line
+    md::string_view date_line()
+    {
+        _refresh();
+        return md::string_view(_line, sizeof(_line));
+    }
+    
+private:
+    void _refresh()
+    {
+        int64_t sec = now().tv_sec;
+        if(sec == _sec)
+            return;
+        _sec = sec;
+        format_http_date(sec, _line + 6);
+    }
+    
+    int64_t _sec;
+    char _line[6 + EVMVC_HTTP_DATE_LEN + 2];
+};
+
+namespace _internal {
+inline cached_clock& coarse_clock()
+{
+    static cached_clock _clock;
+    return _clock;
+}
+}//::_internal
+
+}//::evmvc
+#endif //_libevmvc_cached_clock_h
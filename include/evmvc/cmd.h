@@ -30,6 +30,11 @@ SOFTWARE.
 #include "utils.h"
 #include "configuration.h"
 
+// payload size kept in the command itself before using an evbuffer
+#ifndef EVMVC_CMD_INLINE_SIZE
+    #define EVMVC_CMD_INLINE_SIZE 128
+#endif
+
 namespace evmvc {
 
 constexpr int CMD_SYS_ID = 0;
@@ -40,6 +45,8 @@ constexpr int CMD_PONG = evmvc::CMD_SYS_ID + 1;
 constexpr int CMD_LOG = evmvc::CMD_SYS_ID + 2;
 constexpr int CMD_CLOSE = evmvc::CMD_SYS_ID + 3;
 constexpr int CMD_CLOSE_APP = evmvc::CMD_SYS_ID + 4;
+constexpr int CMD_FRAGMENTS_INVALIDATE = evmvc::CMD_SYS_ID + 5;
+constexpr int CMD_VIEWS_RELOAD = evmvc::CMD_SYS_ID + 6;
 
 class command;
 typedef std::shared_ptr<command> shared_command;
@@ -50,20 +57,23 @@ class command
 public:
     command(int id)
         : _id(id),
-        _buf(evbuffer_new()),
+        _buf(nullptr),
+        _ilen(0),
         _rpos(0)
     {
     }
     
     command(int id, const char* payload, size_t payload_len)
-        : _id(id), _buf(evbuffer_new()), _rpos(0)
+        : _id(id), _buf(nullptr), _ilen(0), _rpos(0)
     {
-        evbuffer_add(_buf, payload, payload_len);
+        if(payload_len > 0)
+            _write(payload, payload_len);
     }
     
     ~command()
     {
-        evbuffer_free(_buf);
+        if(_buf)
+            evbuffer_free(_buf);
         _buf = nullptr;
     }
     
@@ -74,6 +84,7 @@ public:
     
     evbuffer* buffer() const
     {
+        _spill();
         return _buf;
     }
     
@@ -91,8 +102,8 @@ public:
     */
     int move_buffer(evbuffer* dest)
     {
+        _spill();
         int r = evbuffer_add_buffer(dest, _buf);
-        _buf = evbuffer_new();
         _rpos = 0;
         return r;
     }
@@ -101,12 +112,14 @@ public:
     {
         if(size() == 0)
             return nullptr;
+        if(!_buf)
+            return _inl;
         
         return (const char*)evbuffer_pullup(_buf, size());
     }
     size_t size() const
     {
-        return evbuffer_get_length(_buf);
+        return _buf ? evbuffer_get_length(_buf) : _ilen;
     }
     
     size_t read_pos() const {return _rpos;}
@@ -190,12 +203,25 @@ public:
     
     void drain(size_t n)
     {
-        evbuffer_drain(_buf, n);
+        if(_buf){
+            evbuffer_drain(_buf, n);
+            return;
+        }
+        n = std::min(n, _ilen);
+        memmove(_inl, _inl + n, _ilen - n);
+        _ilen -= n;
     }
     
     void resize(size_t n)
     {
-        if(n < size()){
+        if(!_buf){
+            if(n < _ilen)
+                _ilen = n;
+            else if(n > EVMVC_CMD_INLINE_SIZE){
+                _spill();
+                evbuffer_expand(_buf, n);
+            }
+        }else if(n < size()){
             evbuffer* b = evbuffer_new();
             evbuffer_remove_buffer(_buf, b, n);
             evbuffer_free(_buf);
@@ -208,13 +234,30 @@ public:
 private:
     void _write(const char* d, size_t l)
     {
+        if(!_buf && _ilen + l <= EVMVC_CMD_INLINE_SIZE){
+            memcpy(_inl + _ilen, d, l);
+            _ilen += l;
+            return;
+        }
+        _spill();
         if(evbuffer_add(_buf, d, l))
             throw MD_ERR("Unable to write to buffer");
     }
     
+    // moves the inline payload into an evbuffer
+    void _spill() const
+    {
+        if(_buf)
+            return;
+        _buf = evbuffer_new();
+        if(_ilen > 0)
+            evbuffer_add(_buf, _inl, _ilen);
+        _ilen = 0;
+    }
+    
     void _peak(char* d, size_t l, size_t offset = 0) const
     {
-        unsigned char* s = evbuffer_pullup(_buf, evbuffer_get_length(_buf));
+        const char* s = data();
         if(s == nullptr)
             throw MD_ERR("Invalid buffer length");
         memcpy(d, s + (_rpos + offset), l);
@@ -227,7 +270,9 @@ private:
     }
     
     int _id;
-    evbuffer* _buf;
+    mutable evbuffer* _buf;
+    mutable size_t _ilen;
+    char _inl[EVMVC_CMD_INLINE_SIZE];
     size_t _rpos;
 };
 
@@ -0,0 +1,427 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_compression_h
+#define _libevmvc_compression_h
+
+#include "stable_headers.h"
+#include "headers.h"
+#include "configuration.h"
+#include "mime.h"
+
+#if EVMVC_HAS_BROTLI
+#include <brotli/encode.h>
+#endif
+#if EVMVC_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace evmvc {
+
+class compressor_t
+{
+public:
+    compressor_t(encoding_type type)
+        : _type(type)
+    {
+    }
+    
+    virtual ~compressor_t()
+    {
+    }
+    
+    encoding_type type() const { return _type;}
+    
+    // prepares the compressor for a new stream
+    virtual void reset() = 0;
+    
+    // compresses len bytes of data and appends the output to out
+    virtual void compress(
+        const char* data, size_t len, evbuffer* out, compress_flush flush
+    ) = 0;
+
+protected:
+    static evbuffer_iovec _reserve(evbuffer* out)
+    {
+        evbuffer_iovec v;
+        if(evbuffer_reserve_space(
+            out, EVMVC_COMPRESSION_CHUNK_SIZE, &v, 1) < 1
+        )
+            throw MD_ERR("evbuffer_reserve_space failed!");
+        return v;
+    }
+    
+    static void _commit(evbuffer* out, evbuffer_iovec& v, size_t used)
+    {
+        v.iov_len = used;
+        if(evbuffer_commit_space(out, &v, 1))
+            throw MD_ERR("evbuffer_commit_space failed!");
+    }
+    
+    encoding_type _type;
+};
+typedef std::unique_ptr<compressor_t> compressor;
+
+
+class zlib_compressor
+    : public compressor_t
+{
+public:
+    zlib_compressor(encoding_type type, int level)
+        : compressor_t(type)
+    {
+        memset(&_zs, 0, sizeof(_zs));
+        if(deflateInit2(
+            &_zs,
+            level,
+            Z_DEFLATED,
+            type == encoding_type::deflate ?
+                EVMVC_ZLIB_DEFLATE_WSIZE : EVMVC_ZLIB_GZIP_WSIZE,
+            EVMVC_ZLIB_MEM_LEVEL,
+            EVMVC_ZLIB_STRATEGY
+            ) != Z_OK
+        )
+            throw MD_ERR("deflateInit2 failed!");
+    }
+    
+    ~zlib_compressor()
+    {
+        deflateEnd(&_zs);
+    }
+    
+    void reset()
+    {
+        deflateReset(&_zs);
+    }
+    
+    void compress(
+        const char* data, size_t len, evbuffer* out, compress_flush flush)
+    {
+        int zflush = flush == compress_flush::finish ? Z_FINISH :
+            flush == compress_flush::sync ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+        
+        _zs.next_in = (Bytef*)data;
+        _zs.avail_in = (uInt)len;
+        do{
+            evbuffer_iovec v = _reserve(out);
+            _zs.next_out = (Bytef*)v.iov_base;
+            _zs.avail_out = (uInt)v.iov_len;
+            
+            int ret = deflate(&_zs, zflush);
+            if(ret == Z_STREAM_ERROR)
+                throw MD_ERR("zlib deflate function returned: '{}'", ret);
+            
+            _commit(out, v, v.iov_len - _zs.avail_out);
+        }while(_zs.avail_out == 0);
+    }
+
+private:
+    z_stream _zs;
+};
+
+
+#if EVMVC_HAS_BROTLI
+class brotli_compressor
+    : public compressor_t
+{
+public:
+    brotli_compressor(int quality)
+        : compressor_t(encoding_type::br), _quality(quality), _st(nullptr)
+    {
+        _init();
+    }
+    
+    ~brotli_compressor()
+    {
+        BrotliEncoderDestroyInstance(_st);
+    }
+    
+    void reset()
+    {
+        // brotli encoder instances can't be reset
+        BrotliEncoderDestroyInstance(_st);
+        _init();
+    }
+    
+    void compress(
+        const char* data, size_t len, evbuffer* out, compress_flush flush)
+    {
+        BrotliEncoderOperation op =
+            flush == compress_flush::finish ? BROTLI_OPERATION_FINISH :
+            flush == compress_flush::sync ? BROTLI_OPERATION_FLUSH :
+            BROTLI_OPERATION_PROCESS;
+        
+        size_t avail_in = len;
+        const uint8_t* next_in = (const uint8_t*)data;
+        do{
+            evbuffer_iovec v = _reserve(out);
+            size_t avail_out = v.iov_len;
+            uint8_t* next_out = (uint8_t*)v.iov_base;
+            
+            if(!BrotliEncoderCompressStream(
+                _st, op, &avail_in, &next_in, &avail_out, &next_out, nullptr
+            ))
+                throw MD_ERR("BrotliEncoderCompressStream failed!");
+            
+            _commit(out, v, v.iov_len - avail_out);
+        }while(
+            avail_in > 0 || BrotliEncoderHasMoreOutput(_st) ||
+            (op == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(_st))
+        );
+    }
+
+private:
+    void _init()
+    {
+        _st = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if(!_st)
+            throw MD_ERR("BrotliEncoderCreateInstance failed!");
+        BrotliEncoderSetParameter(_st, BROTLI_PARAM_QUALITY, _quality);
+    }
+    
+    int _quality;
+    BrotliEncoderState* _st;
+};
+#endif //EVMVC_HAS_BROTLI
+
+
+#if EVMVC_HAS_ZSTD
+class zstd_compressor
+    : public compressor_t
+{
+public:
+    zstd_compressor(int level)
+        : compressor_t(encoding_type::zstd), _cctx(ZSTD_createCCtx())
+    {
+        if(!_cctx)
+            throw MD_ERR("ZSTD_createCCtx failed!");
+        ZSTD_CCtx_setParameter(_cctx, ZSTD_c_compressionLevel, level);
+    }
+    
+    ~zstd_compressor()
+    {
+        ZSTD_freeCCtx(_cctx);
+    }
+    
+    void reset()
+    {
+        ZSTD_CCtx_reset(_cctx, ZSTD_reset_session_only);
+    }
+    
+    void compress(
+        const char* data, size_t len, evbuffer* out, compress_flush flush)
+    {
+        ZSTD_EndDirective mode =
+            flush == compress_flush::finish ? ZSTD_e_end :
+            flush == compress_flush::sync ? ZSTD_e_flush :
+            ZSTD_e_continue;
+        
+        ZSTD_inBuffer in = { data, len, 0 };
+        size_t rem = 0;
+        do{
+            evbuffer_iovec v = _reserve(out);
+            ZSTD_outBuffer o = { v.iov_base, v.iov_len, 0 };
+            
+            rem = ZSTD_compressStream2(_cctx, &o, &in, mode);
+            if(ZSTD_isError(rem))
+                throw MD_ERR(
+                    "ZSTD_compressStream2 failed: '{}'",
+                    ZSTD_getErrorName(rem)
+                );
+            
+            _commit(out, v, o.pos);
+        }while(
+            in.pos < in.size || (mode != ZSTD_e_continue && rem > 0)
+        );
+    }
+
+private:
+    ZSTD_CCtx* _cctx;
+};
+#endif //EVMVC_HAS_ZSTD
+
+
+inline bool compression_supported(encoding_type type)
+{
+    switch(type){
+        case encoding_type::gzip:
+        case encoding_type::deflate:
+            return true;
+    #if EVMVC_HAS_BROTLI
+        case encoding_type::br:
+            return true;
+    #endif
+    #if EVMVC_HAS_ZSTD
+        case encoding_type::zstd:
+            return true;
+    #endif
+        default:
+            return false;
+    }
+}
+
+// true when a body of body_size bytes and mime_type should be compressed
+inline bool compression_eligible(
+    const compression_options& opts, size_t body_size,
+    md::string_view mime_type)
+{
+    if(!opts.enabled || body_size < opts.min_size)
+        return false;
+    return evmvc::mime::compressible(mime_type);
+}
+
+/*
+    returns the best supported encoding from the sorted accept_encodings,
+    on equal weight br is prefered over zstd, gzip and deflate.
+    "*" stands for the encodings not listed, RFC 7231 section 5.3.4.
+*/
+inline encoding_type negotiate_encoding(
+    const std::vector<accept_encoding>& encs)
+{
+    static const encoding_type prefs[] = {
+        encoding_type::br, encoding_type::zstd,
+        encoding_type::gzip, encoding_type::deflate
+    };
+    
+    auto star = [&encs](){
+        for(auto p : prefs){
+            if(!compression_supported(p))
+                continue;
+            bool listed = false;
+            for(const auto& enc : encs)
+                if(enc.type == p){
+                    listed = true;
+                    break;
+                }
+            if(!listed)
+                return p;
+        }
+        return encoding_type::unsupported;
+    };
+    
+    encoding_type best = encoding_type::unsupported;
+    float best_weight = 0;
+    for(const auto& enc : encs){
+        if(enc.weight <= 0)
+            continue;
+        if(best != encoding_type::unsupported && enc.weight < best_weight)
+            break;
+        
+        encoding_type t = enc.type == encoding_type::star ?
+            star() : enc.type;
+        if(!compression_supported(t))
+            continue;
+        
+        if(best == encoding_type::unsupported){
+            best = t;
+            best_weight = enc.weight;
+            continue;
+        }
+        for(auto p : prefs){
+            if(p == best)
+                break;
+            if(p == t){
+                best = t;
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+
+/*
+    idle compressors are kept per worker and reset before reuse,
+    avoiding the init/end cost of each compression context.
+*/
+class compressor_pool
+{
+public:
+    compressor_pool()
+    {
+    }
+    
+    compressor acquire(encoding_type type, const compression_options& opts)
+    {
+        auto& fl = _free[(size_t)type];
+        if(!fl.empty()){
+            compressor c = std::move(fl.back());
+            fl.pop_back();
+            return c;
+        }
+        
+        switch(type){
+            case encoding_type::gzip:
+            case encoding_type::deflate:
+                return compressor(new zlib_compressor(type, opts.zlib_level));
+        #if EVMVC_HAS_BROTLI
+            case encoding_type::br:
+                return compressor(new brotli_compressor(opts.brotli_quality));
+        #endif
+        #if EVMVC_HAS_ZSTD
+            case encoding_type::zstd:
+                return compressor(new zstd_compressor(opts.zstd_level));
+        #endif
+            default:
+                throw MD_ERR(
+                    "Unsupported compression: '{}'", to_string(type)
+                );
+        }
+    }
+    
+    void release(compressor&& c, size_t pool_size)
+    {
+        if(!c)
+            return;
+        auto& fl = _free[(size_t)c->type()];
+        if(fl.size() >= pool_size){
+            c.reset();
+            return;
+        }
+        c->reset();
+        fl.emplace_back(std::move(c));
+    }
+
+private:
+    std::vector<compressor> _free[(size_t)encoding_type::zstd +1];
+};
+
+namespace _internal {
+inline compressor_pool& compressors()
+{
+    static compressor_pool pool;
+    return pool;
+}
+
+// per worker scratch buffer receiving the compressed output
+inline evbuffer* compression_buffer()
+{
+    static evbuffer* zbuf = evbuffer_new();
+    evbuffer_drain(zbuf, evbuffer_get_length(zbuf));
+    return zbuf;
+}
+}//::_internal
+
+} //ns evmvc
+#endif //_libevmvc_compression_h
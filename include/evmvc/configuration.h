@@ -29,6 +29,10 @@ SOFTWARE.
 #include "utils.h"
 #include "ssl_utils.h"
 
+#ifndef EVMVC_LOG_RING_DEFAULT_SIZE
+    #define EVMVC_LOG_RING_DEFAULT_SIZE (1024 * 1024)
+#endif
+
 namespace evmvc {
 
 typedef EVP_PKEY* (*ssl_decrypt_cb)(const char* cert_key_file);
@@ -430,6 +434,368 @@ public:
     struct timeval wtimeo = {3,0};
 };
 
+enum class compress_flush
+{
+    none,
+    sync,
+    finish
+};
+
+class compression_options
+{
+public:
+    compression_options()
+    {
+    }
+    
+    compression_options(const compression_options& o)
+        : enabled(o.enabled),
+        min_size(o.min_size),
+        zlib_level(o.zlib_level),
+        brotli_quality(o.brotli_quality),
+        zstd_level(o.zstd_level),
+        pool_size(o.pool_size),
+        file_flush(o.file_flush)
+    {
+    }
+    
+    compression_options(compression_options&& o)
+        : enabled(o.enabled),
+        min_size(o.min_size),
+        zlib_level(o.zlib_level),
+        brotli_quality(o.brotli_quality),
+        zstd_level(o.zstd_level),
+        pool_size(o.pool_size),
+        file_flush(o.file_flush)
+    {
+    }
+    
+    compression_options& operator=(const compression_options& o)
+    {
+        enabled = o.enabled;
+        min_size = o.min_size;
+        zlib_level = o.zlib_level;
+        brotli_quality = o.brotli_quality;
+        zstd_level = o.zstd_level;
+        pool_size = o.pool_size;
+        file_flush = o.file_flush;
+        
+        return *this;
+    }
+    
+    compression_options& operator=(compression_options&& o)
+    {
+        enabled = o.enabled;
+        min_size = o.min_size;
+        zlib_level = o.zlib_level;
+        brotli_quality = o.brotli_quality;
+        zstd_level = o.zstd_level;
+        pool_size = o.pool_size;
+        file_flush = o.file_flush;
+        
+        return *this;
+    }
+    
+    // compress dynamic responses (send, json, html, render)
+    bool enabled = true;
+    // bodies smaller than min_size are sent uncompressed
+    size_t min_size = 1024;
+    
+    int zlib_level = Z_DEFAULT_COMPRESSION;
+    int brotli_quality = 5;
+    int zstd_level = 3;
+    
+    // maximum number of idle compressor per encoding kept by each worker
+    size_t pool_size = 16;
+    
+    // flush mode used for each send_file chunk, the last one always finish.
+    // none gives the best ratio, sync sends every chunk as soon as read.
+    compress_flush file_flush = compress_flush::none;
+};
+
+class view_options
+{
+public:
+    view_options()
+    {
+    }
+    
+    view_options(const view_options& o)
+        : stream(o.stream),
+        stream_flush_size(o.stream_flush_size),
+        fragment_cache_size(o.fragment_cache_size)
+    {
+    }
+    
+    view_options(view_options&& o)
+        : stream(o.stream),
+        stream_flush_size(o.stream_flush_size),
+        fragment_cache_size(o.fragment_cache_size)
+    {
+    }
+    
+    view_options& operator=(const view_options& o)
+    {
+        stream = o.stream;
+        stream_flush_size = o.stream_flush_size;
+        fragment_cache_size = o.fragment_cache_size;
+        
+        return *this;
+    }
+    
+    view_options& operator=(view_options&& o)
+    {
+        stream = o.stream;
+        stream_flush_size = o.stream_flush_size;
+        fragment_cache_size = o.fragment_cache_size;
+        
+        return *this;
+    }
+    
+    // render the outer layout straight to the connection with chunked
+    // encoding, the head is sent as soon as the layout reaches its body.
+    bool stream = false;
+    // pending view output is sent once it reaches stream_flush_size
+    size_t stream_flush_size = 16384;
+    
+    // maximum bytes of rendered fragments cached by each worker
+    size_t fragment_cache_size = 1048576 * 8;
+};
+
+enum class access_log_format
+{
+    // one json object per line
+    json,
+    // length prefixed records, see access_log.h
+    binary
+};
+
+enum class access_log_sync
+{
+    none,
+    // fsync after each batch written
+    flush,
+    // fsync before the file is rotated
+    rotate
+};
+
+class access_log_options
+{
+public:
+    access_log_options()
+    {
+    }
+    
+    access_log_options(const access_log_options& o)
+        : enabled(o.enabled),
+        format(o.format),
+        filename(o.filename),
+        ring_size(o.ring_size),
+        flush_ms(o.flush_ms),
+        flush_size(o.flush_size),
+        max_size(o.max_size),
+        max_files(o.max_files),
+        sync(o.sync)
+    {
+    }
+    
+    access_log_options(access_log_options&& o)
+        : enabled(o.enabled),
+        format(o.format),
+        filename(std::move(o.filename)),
+        ring_size(o.ring_size),
+        flush_ms(o.flush_ms),
+        flush_size(o.flush_size),
+        max_size(o.max_size),
+        max_files(o.max_files),
+        sync(o.sync)
+    {
+    }
+    
+    access_log_options& operator=(const access_log_options& o)
+    {
+        enabled = o.enabled;
+        format = o.format;
+        filename = o.filename;
+        ring_size = o.ring_size;
+        flush_ms = o.flush_ms;
+        flush_size = o.flush_size;
+        max_size = o.max_size;
+        max_files = o.max_files;
+        sync = o.sync;
+        
+        return *this;
+    }
+    
+    access_log_options& operator=(access_log_options&& o)
+    {
+        enabled = o.enabled;
+        format = o.format;
+        filename = std::move(o.filename);
+        ring_size = o.ring_size;
+        flush_ms = o.flush_ms;
+        flush_size = o.flush_size;
+        max_size = o.max_size;
+        max_files = o.max_files;
+        sync = o.sync;
+        
+        return *this;
+    }
+    
+    // one record per request, written by the master process
+    bool enabled = false;
+    access_log_format format = access_log_format::json;
+    // access.log in the log_dir when empty
+    bfs::path filename;
+    
+    // shared memory ring of each worker, full rings drop records
+    size_t ring_size = 1048576;
+    
+    // pending records are written every flush_ms
+    // or as soon as flush_size bytes are pending
+    int flush_ms = 1000;
+    size_t flush_size = 65536;
+    
+    size_t max_size = 1048576 * 50;
+    size_t max_files = 7;
+    access_log_sync sync = access_log_sync::none;
+};
+
+class tracing_options
+{
+public:
+    tracing_options()
+    {
+    }
+    
+    tracing_options(const tracing_options& o)
+        : enabled(o.enabled),
+        server_timing(o.server_timing),
+        metrics(o.metrics),
+        sample_rate(o.sample_rate),
+        filename(o.filename),
+        flush_ms(o.flush_ms),
+        flush_size(o.flush_size)
+    {
+    }
+    
+    tracing_options(tracing_options&& o)
+        : enabled(o.enabled),
+        server_timing(o.server_timing),
+        metrics(o.metrics),
+        sample_rate(o.sample_rate),
+        filename(std::move(o.filename)),
+        flush_ms(o.flush_ms),
+        flush_size(o.flush_size)
+    {
+    }
+    
+    tracing_options& operator=(const tracing_options& o)
+    {
+        enabled = o.enabled;
+        server_timing = o.server_timing;
+        metrics = o.metrics;
+        sample_rate = o.sample_rate;
+        filename = o.filename;
+        flush_ms = o.flush_ms;
+        flush_size = o.flush_size;
+        
+        return *this;
+    }
+    
+    tracing_options& operator=(tracing_options&& o)
+    {
+        enabled = o.enabled;
+        server_timing = o.server_timing;
+        metrics = o.metrics;
+        sample_rate = o.sample_rate;
+        filename = std::move(o.filename);
+        flush_ms = o.flush_ms;
+        flush_size = o.flush_size;
+        
+        return *this;
+    }
+    
+    // traces every route, route_t::trace overrides it by route
+    bool enabled = false;
+    // adds the phases completed before the headers as a Server-Timing header
+    bool server_timing = false;
+    // records the phases in the evmvc_request_phase_seconds histograms
+    bool metrics = true;
+    
+    // one traced request out of sample_rate is written as chrome trace
+    // events, 0 disables the trace file
+    size_t sample_rate = 0;
+    // each worker appends its pid to the file name,
+    // trace-{pid}.json in the log_dir when empty
+    bfs::path filename;
+    int flush_ms = 1000;
+    size_t flush_size = 65536;
+};
+
+class watchdog_options
+{
+public:
+    watchdog_options()
+    {
+    }
+    
+    watchdog_options(const watchdog_options& o)
+        : enabled(o.enabled),
+        interval_ms(o.interval_ms),
+        slow_ms(o.slow_ms),
+        stall_ms(o.stall_ms)
+    {
+    }
+    
+    watchdog_options& operator=(const watchdog_options& o)
+    {
+        enabled = o.enabled;
+        interval_ms = o.interval_ms;
+        slow_ms = o.slow_ms;
+        stall_ms = o.stall_ms;
+        
+        return *this;
+    }
+    
+    // measures the event loop lag of the http workers
+    bool enabled = false;
+    int interval_ms = 100;
+    // the routes, views and commands blocking the loop longer are reported
+    int slow_ms = 50;
+    // the master stops sending the new connections to a worker
+    // which did not tick for stall_ms, 0 disables it
+    int stall_ms = 2000;
+};
+
+class offload_options
+{
+public:
+    offload_options()
+    {
+    }
+    
+    offload_options(const offload_options& o)
+        : threads(o.threads),
+        max_queue(o.max_queue)
+    {
+    }
+    
+    offload_options& operator=(const offload_options& o)
+    {
+        threads = o.threads;
+        max_queue = o.max_queue;
+        
+        return *this;
+    }
+    
+    // threads of each worker, started on the first offloaded job,
+    // 0 runs the jobs on the event loop
+    size_t threads = 4;
+    // the jobs submitted to a full queue fail immediately
+    size_t max_queue = 1024;
+};
+
 class app_options
 {
 public:
@@ -449,7 +815,14 @@ public:
         log_file_max_files(7),
         stack_trace_enabled(false),
         worker_count(get_nprocs_conf()),
-        worker_shmsize(1)
+        worker_shmsize(1),
+        worker_log_ring_size(EVMVC_LOG_RING_DEFAULT_SIZE),
+        compression(),
+        views(),
+        access_log(),
+        tracing(),
+        watchdog(),
+        offload()
     {
     }
 
@@ -469,7 +842,14 @@ public:
         log_file_max_files(7),
         stack_trace_enabled(false),
         worker_count(get_nprocs_conf()),
-        worker_shmsize(1)
+        worker_shmsize(1),
+        worker_log_ring_size(EVMVC_LOG_RING_DEFAULT_SIZE),
+        compression(),
+        views(),
+        access_log(),
+        tracing(),
+        watchdog(),
+        offload()
     {
     }
     
@@ -490,6 +870,13 @@ public:
         stack_trace_enabled(other.stack_trace_enabled),
         worker_count(other.worker_count),
         worker_shmsize(other.worker_shmsize),
+        worker_log_ring_size(other.worker_log_ring_size),
+        compression(other.compression),
+        views(other.views),
+        access_log(other.access_log),
+        tracing(other.tracing),
+        watchdog(other.watchdog),
+        offload(other.offload),
         servers(other.servers)
     {
     }
@@ -511,6 +898,13 @@ public:
         stack_trace_enabled(other.stack_trace_enabled),
         worker_count(other.worker_count),
         worker_shmsize(other.worker_shmsize),
+        worker_log_ring_size(other.worker_log_ring_size),
+        compression(std::move(other.compression)),
+        views(std::move(other.views)),
+        access_log(std::move(other.access_log)),
+        tracing(std::move(other.tracing)),
+        watchdog(other.watchdog),
+        offload(other.offload),
         servers(std::move(other.servers))
     {
         other.use_default_logger = true;
@@ -522,6 +916,7 @@ public:
         other.stack_trace_enabled = false;
         other.worker_count = get_nprocs_conf();
         other.worker_shmsize = 1;
+        other.worker_log_ring_size = EVMVC_LOG_RING_DEFAULT_SIZE;
     }
     
     app_options& operator=(const app_options& other)
@@ -542,6 +937,13 @@ public:
         stack_trace_enabled = other.stack_trace_enabled;
         worker_count = other.worker_count;
         worker_shmsize = other.worker_shmsize;
+        worker_log_ring_size = other.worker_log_ring_size;
+        compression = other.compression;
+        views = other.views;
+        access_log = other.access_log;
+        tracing = other.tracing;
+        watchdog = other.watchdog;
+        offload = other.offload;
         servers = other.servers;
         
         return *this;
@@ -565,6 +967,13 @@ public:
         stack_trace_enabled = other.stack_trace_enabled;
         worker_count = other.worker_count;
         worker_shmsize = other.worker_shmsize;
+        worker_log_ring_size = other.worker_log_ring_size;
+        compression = std::move(other.compression);
+        views = std::move(other.views);
+        access_log = std::move(other.access_log);
+        tracing = std::move(other.tracing);
+        watchdog = other.watchdog;
+        offload = other.offload;
         
         servers = std::move(other.servers);
         
@@ -577,6 +986,7 @@ public:
         other.stack_trace_enabled = false;
         other.worker_count = get_nprocs_conf();
         other.worker_shmsize = 1;
+        other.worker_log_ring_size = EVMVC_LOG_RING_DEFAULT_SIZE;
         
         return *this;
     }
@@ -600,6 +1010,15 @@ public:
     bool stack_trace_enabled;
     size_t worker_count;
     size_t worker_shmsize;
+    // shared memory carrying the workers logs, zero sends them by pipe
+    size_t worker_log_ring_size;
+    
+    compression_options compression;
+    view_options views;
+    access_log_options access_log;
+    tracing_options tracing;
+    watchdog_options watchdog;
+    offload_options offload;
     
     std::vector<server_options> servers;
 };
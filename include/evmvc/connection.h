@@ -32,6 +32,7 @@ SOFTWARE.
 #include "request.h"
 #include "response.h"
 #include "file_reply.h"
+#include "timer_wheel.h"
 
 namespace evmvc {
 // namespace _internal {
@@ -94,19 +95,20 @@ public:
         :
         _closed(false),
         _id(nxt_id()),
-        _log(
-            log->add_child(fmt::format(
-                "conn-{}-{}", to_string(p), _id
-            ))
-        ),
+        _parent_log(log),
         _worker(worker_t),
         _server(server),
         _sock_fd(sock_fd),
         _protocol(p),
         _remote_addr(remote_addr),
-        _remote_port(remote_port)
+        _remote_port(remote_port),
+        _idle_timer(connection::on_connection_idle, this)
     {
         EVMVC_DEF_TRACE("connection {} {:p} created", _id, (void*)this);
+        worker_metrics().connections.fetch_add(1, std::memory_order_relaxed);
+        worker_metrics().connections_open.fetch_add(
+            1, std::memory_order_relaxed
+        );
     }
 
     ~connection()
@@ -125,7 +127,7 @@ public:
             case url_scheme::http:
             case url_scheme::https:
                 _parser = std::make_shared<http_parser>(
-                    this->shared_from_this(), _log
+                    this->shared_from_this()
                 );
                 break;
             default:
@@ -151,21 +153,7 @@ public:
 
         }
 
-        struct timeval rto =
-            #if EVMVC_BUILD_DEBUG
-                // set to 30 seconds in debug build
-                {30,0};
-            #else
-                rtimeo();
-            #endif
-        struct timeval wto =
-            #if EVMVC_BUILD_DEBUG
-                // set to 30 seconds in debug build
-                {30,0};
-            #else
-                wtimeo();
-            #endif
-        bufferevent_set_timeouts(_bev, &rto, &wto);
+        _idle_timer.arm(_idle_ms(false));
 
         _resume_ev = event_new(
             global::ev_base(), -1, EV_READ | EV_PERSIST,
@@ -181,12 +169,26 @@ public:
             this
         );
         bufferevent_enable(_bev, EV_READ);
+        evbuffer_add_cb(bev_out(), connection::on_connection_sent, this);
 
-        _log->success("connection initialized");
+        if(should_log(md::log::log_level::info))
+            log()->success("connection initialized");
     }
 
     int id() const { return _id;}
-    const md::log::logger& log() const { return _log;}
+    // the child logger is only created once something is logged
+    const md::log::logger& log() const
+    {
+        if(!_log)
+            _log = _parent_log->add_child(fmt::format(
+                "conn-{}-{}", to_string(_protocol), _id
+            ));
+        return _log;
+    }
+    bool should_log(md::log::log_level lvl) const
+    {
+        return _parent_log->should_log(lvl);
+    }
     http_worker get_worker() const;
     child_server server() const { return _server;}
     evmvc::url_scheme protocol() const { return _protocol;}
@@ -263,28 +265,13 @@ public:
         if(wto)
             _wtimeo = *wto;
 
-        auto rt = rtimeo();
-        auto wt = wtimeo();
-        bufferevent_set_timeouts(_bev, &rt, &wt);
+        reset_timeouts();
     }
 
     void reset_timeouts()
     {
-        struct timeval rto =
-            #if EVMVC_BUILD_DEBUG
-                // set to 30 seconds in debug build
-                {30,0};
-            #else
-                rtimeo();
-            #endif
-        struct timeval wto =
-            #if EVMVC_BUILD_DEBUG
-                // set to 30 seconds in debug build
-                {30,0};
-            #else
-                wtimeo();
-            #endif
-        bufferevent_set_timeouts(_bev, &rto, &wto);
+        if(_bev)
+            _idle_timer.arm(_idle_ms(evbuffer_get_length(bev_out()) > 0));
     }
 
     const std::shared_ptr<http_parser>& parser() const
@@ -301,9 +288,9 @@ public:
 
     void resume()
     {
-        EVMVC_TRACE(_log, "Resuming connection!");
+        EVMVC_TRACE(log(), "Resuming connection!");
         if(!flag_is(conn_flags::paused)){
-            _log->error("Resuming unpaused connection!");
+            log()->error("Resuming unpaused connection!");
             set_conn_flag(conn_flags::error);
             return;
         }
@@ -331,7 +318,7 @@ public:
         if(setsockopt(_sock_fd, SOL_SOCKET, SO_KEEPALIVE,
             (void*)&v, sizeof(v)) == -1
         )
-            _log->fatal("SOL_SOCKET, SO_KEEPALIVE, err: {}", errno);
+            log()->fatal("SOL_SOCKET, SO_KEEPALIVE, err: {}", errno);
 
         if(en)
             set_conn_flag(conn_flags::keepalive);
@@ -385,6 +372,19 @@ public:
 
 
 private:
+    // idle delay of the connection, the write timeout applies
+    // while output is pending
+    uint64_t _idle_ms(bool writing) const
+    {
+        #if EVMVC_BUILD_DEBUG
+            // set to 30 seconds in debug build
+            return 30000;
+        #else
+            struct timeval tv = writing ? wtimeo() : rtimeo();
+            return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        #endif
+    }
+
     void set_sock_opts()
     {
         evutil_make_socket_closeonexec(_sock_fd);
@@ -394,32 +394,32 @@ private:
         if(setsockopt(_sock_fd, SOL_SOCKET, SO_KEEPALIVE,
             (void*)&on, sizeof(on)) == -1
         )
-            return _log->fatal("SOL_SOCKET, SO_KEEPALIVE");
+            return log()->fatal("SOL_SOCKET, SO_KEEPALIVE");
         set_conn_flag(conn_flags::keepalive);
         if(setsockopt(_sock_fd, SOL_SOCKET, SO_REUSEADDR,
             (void*)&on, sizeof(on)) == -1
         )
-            return _log->fatal("SOL_SOCKET, SO_REUSEADDR");
+            return log()->fatal("SOL_SOCKET, SO_REUSEADDR");
         if(setsockopt(_sock_fd, SOL_SOCKET, SO_REUSEPORT,
             (void*)&on, sizeof(on)) == -1
         ){
             if(errno != EOPNOTSUPP)
-                return _log->fatal("SOL_SOCKET, SO_REUSEPORT");
-            EVMVC_DBG(_log, "SO_REUSEPORT NOT SUPPORTED");
+                return log()->fatal("SOL_SOCKET, SO_REUSEPORT");
+            EVMVC_DBG(log(), "SO_REUSEPORT NOT SUPPORTED");
         }
         if(setsockopt(_sock_fd, IPPROTO_TCP, TCP_NODELAY,
             (void*)&on, sizeof(on)) == -1
         ){
             if(errno != EOPNOTSUPP)
-                return _log->fatal("IPPROTO_TCP, TCP_NODELAY");
-            EVMVC_DBG(_log, "TCP_NODELAY NOT SUPPORTED");
+                return log()->fatal("IPPROTO_TCP, TCP_NODELAY");
+            EVMVC_DBG(log(), "TCP_NODELAY NOT SUPPORTED");
         }
         if(setsockopt(_sock_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
             (void*)&on, sizeof(on)) == -1
         ){
             if(errno != EOPNOTSUPP)
-                return _log->fatal("IPPROTO_TCP, TCP_DEFER_ACCEPT");
-            EVMVC_DBG(_log, "TCP_DEFER_ACCEPT NOT SUPPORTED");
+                return log()->fatal("IPPROTO_TCP, TCP_DEFER_ACCEPT");
+            EVMVC_DBG(log(), "TCP_DEFER_ACCEPT NOT SUPPORTED");
         }
     }
 
@@ -429,6 +429,10 @@ private:
     static void on_connection_event(
         struct bufferevent* bev, short events, void* arg
     );
+    static void on_connection_sent(
+        struct evbuffer* buf, const struct evbuffer_cb_info* info, void* arg
+    );
+    static void on_connection_idle(wheel_timer* t, void* arg);
 
 
     void _send_file_chunk_start();
@@ -438,7 +442,8 @@ private:
 
     int _closed;
     int _id;
-    md::log::logger _log;
+    md::log::logger _parent_log;
+    mutable md::log::logger _log;
     wp_http_worker _worker;
     child_server _server;
     int _sock_fd;
@@ -459,6 +464,8 @@ private:
 
     std::shared_ptr<http_parser> _parser = nullptr;
     shared_file_reply _file = nullptr;
+
+    wheel_timer _idle_timer;
 };
 
 
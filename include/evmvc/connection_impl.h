@@ -38,8 +38,10 @@ inline void connection::close()
     if(_closed)
         return;
     _closed = true;
-    EVMVC_TRACE(this->_log, "closing\n{}", this->debug_string());
+    EVMVC_TRACE(this->log(), "closing\n{}", this->debug_string());
+    worker_metrics().connections_open.fetch_sub(1, std::memory_order_relaxed);
     
+    _idle_timer.cancel();
     if(_parser)
         _parser.reset();
     if(_resume_ev){
@@ -65,7 +67,7 @@ inline void connection::close()
 
 inline void connection::_send_file_chunk_start()
 {
-    EVMVC_TRACE(_log, "_send_file_chunk_start");
+    EVMVC_TRACE(log(), "_send_file_chunk_start");
     
     _file->res->headers().remove("Content-Length");
     _file->res->headers().set("Transfer-Encoding", "chunked");
@@ -78,11 +80,11 @@ inline void connection::_send_chunk(struct evbuffer* chunk)
 {
     size_t cs = evbuffer_get_length(chunk);
     if(cs == 0){
-        EVMVC_TRACE(_log, "_send_chunk, size: 0");
+        EVMVC_TRACE(log(), "_send_chunk, size: 0");
         return;
     }
     
-    EVMVC_TRACE(_log, "_send_chunk, size: {}", cs);
+    EVMVC_TRACE(log(), "_send_chunk, size: {}", cs);
     
     struct evbuffer* out = bev_out();
     evbuffer_add_printf(out, "%x\r\n", (unsigned)cs);
@@ -93,75 +95,45 @@ inline void connection::_send_chunk(struct evbuffer* chunk)
 
 inline void connection::_send_file_chunk_end()
 {
-    EVMVC_TRACE(_log, "_send_file_chunk_end");
+    EVMVC_TRACE(log(), "_send_file_chunk_end");
 
     evbuffer_add(bev_out(), "0\r\n\r\n", 5);
     bufferevent_flush(_bev, EV_WRITE, BEV_FLUSH);
     unset_conn_flag(conn_flags::sending_file);
+    _file->res->_record_reply(*this);
     _file.reset();
     complete_response();
 }
 
 inline evmvc::status connection::_send_file_chunk()
 {
-    char buf[EVMVC_READ_BUF_SIZE];
-    size_t bytes_read;
-    
-    /* try to read EVMVC_READ_BUF_SIZE bytes from the file pointer */
-    bytes_read = fread(buf, 1, sizeof(buf), _file->file_desc);
+    // the write callback only fires again when something is queued
+    bool eof;
+    try{
+        eof = _file->read_chunk();
+    }catch(const std::exception& err){
+        // no last chunk, the client must not take the body as complete
+        _file->res->log()->error(MD_ERR(
+            "Unable to send the file '{}'\n{}",
+            _file->res->req()->uri().to_string(), err.what()
+        ));
+        unset_conn_flag(conn_flags::sending_file);
+        _file.reset();
+        this->close();
+        return evmvc::status::internal_server_error;
+    }
     
-    if(bytes_read > 0){
-        // verify if we need to compress data
-        if(_file->zs){
-            _file->zs->next_in = (Bytef*)buf;
-            _file->zs->avail_in = bytes_read;
-            
-            // retrieve the compressed bytes blockwise.
-            int ret;
-            char zbuf[EVMVC_READ_BUF_SIZE];
-            int flush_mode = feof(_file->file_desc) ?
-                Z_FINISH : Z_SYNC_FLUSH;
-            bytes_read = 0;
-            
-            _file->zs->next_out = reinterpret_cast<Bytef*>(zbuf);
-            _file->zs->avail_out = sizeof(zbuf);
-            
-            ret = deflate(_file->zs, flush_mode);
-            if(_file->zs_size < _file->zs->total_out){
-                bytes_read += _file->zs->total_out - _file->zs_size;
-                evbuffer_add(
-                    _file->buffer,
-                    zbuf,
-                    _file->zs->total_out - _file->zs_size
-                );
-                _file->zs_size = _file->zs->total_out;
-            }
-            
-            if(ret != Z_OK && ret != Z_STREAM_END){
-                _file->res->log()->error(
-                    "zlib deflate function returned: '{}'",
-                    ret
-                );
-                this->_send_file_chunk_end();
-                return evmvc::status::internal_server_error;
-            }
-            
-        }else{
-            evbuffer_add(_file->buffer, buf, bytes_read);
-        }
+    if(evbuffer_get_length(_file->buffer) > 0){
+        EVMVC_TRACE(_file->res->log(),
+            "Sending {} bytes for '{}'",
+            evbuffer_get_length(_file->buffer),
+            _file->res->req()->uri().to_string()
+        );
         
-        if(bytes_read > 0){
-            EVMVC_TRACE(_file->res->log(),
-                "Sending {} bytes for '{}'",
-                bytes_read, _file->res->req()->uri().to_string()
-            );
-            
-            _send_chunk(_file->buffer);
-            evbuffer_drain(_file->buffer, bytes_read);
-        }
+        _send_chunk(_file->buffer);
     }
     
-    if(feof(_file->file_desc)){
+    if(eof){
         EVMVC_TRACE(_file->res->log(),
             "Sending last chunk for '{}'",
             _file->res->req()->uri().to_string()
@@ -182,7 +154,7 @@ inline void connection::on_connection_resume(
     int /*fd*/, short /*events*/, void* arg)
 {
     connection* c = (connection*)arg;
-    EVMVC_DBG(c->_log, "resuming");
+    EVMVC_DBG(c->log(), "resuming");
     
     c->unset_conn_flag(conn_flags::paused);
     
@@ -197,24 +169,24 @@ inline void connection::on_connection_resume(
     }
     
     if(evbuffer_get_length(c->bev_out())){
-        EVMVC_DBG(c->_log, "SET WAITING");
+        EVMVC_DBG(c->log(), "SET WAITING");
 
         c->set_conn_flag(conn_flags::waiting);
         if(!(bufferevent_get_enabled(c->_bev) & EV_WRITE)){
-            EVMVC_DBG(c->_log, "ENABLING EV_WRITE");
+            EVMVC_DBG(c->log(), "ENABLING EV_WRITE");
             bufferevent_enable(c->_bev, EV_WRITE);
         }
         
         return;
     }else{
-        EVMVC_DBG(c->_log, "SET READING");
+        EVMVC_DBG(c->log(), "SET READING");
         if(!(bufferevent_get_enabled(c->_bev) & EV_READ)){
-            EVMVC_DBG(c->_log, "ENABLING EV_READ | EV_WRITE");
+            EVMVC_DBG(c->log(), "ENABLING EV_READ | EV_WRITE");
             bufferevent_enable(c->_bev, EV_READ | EV_WRITE);
         }
         
         if(evbuffer_get_length(c->bev_in())){
-            EVMVC_DBG(c->_log, "data available calling on_connection_read");
+            EVMVC_DBG(c->log(), "data available calling on_connection_read");
             on_connection_read(c->_bev, arg);
         }
         
@@ -227,7 +199,8 @@ inline void connection::on_connection_read(
     struct bufferevent* /*bev*/, void* arg)
 {
     connection* c = (connection*)arg;
-    EVMVC_TRACE(c->_log, "on_connection_read\n{}", c->debug_string());
+    EVMVC_TRACE(c->log(), "on_connection_read\n{}", c->debug_string());
+    c->_idle_timer.arm(c->_idle_ms(false));
     
     if(c->_parser->ended())
         c->_parser->reset();
@@ -249,6 +222,7 @@ inline void connection::on_connection_read(
         evbuffer_drain(c->bev_in(), n);
     
     if(ec){
+        worker_metrics().parser_errors.fetch_add(1, std::memory_order_relaxed);
         c->log()->error("Parse error:\n{}", ec);
         c->close();
         //c->set_conn_flag(conn_flags::error);
@@ -282,7 +256,7 @@ inline void connection::on_connection_read(
     // size_t nread = c->_parser->parse((const char*)buf, ilen, ec);
     // if(nread > 0)
     //     evbuffer_drain(c->bev_in(), nread);
-    // EVMVC_TRACE(c->_log, "Parsing done, nread: {}", nread);
+    // EVMVC_TRACE(c->log(), "Parsing done, nread: {}", nread);
     
     // if(ec){
     //     c->log()->error("Parse error:\n{}", ec);
@@ -306,7 +280,8 @@ inline void connection::on_connection_write(
     struct bufferevent* /*bev*/, void* arg)
 {
     connection* c = (connection*)arg;
-    EVMVC_TRACE(c->_log, "on_connection_write\n{}", c->debug_string());
+    EVMVC_TRACE(c->log(), "on_connection_write\n{}", c->debug_string());
+    c->_idle_timer.arm(c->_idle_ms(false));
     
     if(c->flag_is(conn_flags::paused))
         return;
@@ -356,12 +331,38 @@ inline void connection::on_connection_write(
     // }
 }
 
+inline void connection::on_connection_sent(
+    struct evbuffer* /*buf*/, const struct evbuffer_cb_info* info,
+    void* arg)
+{
+    connection* c = (connection*)arg;
+    if(info->n_added > 0 && c->_parser)
+        c->_parser->_bytes_out += info->n_added;
+    
+    if(info->n_deleted == 0)
+        return;
+    
+    worker_metrics().bytes_sent.fetch_add(
+        info->n_deleted, std::memory_order_relaxed
+    );
+    // the write progressed, the output is idle again for wtimeo
+    if(!c->_closed)
+        c->_idle_timer.arm(c->_idle_ms(true));
+}
+
+inline void connection::on_connection_idle(wheel_timer* /*t*/, void* arg)
+{
+    connection* c = (connection*)arg;
+    EVMVC_TRACE(c->log(), "idle timeout\n{}", c->debug_string());
+    c->close();
+}
+
 inline void connection::on_connection_event(
     struct bufferevent* /*bev*/, short events, void* arg)
 {
     connection* c = (connection*)arg;
     
-    EVMVC_TRACE(c->_log,
+    EVMVC_TRACE(c->log(),
         "conn: {}\n"
         "events: {}{}{}{}",
         c->debug_string(),
@@ -377,7 +378,7 @@ inline void connection::on_connection_event(
     }
     
     if((events & BEV_EVENT_CONNECTED)){
-        //EVMVC_DBG(c->_log, "CONNECTED");
+        //EVMVC_DBG(c->log(), "CONNECTED");
         return;
     }
     
@@ -385,7 +386,7 @@ inline void connection::on_connection_event(
         // ssl error
         unsigned long ssl_err = ERR_get_error();
         if(ssl_err != 0){
-            c->_log->error(MD_ERR(
+            c->log()->error(MD_ERR(
                 "SSL {} {}", ssl_err, ERR_error_string(ssl_err, nullptr)
             ));
             c->close();
@@ -395,9 +396,9 @@ inline void connection::on_connection_event(
     
     
     if(events == (BEV_EVENT_EOF | BEV_EVENT_READING)){
-        EVMVC_TRACE(c->_log, "EOF | READING");
+        EVMVC_TRACE(c->log(), "EOF | READING");
         if(errno == EAGAIN || errno == EWOULDBLOCK){
-            EVMVC_TRACE(c->_log, "errno EAGAIN or EWOULDBLOCK");
+            EVMVC_TRACE(c->log(), "errno EAGAIN or EWOULDBLOCK");
             
             // enable read if not already enabled
             if(!(bufferevent_get_enabled(c->_bev) & EV_READ))
@@ -411,7 +412,7 @@ inline void connection::on_connection_event(
     }
     
     if((events & BEV_EVENT_EOF) == BEV_EVENT_EOF){
-        EVMVC_TRACE(c->_log, MD_ERR("Connection closed!"));
+        EVMVC_TRACE(c->log(), MD_ERR("Connection closed!"));
         c->close();
     }
     
@@ -29,6 +29,7 @@ SOFTWARE.
 #include "url.h"
 #include "utils.h"
 #include "fields.h"
+#include "cached_clock.h"
 
 #include "date/date.h"
 
@@ -103,15 +104,12 @@ public:
     http_cookies_t() = delete;
     http_cookies_t(
         uint64_t id,
-        md::log::logger log,
+        wp_connection conn,
         const evmvc::route& rt,
-        const url& uri,
         header_map hdrs
         )
         : _id(id),
-        _log(log->add_child(
-            "cookies-" + md::num_to_str(id, false) + uri.path()
-        )),
+        _conn(conn),
         _rt(rt),
         _in_hdrs(hdrs),
         _out_hdrs(std::make_shared<header_map_t>()),
@@ -128,6 +126,16 @@ public:
     uint64_t id() const { return _id;}
     evmvc::route get_route()const { return _rt;}
     
+    // the child logger is only created once something is logged
+    md::log::logger log() const
+    {
+        if(!_log)
+            _log = _internal::request_logger(_conn, _rt)->add_child(
+                "cookies-" + md::num_to_str(_id, false)
+            );
+        return _log;
+    }
+    
     bool exists(md::string_view name) const
     {
         _init_get();
@@ -401,20 +409,12 @@ private:
         cv += enc_v + "; ";
         
         if(opts.max_age < 0 && opts.expires){
-            auto daypoint = date::floor<date::days>(*opts.expires);
-            auto ymd = date::year_month_day(daypoint);
-            auto tod = date::make_time(*opts.expires - daypoint);
-            cv += fmt::format(
-                "Expires={0}, {1:=02d} {2:=02d} {3:=04d} "
-                "{4:=02d}:{5:=02d}:{6:=02d} GMT; ",
-                date::format("%a", date::weekday(ymd)),
-                (unsigned int)ymd.day(),
-                (unsigned int)ymd.month(),
-                (int)ymd.year(),
-                tod.hours().count(),
-                tod.minutes().count(),
-                tod.seconds().count()
-            );
+            char exp[EVMVC_HTTP_DATE_LEN];
+            cv += "Expires=";
+            cv.append(exp, format_http_date(
+                opts.expires->time_since_epoch().count(), exp
+            ));
+            cv += "; ";
         }
         
         if(opts.max_age > -1)
@@ -477,7 +477,7 @@ private:
                 while((size_t)ks <= i && hv[ks] == ' ')
                     ++ks;
                 if((size_t)ks == i){
-                    _log->warn(
+                    log()->warn(
                         "Invalid cookie value: '{0}'", hv
                     );
                     return;
@@ -485,7 +485,7 @@ private:
                 
                 svk = md::string_view(hv.c_str() + ks, i - ks);
                 if(i == hvl -1){
-                    _log->warn(
+                    log()->warn(
                         "Invalid cookie value: '{0}'", hv
                     );
                     return;
@@ -531,7 +531,8 @@ private:
     }
     
     uint64_t _id;
-    md::log::logger _log;
+    wp_connection _conn;
+    mutable md::log::logger _log;
     evmvc::route _rt;
     header_map _in_hdrs;
     header_map _out_hdrs;
@@ -26,6 +26,7 @@ SOFTWARE.
 #define _libevmvc_events_h
 
 #include "stable_headers.h"
+#include "timer_wheel.h"
 
 namespace evmvc { 
 
@@ -61,18 +62,23 @@ protected:
 };
 typedef std::shared_ptr<event_wrapper_base> shared_evw;
 
+// the events are only used by the event loop of the process
 inline std::unordered_map<std::string, shared_evw>& named_events()
 {
     static std::unordered_map<std::string, shared_evw> _events;
     return _events;
 }
 
-//inline std::mutex& events_mutex()
-inline std::recursive_mutex& events_mutex()
+// removes the registration of ev, the returned pointer must be released
+// once ev is no longer used
+inline shared_evw unregister_event(event_wrapper_base* ev)
 {
-//    static std::mutex _m;
-    static std::recursive_mutex _m;
-    return _m;
+    auto it = named_events().find(ev->name());
+    if(it == named_events().end() || it->second.get() != ev)
+        return nullptr;
+    shared_evw self = it->second;
+    named_events().erase(it);
+    return self;
 }
 
 
@@ -81,10 +87,6 @@ class event_wrapper
     : public std::enable_shared_from_this<event_wrapper<T>>,
     public event_wrapper_base
 {
-    struct void_event_wrapper
-    {
-        std::shared_ptr<event_wrapper<T>> ew;
-    };
 public:
     event_wrapper(
         md::string_view name,
@@ -96,7 +98,7 @@ public:
     )
         : event_wrapper_base(name), ev_base(_ev_base), ev(nullptr),
         res(_res), nxt(_nxt),
-        arg(T()), cb(_cb), _fd(fd), _events(events), _ewt(nullptr)
+        arg(T()), cb(_cb), _fd(fd), _events(events)
     {
     }
 
@@ -110,7 +112,7 @@ public:
     )
         : ev_base(_ev_base), ev(nullptr),
         res(_res), nxt(_nxt),
-        arg(_arg), cb(_cb), _fd(fd), _events(events), _ewt(nullptr)
+        arg(_arg), cb(_cb), _fd(fd), _events(events)
     {
     }
     
@@ -136,24 +138,16 @@ public:
     
     void stop()
     {
-        std::unique_lock<std::recursive_mutex> lock(events_mutex());
-        if(_ewt){
-            delete this->_ewt;
-            this->_ewt = nullptr;
+        if(this->ev){
+            event_del(this->ev);
+            event_free(this->ev);
+            this->ev = nullptr;
         }
         
-        event_del(this->ev);
-        event_free(this->ev);
-        this->ev = nullptr;
-        
-        auto it = named_events().find(_name);
-        if(it == named_events().end())
-            return;
-        auto self = it->second;
-        named_events().erase(it);
-        lock.unlock();
+        // released last, this may be destroyed with them
+        auto reg = unregister_event(this);
+        auto self = std::move(_self);
         res.reset();
-        self.reset();
     }
     
     event_base* ev_base;
@@ -168,25 +162,25 @@ public:
 private:
     void _create_event()
     {
-        _ewt = new void_event_wrapper();
-        _ewt->ew = this->shared_from_this();
+        _self = this->shared_from_this();
         
         this->ev = event_new(ev_base, _fd, (short)_events, 
             [](int fd, short opts, void* self_arg)->void{
-                void_event_wrapper* ewt = (void_event_wrapper*)self_arg;
-                std::shared_ptr<event_wrapper> self = ewt->ew;
+                std::shared_ptr<event_wrapper> self =
+                    ((event_wrapper*)self_arg)->_self;
                 
                 self->cb(self, fd, (event_type)opts, self->arg);
                 if((self->_events & event_type::persist) != event_type::persist)
                     self->stop();
             },
-            (void*)_ewt
+            (void*)this
         );
     }
     
     int _fd;
     event_type _events;
-    void_event_wrapper* _ewt;
+    // keeps the wrapper alive while its event is pending
+    std::shared_ptr<event_wrapper<T>> _self;
 };
 
 
@@ -195,10 +189,6 @@ class event_wrapper<void>
     : public std::enable_shared_from_this<event_wrapper<void>>,
     public event_wrapper_base
 {
-    struct void_event_wrapper
-    {
-        std::shared_ptr<event_wrapper<void>> ew;
-    };
 public:
     event_wrapper(
         md::string_view name,
@@ -210,7 +200,8 @@ public:
     )
         : event_wrapper_base(name), ev_base(_ev_base), ev(nullptr),
         res(_res), nxt(_nxt),
-        cb(_cb), _fd(fd), _events(events), _ewt(nullptr)
+        cb(_cb), _fd(fd), _events(events),
+        _timer(event_wrapper::_on_timer, this), _ms(0)
     {
     }
     
@@ -229,6 +220,16 @@ public:
     
     void wait(const struct timeval& tv)
     {
+        // the plain timers are armed on the timer wheel
+        if(_fd == -1 && (_events & (
+            event_type::read | event_type::write | event_type::signal
+        )) == event_type::none){
+            _self = this->shared_from_this();
+            _ms = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+            _timer.arm(_ms);
+            return;
+        }
+        
         this->_create_event();
         if(event_add(this->ev, &tv) == -1)
             throw MD_ERR("event_add failed!");
@@ -236,26 +237,16 @@ public:
     
     void stop()
     {
-        std::unique_lock<std::recursive_mutex> lock(events_mutex());
-        
-        if(_ewt){
-            delete this->_ewt;
-            this->_ewt = nullptr;
-        }
-        
+        _timer.cancel();
         if(this->ev){
             event_del(this->ev);
             event_free(this->ev);
             this->ev = nullptr;
         }
         
-        auto it = named_events().find(_name);
-        if(it == named_events().end())
-            return;
-        auto self = it->second;
-        named_events().erase(it);
-        lock.unlock();
-        self.reset();
+        // released last, this may be destroyed with them
+        auto reg = unregister_event(this);
+        auto self = std::move(_self);
     }
     
     event_base* ev_base;
@@ -269,25 +260,39 @@ public:
 private:
     void _create_event()
     {
-        _ewt = new void_event_wrapper();
-        _ewt->ew = this->shared_from_this();
+        _self = this->shared_from_this();
         
         this->ev = event_new(ev_base, _fd, (short)_events, 
             [](int fd, short opts, void* self_arg)->void{
-                void_event_wrapper* ewt = (void_event_wrapper*)self_arg;
-                std::shared_ptr<event_wrapper> self = ewt->ew;
+                std::shared_ptr<event_wrapper> self =
+                    ((event_wrapper*)self_arg)->_self;
                 
                 self->cb(self, fd, (event_type)opts);
                 if((self->_events & event_type::persist) != event_type::persist)
                     self->stop();
             },
-            (void*)_ewt
+            (void*)this
         );
     }
     
+    static void _on_timer(wheel_timer* /*t*/, void* arg)
+    {
+        std::shared_ptr<event_wrapper> self = ((event_wrapper*)arg)->_self;
+        
+        self->cb(self, -1, event_type::timed_out);
+        if((self->_events & event_type::persist) != event_type::persist)
+            self->stop();
+        // not re-armed when stopped by the callback
+        else if(self->_self && !self->_timer.armed())
+            self->_timer.arm(self->_ms);
+    }
+    
     int _fd;
     event_type _events;
-    void_event_wrapper* _ewt;
+    wheel_timer _timer;
+    uint64_t _ms;
+    // keeps the wrapper alive while its event is pending
+    std::shared_ptr<event_wrapper<void>> _self;
 };
 
 
@@ -337,7 +342,6 @@ private:
 
 inline std::string next_event_name()
 {
-    std::unique_lock<std::recursive_mutex> lock(events_mutex());
     static size_t uid = 0;
     return "da724ca0-308c-11e9-9071-5b3166957f05_" + md::num_to_str(++uid);
 }
@@ -345,7 +349,6 @@ inline std::string next_event_name()
 inline void register_event(shared_evw ev)
 {
     EVMVC_DEF_TRACE("Registering event: '{}'", ev->name());
-    std::unique_lock<std::recursive_mutex> lock(_internal::events_mutex());
     auto it = named_events().find(ev->name());
     if(it != named_events().end())
         throw MD_ERR(
@@ -356,8 +359,6 @@ inline void register_event(shared_evw ev)
 
 inline bool event_exists(const std::string& name)
 {
-    std::unique_lock<std::recursive_mutex> lock(events_mutex());
-    
     auto it = named_events().find(name);
     return it != named_events().end();
 }
@@ -366,16 +367,12 @@ inline bool event_exists(const std::string& name)
 
 inline bool timeout_exists(md::string_view name)
 {
-    //std::unique_lock<std::recursive_mutex> lock(_internal::events_mutex());
-
     std::string n = "to:" + name.to_string();
     return _internal::event_exists(n);
 }
 
 inline bool interval_exists(md::string_view name)
 {
-    //std::unique_lock<std::recursive_mutex> lock(_internal::events_mutex());
-
     std::string n = "iv:" + name.to_string();
     return _internal::event_exists(n);
 }
@@ -384,14 +381,12 @@ inline void clear_events()
 {
     EVMVC_DEF_TRACE("Clearing all events");
     
-    std::unique_lock<std::recursive_mutex> lock(_internal::events_mutex());
     std::vector<_internal::shared_evw> evs;
     for(auto it = _internal::named_events().begin();
         it != _internal::named_events().end(); ++it)
         evs.emplace_back(it->second);
     _internal::named_events().clear();
     
-    lock.unlock();
     for(auto& ev : evs)
         ev->stop();
 }
@@ -400,7 +395,6 @@ inline void clear_timeouts()
 {
     EVMVC_DEF_TRACE("Clearing all timeouts");
     
-    std::unique_lock<std::recursive_mutex> lock(_internal::events_mutex());
     std::vector<_internal::shared_evw> evs;
     auto it = _internal::named_events().begin();
     while(it != _internal::named_events().end()){
@@ -412,7 +406,6 @@ inline void clear_timeouts()
         ++it;
     }
     
-    lock.unlock();
     for(auto& ev : evs)
         ev->stop();
 }
@@ -420,7 +413,6 @@ inline void clear_intervals()
 {
     EVMVC_DEF_TRACE("Clearing all intervals");
     
-    std::unique_lock<std::recursive_mutex> lock(_internal::events_mutex());
     std::vector<_internal::shared_evw> evs;
     auto it = _internal::named_events().begin();
     while(it != _internal::named_events().end()){
@@ -432,7 +424,6 @@ inline void clear_intervals()
         ++it;
     }
     
-    lock.unlock();
     for(auto& ev : evs)
         ev->stop();
 }
@@ -442,12 +433,10 @@ inline void clear_timeout(md::string_view name)
 {
     EVMVC_DEF_TRACE("Clearing timeout '{}'", name);
     
-    std::unique_lock<std::recursive_mutex> lock(_internal::events_mutex());
     auto ns = "to:" + name.to_string();
     auto it = _internal::named_events().find(ns);
     if(it == _internal::named_events().end())
         return;
-    lock.unlock();
     it->second->stop();
 }
 
@@ -455,12 +444,10 @@ inline void clear_interval(md::string_view name)
 {
     EVMVC_DEF_TRACE("Clearing interval '{}'", name);
     
-    std::unique_lock<std::recursive_mutex> lock(_internal::events_mutex());
     auto ns = "iv:" + name.to_string();
     auto it = _internal::named_events().find(ns);
     if(it == _internal::named_events().end())
         return;
-    lock.unlock();
     it->second->stop();
 }
 inline void clear_timeout(std::shared_ptr<_internal::event_wrapper_base> ev)
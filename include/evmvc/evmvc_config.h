@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// the configured options and settings for libevmvc
+
+#ifndef _EVMVC_CONFIG_H_
+#define _EVMVC_CONFIG_H_
+
+#define EVMVC_VERSION_NAME "libevmvc/0.1.0"
+#define EVMVC_VERSION "0.1.0"
+#define EVMVC_VERSION_MAJOR 0
+#define EVMVC_VERSION_MINOR 1
+#define EVMVC_VERSION_PATCH 0
+
+#ifdef _DEBUG
+#define CMAKE_COMMAND "/usr/bin/cmake"
+#define EVMVC_PROJECT_SOURCE_DIR "/root/repo"
+#define EVMVC_PROJECT_BINARY_DIR "/tmp/bld"
+#endif
+
+#define EVMVC_ICU_VERSION "72.1.0"
+
+// defines the type of build
+#define EVMVC_BUILD_DEBUG 1
+/* #undef EVMVC_BUILD_RELEASE */
+
+#if !(defined(EVMVC_BUILD_DEBUG) || defined(EVMVC_BUILD_RELEASE))
+    #define EVMVC_BUILD_DEBUG 1
+#endif
+
+#ifndef EVMVC_BUILD_DEBUG
+    #define EVMVC_BUILD_DEBUG 0
+#endif
+#ifndef EVMVC_BUILD_RELEASE
+    #define EVMVC_BUILD_RELEASE 0
+#endif
+
+// arch
+// Check windows
+#if _WIN32 || _WIN64
+    #if _WIN64
+        #define ARCH64
+        #define PLATFORM_64BITS 1
+    #else
+        #define ARCH32
+        #define PLATFORM_64BITS 0
+    #endif
+#endif
+
+// Check GCC
+#if __GNUC__
+    #if __x86_64__ || __ppc64__
+        #define ARCH64
+        #define PLATFORM_64BITS 1
+    #else
+        #define ARCH32
+        #define PLATFORM_64BITS 0
+    #endif
+#endif
+
+#if WIN32
+    #define EVMVC_FORCEINLINE __forceinline
+#elif _GCC || __GNUC__
+    #define EVMVC_FORCEINLINE inline __attribute((always_inline))
+#endif
+
+#define EVMVC_THREAD_SAFE 1
+
+// optional response compression libraries
+#define EVMVC_HAS_BROTLI 1
+/* #undef EVMVC_HAS_ZSTD */
+
+#endif //_EVMVC_CONFIG_H_
@@ -0,0 +1,42 @@
+
+#ifndef EVMVC_CLIENT_API_H
+#define EVMVC_CLIENT_API_H
+
+#ifdef EVMVC_STATIC_DEFINE
+#  define EVMVC_CLIENT_API
+#  define EVMVC_NO_EXPORT
+#else
+#  ifndef EVMVC_CLIENT_API
+#    ifdef evmvc_EXPORTS
+        /* We are building this library */
+#      define EVMVC_CLIENT_API 
+#    else
+        /* We are using this library */
+#      define EVMVC_CLIENT_API 
+#    endif
+#  endif
+
+#  ifndef EVMVC_NO_EXPORT
+#    define EVMVC_NO_EXPORT 
+#  endif
+#endif
+
+#ifndef EVMVC_DEPRECATED
+#  define EVMVC_DEPRECATED 
+#endif
+
+#ifndef EVMVC_DEPRECATED_EXPORT
+#  define EVMVC_DEPRECATED_EXPORT EVMVC_CLIENT_API EVMVC_DEPRECATED
+#endif
+
+#ifndef EVMVC_DEPRECATED_NO_EXPORT
+#  define EVMVC_DEPRECATED_NO_EXPORT EVMVC_NO_EXPORT EVMVC_DEPRECATED
+#endif
+
+#if 0 /* DEFINE_NO_DEPRECATED */
+#  ifndef EVMVC_NO_DEPRECATED
+#    define EVMVC_NO_DEPRECATED
+#  endif
+#endif
+
+#endif /* EVMVC_CLIENT_API_H */
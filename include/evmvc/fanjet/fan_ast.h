@@ -1390,6 +1390,20 @@ protected:
         return this->markup_language.substr(2);
     }
     
+    // @cache(key, ttl){ ... }
+    bool is_cache_section() const
+    {
+        return
+            boost::starts_with(this->markup_language, "#>");
+    }
+    
+    std::string cache_args() const
+    {
+        if(!is_cache_section())
+            return "";
+        return this->markup_language.substr(2);
+    }
+    
 private:
     std::string in_markdown_code;
     size_t braces;
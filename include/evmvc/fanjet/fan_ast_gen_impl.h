@@ -29,10 +29,10 @@ namespace evmvc { namespace fanjet { namespace ast {
 
 typedef std::function<std::string(const std::string&)> escape_fn;
 
-std::string unique_ident(std::string prefix = "__evmvc_fanjet_ast_")
+std::string unique_ident(
+    document doc, std::string prefix = "__evmvc_fanjet_ast_")
 {
-    static size_t n = 0;
-    return prefix + "_" + md::num_to_str(++n, false);
+    return prefix + "_" + md::num_to_str(++doc->ident_seq, false);
 }
 
 std::string align_src(document doc, const node_t* n)
@@ -124,7 +124,7 @@ std::string replace_fan_keys(document doc, const std::string& s)
 std::string write_tokens(
     document doc,
     node& tok_node, escape_fn esc = nullptr,
-    const std::string& prefix = "@this->write_raw(",
+    const std::string& prefix = "@this->write_lit(",
     const std::string& suffix = ");"
     )
 {
@@ -150,7 +150,7 @@ std::string write_tokens_limit(
     node& tok_node,
     node& tok_limit,
     escape_fn esc = nullptr,
-    const std::string& prefix = "@this->write_raw(",
+    const std::string& prefix = "@this->write_lit(",
     const std::string& suffix = ");"
     )
 {
@@ -172,6 +172,74 @@ std::string write_tokens_limit(
 }
 
 
+// returns the position following the string literals starting at pos
+inline size_t skip_cpp_literals(const std::string& src, size_t pos)
+{
+    size_t end = std::string::npos;
+    while(pos < src.size()){
+        char c = src[pos];
+        if(c == ' ' || c == '\n' || c == '\t'){
+            ++pos;
+            continue;
+        }
+        if(c != '"')
+            break;
+        
+        ++pos;
+        while(pos < src.size() && src[pos] != '"')
+            pos += src[pos] == '\\' ? 2 : 1;
+        if(pos >= src.size())
+            return std::string::npos;
+        end = ++pos;
+    }
+    return end;
+}
+
+/*
+    folds the static output of the generated source,
+    adjacent html buffers are merged then consecutive write_lit calls
+    are joined into a single literal.
+*/
+inline std::string fold_static_writes(
+    const std::string& self_name, const std::string& src)
+{
+    std::string s = src;
+    md::replace_substring(s,
+        self_name + "->commit_write(\"html\");" +
+        self_name + "->begin_write(\"html\");",
+        ""
+    );
+    
+    std::string call = self_name + "->write_lit(";
+    std::string out;
+    size_t pos = 0;
+    size_t p;
+    while((p = s.find(call, pos)) != std::string::npos){
+        out.append(s, pos, p - pos);
+        
+        std::string lits;
+        size_t e = p;
+        while(s.compare(e, call.size(), call) == 0){
+            size_t lb = e + call.size();
+            size_t le = skip_cpp_literals(s, lb);
+            if(le == std::string::npos || s.compare(le, 2, ");") != 0)
+                break;
+            lits.append(s, lb, le - lb);
+            e = le + 2;
+        }
+        
+        if(e == p){
+            out += call;
+            pos = p + call.size();
+            continue;
+        }
+        out += call + lits + ");";
+        pos = e;
+    }
+    out.append(s, pos, std::string::npos);
+    return out;
+}
+
 inline std::string gen_code_block(
     bool dbg, std::vector<document>& docs, document doc,
     const std::vector<node>& tns)
@@ -273,7 +341,7 @@ inline std::string root_node_t::gen_header_code(
     body = 3    
     */
     
-    std::string exec_fn = unique_ident("__exec_" + doc->cls_name);
+    std::string exec_fn = unique_ident(doc, "__exec_" + doc->cls_name);
     std::string cls_foot = fmt::format(
         "\n\npublic:\n"
         // constructor
@@ -334,7 +402,7 @@ inline std::string root_node_t::gen_header_code(
         doc->cb_name,
         doc->self_name
     );
-    std::string next_fn = unique_ident("__exec_" + doc->cls_name);
+    std::string next_fn = unique_ident(doc, "__exec_" + doc->cls_name);
     
     ast::literal_node ln = 
         std::static_pointer_cast<ast::literal_node_t>(this->child(0));
@@ -367,7 +435,7 @@ inline std::string root_node_t::gen_header_code(
                 doc->cb_name
             );
             
-            next_fn = unique_ident("__exec_" + doc->cls_name);
+            next_fn = unique_ident(doc, "__exec_" + doc->cls_name);
             
         }else if(n->node_type() != ast::node_type::directive)
             cls_body += n->gen_header_code(dbg, docs, doc);
@@ -402,6 +470,7 @@ inline std::string root_node_t::gen_header_code(
         n = n->next();
     }
     
+    cls_body = fold_static_writes(doc->self_name, cls_body);
     md::replace_substring(cls_body, "@}", "}");
     md::replace_substring(cls_body, "@@", "@");
     
@@ -491,6 +560,14 @@ inline std::string literal_node_t::gen_header_code(
                     
                 }
                 
+            // @cache(key, ttl){ ... }
+            }else if(this->is_cache_section()){
+                s += fmt::format(
+                    "if({}->begin_cache({})){{{}->begin_write(\"html\");",
+                    doc->self_name, replace_fan_keys(doc, this->cache_args()),
+                    doc->self_name
+                );
+                
             }else{
                 s += fmt::format(
                     "{}->begin_write(\"{}\");",
@@ -548,6 +625,12 @@ inline std::string literal_node_t::gen_header_code(
                     
                 }
                 
+            }else if(this->is_cache_section()){
+                s += fmt::format(
+                    "{}->commit_write(\"html\");{}->commit_cache();}}",
+                    doc->self_name, doc->self_name
+                );
+                
             }else{
                 s += fmt::format(
                     "{}->commit_write(\"{}\");",
@@ -889,26 +972,8 @@ inline std::string fan_fn_node_t::gen_header_code(
         else
             vs = gen_code_block(dbg, docs, doc, nds);
         
-        ++doc->scope_level;
-        std::string err_var = unique_ident("__err_" + doc->cls_name);
-        
-        s += fmt::format(
-            "{}->render_view({}, [{}, {}](md::callback::cb_error {})"
-            "{{ if({}){{ {}({}); return; }} try{{ ",
-            doc->self_name,
-            vs,
-            
-            // lambda args
-            doc->self_name,
-            doc->cb_name,
-
-            // cb err
-            err_var,
-            // on err
-            err_var,
-            doc->cb_name,
-            err_var
-        );
+        // started right away, the output is stitched at the call position
+        s += fmt::format("{}->render_partial({});", doc->self_name, vs);
         
         return s;
     }
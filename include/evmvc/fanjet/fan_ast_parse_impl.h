@@ -369,7 +369,8 @@ inline bool open_fan_markup(ast::token& t, ast::node_t* pn)
     if(
         !t->is_fan_markup_open() &&
         !t->is_fan_add_section_open() &&
-        !t->is_fan_write_section_open()
+        !t->is_fan_write_section_open() &&
+        !t->is_fan_cache_open()
     )
         return false;
     
@@ -378,11 +379,24 @@ inline bool open_fan_markup(ast::token& t, ast::node_t* pn)
     // find lang
     token tl = t->next();
     std::string l;
-    while(tl && !tl->is_parenthesis_close()){
-        ++end_hup;
-        l += tl->text();
-        tl = tl->next();
-    }
+    if(t->is_fan_cache_open()){
+        // the cache key expression may contain parenthesis
+        size_t depth = 0;
+        while(tl){
+            if(tl->is_parenthesis_open())
+                ++depth;
+            else if(tl->is_parenthesis_close() && --depth == 0)
+                break;
+            ++end_hup;
+            l += tl->text();
+            tl = tl->next();
+        }
+    }else
+        while(tl && !tl->is_parenthesis_close()){
+            ++end_hup;
+            l += tl->text();
+            tl = tl->next();
+        }
     md::trim(l);
     ast::root_node rn = std::static_pointer_cast<ast::root_node_t>(pn->root());
     if(t->is_fan_markup_open() && !rn->support_markup_lang(l)){
@@ -423,6 +437,13 @@ inline bool open_fan_markup(ast::token& t, ast::node_t* pn)
         }
         
         l = "<$" + l;
+    }else if(t->is_fan_cache_open()){
+        if(boost::starts_with(l, "(")){
+            l = l.substr(1);
+            md::trim(l);
+        }
+        
+        l = "#>" + l;
     }else if(t->is_fan_write_section_open()){
         if(boost::starts_with(l, "(")){
             l = l.substr(1);
@@ -649,7 +670,10 @@ inline void literal_node_t::parse(ast::token t)
                 if(this->is_write_semcolon_section()){
                     close_scope(t, this);
                     return;
-                }else if(this->is_add_section() || this->is_write_section()){
+                }else if(
+                    this->is_add_section() || this->is_write_section() ||
+                    this->is_cache_section()
+                ){
                     if(open_tag(t, this))
                         return;
                     
@@ -214,6 +214,8 @@ public:
     directive_node post_inc_header;
     
     size_t scope_level;
+    // generated identifiers are numbered per view
+    size_t ident_seq;
     
     size_t lines;
     void count_lines(const std::string& s)
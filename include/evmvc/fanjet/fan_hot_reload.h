@@ -0,0 +1,542 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_fanjet_hot_reload_h
+#define _libevmvc_fanjet_hot_reload_h
+
+#include "../stable_headers.h"
+#include "../app.h"
+#include "fanjet.h"
+
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <dlfcn.h>
+#include <thread>
+
+extern char** environ;
+
+namespace evmvc { namespace fanjet {
+
+class hot_reload_options
+{
+public:
+    // namespace and source directory of the views
+    std::string ns;
+    bfs::path src_dir;
+    std::vector<std::string> markup_langs;
+
+    // receives the generated sources, the objects and the compiled views
+    bfs::path build_dir = "/tmp/evmvc-fanjet";
+
+    // generates one translation unit per view, the unchanged views and
+    // their objects are kept between the reloads.
+    std::string fanjet = "fanjet";
+    std::string make = "make";
+    // parallel compilations, defaults to the number of cores
+    size_t jobs = 0;
+
+    // must match the headers and defines the server is built with
+    std::string cxx = "c++";
+    std::string cxx_flags = "-std=c++14 -O0 -g";
+
+    // delay coalescing the file events of a save
+    int delay_ms = 100;
+};
+
+/*
+    removes the views generations, named <pid>-<gen>, left in build_dir
+    by the processes no longer running.
+*/
+inline size_t remove_stale_views(const bfs::path& build_dir)
+{
+    boost::system::error_code ec;
+    if(!bfs::is_directory(build_dir, ec))
+        return 0;
+
+    std::vector<bfs::path> stale;
+    for(bfs::directory_entry& x : bfs::directory_iterator(build_dir)){
+        std::string name = x.path().filename().string();
+        size_t sep = name.find('-');
+        if(sep == 0 || sep == std::string::npos ||
+            !bfs::is_directory(x.status())
+        )
+            continue;
+
+        pid_t pid = 0;
+        auto r = std::from_chars(name.data(), name.data() + sep, pid);
+        if(r.ptr != name.data() + sep || pid <= 0)
+            continue;
+        if(kill(pid, 0) == -1 && errno == ESRCH)
+            stale.emplace_back(x.path());
+    }
+
+    size_t n = 0;
+    for(auto& d : stale)
+        if(bfs::remove_all(d, ec) > 0 && !ec)
+            ++n;
+    return n;
+}
+
+/*
+    development mode, the master process watches the views directory,
+    compiles the views into a shared object on change and sends it to
+    every worker. The fanjet tool and make run in a child process watched
+    by the master loop, which keeps accepting the connections. The server
+    must be linked with -rdynamic so the loaded views share the evmvc
+    singletons of the server.
+*/
+class hot_reload_t
+{
+public:
+    hot_reload_t(evmvc::app a, const hot_reload_options& opts)
+        : _app(a), _opts(opts), _log(a->log()),
+        _fd(-1), _ev(nullptr), _timer(nullptr), _gen(0),
+        _cc_pid(-1), _cc_ev(nullptr), _cc_pending(false)
+    {
+        _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(_fd == -1)
+            throw MD_ERR("inotify_init1 failed: '{}'", errno);
+        _watch(_opts.src_dir);
+
+        _ev = event_new(
+            global::ev_base(), _fd, EV_READ | EV_PERSIST,
+            hot_reload_t::_on_read, this
+        );
+        event_add(_ev, nullptr);
+        _timer = evtimer_new(global::ev_base(), hot_reload_t::_on_timer, this);
+
+        remove_stale_views(_opts.build_dir);
+    }
+
+    /**
+     * Generates and compiles the views, they are sent to the workers
+     * once the compilation completes.
+     */
+    void reload()
+    {
+        // the views changed again during the compilation
+        if(_cc_pid != -1){
+            _cc_pending = true;
+            return;
+        }
+        if(_app.expired())
+            return;
+
+        // the sources and the objects are kept, only the changed views
+        // and the views inheriting from them are compiled again.
+        bfs::path obj = _opts.build_dir / ast::norm_vname(_opts.ns, "-");
+        bfs::path out =
+            _opts.build_dir / fmt::format("{}-{}", getpid(), ++_gen);
+        bfs::path so = out / "views.so";
+        try{
+            bfs::create_directories(obj);
+            bfs::create_directories(out);
+
+            _write_if_changed(obj / "hot_reload.mk",
+                "# generated by the fanjet hot reload\n"
+                "include views.h.mk\n"
+                "OBJS := $(FANJET_SOURCES:.cpp=.o) hot_reload.o\n"
+                "\n"
+                "$(OUT): $(OBJS)\n"
+                "\t$(CXX) $(CXXFLAGS) -shared -o $@ $(OBJS)\n"
+                "\n"
+                "%.o: %.cpp\n"
+                "\t$(CXX) $(CXXFLAGS) -fPIC -MMD -MP -I. -c -o $@ $<\n"
+                "\n"
+                "-include $(OBJS:.o=.d)\n"
+            );
+            _write_if_changed(obj / "hot_reload.cpp", fmt::format(
+                "#include \"views.h\"\n"
+                "extern \"C\" void evmvc_fanjet_register_views(void* fjv)\n"
+                "{{\n"
+                "    {}::register_views(\n"
+                "        *(std::shared_ptr<evmvc::fanjet::view_engine>*)fjv\n"
+                "    );\n"
+                "}}\n",
+                _opts.ns
+            ));
+
+        }catch(const std::exception& err){
+            _log->error(MD_ERR(
+                "Unable to prepare the views build of '{}'\n{}",
+                _opts.src_dir.string(), err.what()
+            ));
+            return;
+        }
+
+        std::string langs;
+        for(auto& l : _opts.markup_langs)
+            langs += fmt::format(" '{}'", l);
+        size_t jobs = _opts.jobs ?
+            _opts.jobs : std::max(1u, std::thread::hardware_concurrency());
+
+        _compile(
+            fmt::format(
+                "'{}' --split -n '{}' -i views.h -s '{}' -d '{}'{} && "
+                "'{}' -s -C '{}' -f hot_reload.mk -j{} "
+                "CXX='{}' CXXFLAGS='{}' OUT='{}'",
+                _opts.fanjet, _opts.ns,
+                _opts.src_dir.string(), obj.string(),
+                langs.empty() ? "" : " -l" + langs,
+                _opts.make, obj.string(), jobs,
+                _opts.cxx, _opts.cxx_flags, so.string()
+            ),
+            so
+        );
+    }
+
+private:
+    void _compile(const std::string& cmd, const bfs::path& so)
+    {
+        int fds[2];
+        if(pipe2(fds, O_CLOEXEC) == -1){
+            _log->error(MD_ERR("pipe2 failed: '{}'", errno));
+            return;
+        }
+
+        // stdout and stderr are captured for the error log
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_adddup2(&fa, fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&fa, fds[1], STDERR_FILENO);
+
+        const char* argv[] = {"/bin/sh", "-c", cmd.c_str(), nullptr};
+        int ret = posix_spawn(
+            &_cc_pid, "/bin/sh", &fa, nullptr, (char* const*)argv, environ
+        );
+        posix_spawn_file_actions_destroy(&fa);
+        close(fds[1]);
+        if(ret != 0){
+            _cc_pid = -1;
+            close(fds[0]);
+            _log->error(MD_ERR(
+                "Unable to start the views compilation: '{}'\n{}", ret, cmd
+            ));
+            return;
+        }
+
+        evutil_make_socket_nonblocking(fds[0]);
+        _cc_cmd = cmd;
+        _cc_so = so;
+        _cc_out.clear();
+        _cc_start = std::chrono::steady_clock::now();
+        _cc_ev = event_new(
+            global::ev_base(), fds[0], EV_READ | EV_PERSIST,
+            hot_reload_t::_on_compiler_output, this
+        );
+        event_add(_cc_ev, nullptr);
+    }
+
+    static void _on_compiler_output(int fd, short events, void* arg)
+    {
+        hot_reload_t* self = (hot_reload_t*)arg;
+        char buf[4096];
+        ssize_t len;
+        while((len = read(fd, buf, sizeof(buf))) > 0)
+            self->_cc_out.append(buf, len);
+        if(len == -1 && (errno == EAGAIN || errno == EINTR))
+            return;
+
+        // end of output, the compiler exited
+        event_free(self->_cc_ev);
+        self->_cc_ev = nullptr;
+        close(fd);
+        self->_compiled();
+    }
+
+    void _compiled()
+    {
+        // the child watcher of the master may reap the compiler first,
+        // a failed compilation leaves no library behind.
+        int wstatus = 0;
+        pid_t p = waitpid(_cc_pid, &wstatus, 0);
+        bool ok = p == _cc_pid ?
+            WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0 :
+            bfs::exists(_cc_so);
+        _cc_pid = -1;
+
+        auto a = _app.lock();
+        boost::system::error_code ec;
+        if(!ok){
+            _log->error(MD_ERR(
+                "Views compilation failed with status '{}'\n{}\n{}",
+                wstatus, _cc_cmd, _cc_out
+            ));
+            bfs::remove_all(_cc_so.parent_path(), ec);
+
+        }else if(a){
+            _log->info(
+                "Views '{}' compiled in {}ms",
+                _opts.ns,
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - _cc_start
+                ).count()
+            );
+
+            // loaded by the workers respawned from now on
+            _internal::reloaded_views()[_opts.ns] = _cc_so.string();
+
+            command c(evmvc::CMD_VIEWS_RELOAD);
+            c.write(_opts.ns);
+            c.write(_cc_so.string());
+            for(auto& w : a->workers())
+                if(w->is_valid())
+                    w->send_cmd(c);
+
+            // the previous generation is kept for the workers
+            // still loading it.
+            if(!_prev_dir.empty())
+                bfs::remove_all(_prev_dir, ec);
+            _prev_dir = _cur_dir;
+            _cur_dir = _cc_so.parent_path();
+        }
+
+        if(_cc_pending){
+            _cc_pending = false;
+            reload();
+        }
+    }
+
+    void _watch(const bfs::path& dir)
+    {
+        int wd = inotify_add_watch(
+            _fd, dir.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+            IN_CREATE | IN_DELETE
+        );
+        if(wd == -1){
+            _log->error(MD_ERR(
+                "Unable to watch '{}', errno: '{}'", dir.string(), errno
+            ));
+            return;
+        }
+        _dirs[wd] = dir;
+
+        for(bfs::directory_entry& x : bfs::directory_iterator(dir))
+            if(bfs::is_directory(x.status()))
+                _watch(x.path());
+    }
+
+    static void _on_read(int fd, short events, void* arg)
+    {
+        hot_reload_t* self = (hot_reload_t*)arg;
+        alignas(struct inotify_event) char buf[4096];
+
+        bool changed = false;
+        ssize_t len;
+        while((len = read(fd, buf, sizeof(buf))) > 0){
+            for(char* p = buf; p < buf + len;){
+                struct inotify_event* ev = (struct inotify_event*)p;
+                p += sizeof(struct inotify_event) + ev->len;
+
+                if(ev->mask & IN_IGNORED){
+                    self->_dirs.erase(ev->wd);
+                    continue;
+                }
+
+                std::string name = ev->len ? ev->name : "";
+                if(ev->mask & IN_ISDIR){
+                    auto it = self->_dirs.find(ev->wd);
+                    if(ev->mask & (IN_CREATE | IN_MOVED_TO) &&
+                        it != self->_dirs.end()
+                    )
+                        self->_watch(it->second / name);
+                    changed = true;
+
+                }else if(boost::ends_with(name, ".fan"))
+                    changed = true;
+            }
+        }
+
+        // restarted on each event, an editor save triggers several
+        if(changed){
+            timeval tv = md::date::ms_to_timeval(self->_opts.delay_ms);
+            evtimer_add(self->_timer, &tv);
+        }
+    }
+
+    static void _on_timer(int fd, short events, void* arg)
+    {
+        ((hot_reload_t*)arg)->reload();
+    }
+
+    static void _write_if_changed(
+        const bfs::path& fn, const std::string& src)
+    {
+        // make rebuilds the objects depending on a newer file
+        if(bfs::exists(fn) && bfs::file_size(fn) == src.size()){
+            bfs::ifstream fin(fn, std::ios::binary);
+            std::ostringstream ostrm;
+            ostrm << fin.rdbuf();
+            if(ostrm.str() == src)
+                return;
+        }
+        bfs::ofstream fout(fn, std::ios::binary | std::ios::trunc);
+        fout << src;
+    }
+
+    evmvc::wp_app _app;
+    hot_reload_options _opts;
+    md::log::logger _log;
+
+    int _fd;
+    event* _ev;
+    event* _timer;
+    std::unordered_map<int, bfs::path> _dirs;
+    size_t _gen;
+    // generations of the current and previous views libraries
+    bfs::path _cur_dir;
+    bfs::path _prev_dir;
+
+    // running compilation
+    pid_t _cc_pid;
+    event* _cc_ev;
+    bool _cc_pending;
+    std::string _cc_cmd;
+    bfs::path _cc_so;
+    std::string _cc_out;
+    std::chrono::steady_clock::time_point _cc_start;
+};
+
+namespace _internal {
+// views library loaded by the worker, ref is shared with its views
+struct views_lib
+{
+    std::string ns;
+    std::string path;
+    void* handle;
+    std::shared_ptr<void> ref;
+};
+
+inline std::vector<views_lib>& views_libs()
+{
+    static std::vector<views_lib> libs;
+    return libs;
+}
+
+/*
+    unloads the replaced libraries of ns once their views are released,
+    checked on each reload.
+*/
+inline void unload_views(const std::string& ns)
+{
+    auto& libs = views_libs();
+    size_t cur = libs.size();
+    for(size_t i = libs.size(); i > 0; --i)
+        if(libs[i -1].ns == ns){
+            cur = i -1;
+            break;
+        }
+
+    for(size_t i = 0; i < libs.size();){
+        if(i == cur || libs[i].ns != ns || libs[i].ref.use_count() > 1){
+            ++i;
+            continue;
+        }
+        md::log::default_logger()->debug(
+            "Views '{}' unloaded from '{}'", ns, libs[i].path
+        );
+        libs[i].ref.reset();
+        dlclose(libs[i].handle);
+        libs.erase(libs.begin() + i);
+        if(cur > i)
+            --cur;
+    }
+}
+}//::_internal
+
+/*
+    runs in the workers, the replaced library is unloaded once the
+    views being rendered with it are released.
+*/
+inline void load_views(const std::string& ns, const std::string& so_path)
+{
+    auto log = md::log::default_logger();
+    void* h = dlopen(so_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if(!h){
+        log->error(MD_ERR(
+            "Unable to load the views '{}'\n{}", so_path, dlerror()
+        ));
+        return;
+    }
+
+    typedef void (*register_fn)(void*);
+    register_fn fn = (register_fn)dlsym(h, "evmvc_fanjet_register_views");
+    if(!fn){
+        log->error(MD_ERR(
+            "Missing views registration in '{}'\n{}", so_path, dlerror()
+        ));
+        dlclose(h);
+        return;
+    }
+
+    std::shared_ptr<void> ref = std::make_shared<int>(0);
+    try{
+        auto fresh = std::make_shared<view_engine>(ns);
+        fresh->retain_library(ref);
+        fn(&fresh);
+
+        auto cur = std::dynamic_pointer_cast<view_engine>(
+            evmvc::view_engine::find_engine(ns)
+        );
+        if(cur)
+            cur->swap_views(*fresh);
+        else
+            evmvc::view_engine::register_engine(ns, fresh);
+
+    }catch(const std::exception& err){
+        log->error(MD_ERR(
+            "Unable to register the views '{}'\n{}", so_path, err.what()
+        ));
+        // the partially registered engine is already released
+        if(ref.use_count() == 1)
+            dlclose(h);
+        return;
+    }
+
+    _internal::views_libs().push_back({ns, so_path, h, ref});
+    _internal::unload_views(ns);
+    log->info("Views '{}' reloaded from '{}'", ns, so_path);
+}
+
+/**
+ * Enables the views hot reload, must be called in the master process.
+ */
+inline void hot_reload(evmvc::app a, const hot_reload_options& opts)
+{
+    if(auto w = evmvc::active_worker())
+        if(w->is_child())
+            throw MD_ERR("Views hot reload must be enabled by the master");
+
+    evmvc::_internal::views_reload_handler() = load_views;
+
+    // never released, the forked workers must not touch its events
+    static hot_reload_t* hr = nullptr;
+    if(!hr)
+        hr = new hot_reload_t(a, opts);
+}
+
+}}//::evmvc::fanjet
+#endif //_libevmvc_fanjet_hot_reload_h
@@ -194,6 +194,7 @@ public:
         }
         
         doc->scope_level = 0;
+        doc->ident_seq = 0;
         doc->lines = 1;
         
         if(doc->ns.empty())
@@ -251,17 +252,13 @@ public:
         std::string& include_src,
         const std::string& ns,
         std::vector<ast::document>& docs,
-        bool dbg)
+        bool dbg,
+        bool split = false)
     {
         std::string inc_src_incs;
-        std::string inc_src_gens = fmt::format(
-            "inline void register_engine()\n{{\n"
-            "    std::shared_ptr<evmvc::fanjet::view_engine> fjv =\n"
-            "        std::shared_ptr<evmvc::fanjet::view_engine>(\n"
-            "            new evmvc::fanjet::view_engine(\"{}\")\n"
-            "        );\n",
-            ns
-        );
+        std::string inc_src_gens =
+            "inline void register_views(\n"
+            "    std::shared_ptr<evmvc::fanjet::view_engine> fjv)\n{\n";
         
         std::vector<std::string> ns_vals;
         std::string inc_ns_open, inc_ns_close("\n");
@@ -288,25 +285,6 @@ public:
                     ".", "_"
                 );
             
-            std::string includes;
-            
-            for(auto inc : doc->includes)
-                includes += fmt::format(
-                    "{0}\n",
-                    inc->gen_header_code(dbg, docs, doc)
-                );
-            
-            for(auto ii : doc->inherits_items){
-                auto id = ast::find(docs, doc, ii->path);
-                ii->nscls_name = id->nscls_name;
-                
-                includes += fmt::format(
-                    "#include \"{0}\"\n",
-                    id->i_filename
-                );
-            }
-            
-            
             ns_vals.empty();
             std::string ns_open, ns_close("\n");
             boost::split(ns_vals, doc->ns, boost::is_any_of(":"));
@@ -322,7 +300,24 @@ public:
             ns_close += "\n";
 
             if(!doc->skip_gen){
-            
+                std::string includes;
+                
+                for(auto inc : doc->includes)
+                    includes += fmt::format(
+                        "{0}\n",
+                        inc->gen_header_code(dbg, docs, doc)
+                    );
+                
+                for(auto ii : doc->inherits_items){
+                    auto id = ast::find(docs, doc, ii->path);
+                    ii->nscls_name = id->nscls_name;
+                    
+                    includes += fmt::format(
+                        "#include \"{0}\"\n",
+                        id->i_filename
+                    );
+                }
+                
                 std::string pre_inc = doc->pre_inc_header ? 
                     doc->pre_inc_header->gen_header_code(dbg, docs, doc) : "";
                 std::string post_inc = doc->post_inc_header ? 
@@ -367,17 +362,13 @@ public:
                     "\n/*\n" + gen_notice + " */\n";
             }
             
-            inc_src_incs += fmt::format(
-                "#include \"{}\"\n",
-                doc->i_filename
-            );
-            
             std::string doc_path = doc->path;
             if(doc_path == "/")
                 doc_path = "";
             
+            std::string reg_src;
             if(doc->type != ast::doc_type::helper)
-                inc_src_gens += fmt::format(
+                reg_src = fmt::format(
                     "    fjv->register_view_generator( \"{}\", \n"
                     "    [](evmvc::sp_view_engine engine, "
                     "const evmvc::response& res\n"
@@ -391,6 +382,51 @@ public:
                     doc->cls_name
                 );
             
+            if(!split){
+                inc_src_incs += fmt::format(
+                    "#include \"{}\"\n",
+                    doc->i_filename
+                );
+                inc_src_gens += reg_src;
+                
+            // one translation unit per view, the include only declares
+            // their registration function.
+            }else if(doc->type == ast::doc_type::helper){
+                doc->c_src = fmt::format(
+                    "/*\n  {0}*/\n"
+                    "// helper views are compiled with the views using them\n",
+                    gen_notice
+                );
+                
+            }else{
+                std::string reg_fn =
+                    "register_" + ast::norm_vname(doc->abs_path, "_");
+                inc_src_incs += fmt::format(
+                    "void {}(\n"
+                    "    std::shared_ptr<evmvc::fanjet::view_engine> fjv);\n",
+                    reg_fn
+                );
+                inc_src_gens += fmt::format("    {}(fjv);\n", reg_fn);
+                
+                doc->c_src = fmt::format(
+                    "/*\n  {0}*/\n"
+                    "#include \"{1}\"\n"
+                    "{2}"
+                    "void {3}(\n"
+                    "    std::shared_ptr<evmvc::fanjet::view_engine> fjv)\n"
+                    "{{\n"
+                    "{4}"
+                    "}}\n"
+                    "{5}",
+                    gen_notice,
+                    doc->i_filename,
+                    inc_ns_open,
+                    reg_fn,
+                    reg_src,
+                    inc_ns_close
+                );
+            }
+            
             /*
             doc->c_src = doc->rn->gen_source_code(
                 dbg, docs, doc
@@ -399,8 +435,15 @@ public:
         }
         
         inc_src_gens += fmt::format(
+            "}}\n"
+            "inline void register_engine()\n{{\n"
+            "    std::shared_ptr<evmvc::fanjet::view_engine> fjv =\n"
+            "        std::shared_ptr<evmvc::fanjet::view_engine>(\n"
+            "            new evmvc::fanjet::view_engine(\"{0}\")\n"
+            "        );\n"
+            "    register_views(fjv);\n"
             "    evmvc::view_engine::register_engine(\n"
-            "        \"{}\", fjv\n"
+            "        \"{0}\", fjv\n"
             "    );\n}}\n",
             ns
         );
@@ -415,14 +458,63 @@ public:
             "#ifndef " + inc_guards + "\n"
             "#define " + inc_guards + "\n"
             "#include \"evmvc/fanjet/fan_view_engine.h\"\n" +
-            inc_src_incs +
-            inc_ns_open +
+            (split ? inc_ns_open + inc_src_incs : inc_src_incs + inc_ns_open) +
             inc_src_gens +
             inc_ns_close +
             "#endif //" + inc_guards + "\n"
             ;
     }
     
+    /*
+        returns the view fields required to generate the other views,
+        allowing an unchanged view to be used without parsing it again.
+    */
+    static evmvc::json manifest_entry(ast::document doc)
+    {
+        return evmvc::json{
+            {"filename", doc->filename},
+            {"dirname", doc->dirname},
+            {"ns", doc->ns},
+            {"path", doc->path},
+            {"name", doc->name},
+            {"abs_path", doc->abs_path},
+            {"cls_name", doc->cls_name},
+            {"nscls_name", doc->nscls_name},
+            {"self_name", doc->self_name},
+            {"cb_name", doc->cb_name},
+            {"layout", doc->layout},
+            {"h_filename", doc->h_filename},
+            {"i_filename", doc->i_filename},
+            {"c_filename", doc->c_filename},
+            {"type", (int)doc->type}
+        };
+    }
+    
+    static ast::document manifest_doc(const evmvc::json& e)
+    {
+        ast::document doc = ast::document(new ast::document_t());
+        doc->skip_gen = true;
+        doc->filename = e["filename"].get<std::string>();
+        doc->dirname = e["dirname"].get<std::string>();
+        doc->ns = e["ns"].get<std::string>();
+        doc->path = e["path"].get<std::string>();
+        doc->name = e["name"].get<std::string>();
+        doc->abs_path = e["abs_path"].get<std::string>();
+        doc->cls_name = e["cls_name"].get<std::string>();
+        doc->nscls_name = e["nscls_name"].get<std::string>();
+        doc->self_name = e["self_name"].get<std::string>();
+        doc->cb_name = e["cb_name"].get<std::string>();
+        doc->layout = e["layout"].get<std::string>();
+        doc->h_filename = e["h_filename"].get<std::string>();
+        doc->i_filename = e["i_filename"].get<std::string>();
+        doc->c_filename = e["c_filename"].get<std::string>();
+        doc->type = (ast::doc_type)e["type"].get<int>();
+        doc->scope_level = 0;
+        doc->ident_seq = 0;
+        doc->lines = 1;
+        return doc;
+    }
+    
 private:
     
     
@@ -258,7 +258,8 @@ public:
             
             is_fan_markup_open() ||
             is_fan_add_section_open() ||
-            is_fan_write_section_open()
+            is_fan_write_section_open() ||
+            is_fan_cache_open()
             ;
     }
     
@@ -289,7 +290,8 @@ public:
             
             is_fan_markup_open() ||
             is_fan_add_section_open() ||
-            is_fan_write_section_open()
+            is_fan_write_section_open() ||
+            is_fan_cache_open()
             
             ;
     }
@@ -397,6 +399,7 @@ public:
     bool is_fan_markup_open() const { return _text == "@(";}
     bool is_fan_add_section_open() const { return _text == "@add-section";}
     bool is_fan_write_section_open() const { return _text == "@write-section";}
+    bool is_fan_cache_open() const { return _text == "@cache";}
     
     bool is_double_quote() const { return _text == "\"";}
     bool is_single_quote() const { return _text == "'";}
@@ -1046,21 +1049,17 @@ public:
     
     static bool find_token(const std::string& text)
     {
-        const char* ptr = s_tokens[0];
-        while(ptr){
-            if(text.compare(ptr) == 0)
-                return true;
-            ++ptr;
-        }
-        return false;
+        return _automaton().contains(text);
     }
     
-    static token tokenize(const std::string& text)
+    static token tokenize(md::string_view src)
     {
         token root = std::make_shared<token_t>(nullptr, "", 0, 0, 0, nullptr);
         token t = root;
         
-        std::string tmp_text;
+        const keyword_automaton& ka = _automaton();
+        const char* text = src.data();
+        size_t size = src.size();
         
         size_t l = 1;
         size_t c = 1;
@@ -1069,71 +1068,38 @@ public:
         size_t tc = 0;
         size_t ti = 0;
         
-        for(size_t i = 0; i < text.size(); ++i){
-            auto cur_chr = text[i];
-            bool is_token = false;
+        // start of the text between the tokens
+        size_t run = 0;
+        
+        for(size_t i = 0; i < size; ++i){
+            size_t len = ka.match(text, size, i);
+            if(len == 0){
+                c += 1;
+                continue;
+            }
+            
+            if(i > run)
+                t = t->add_next(std::string(text + run, i - run), tl, tc, ti);
             
             size_t ib = i;
             size_t lb = l;
             size_t cb = c;
-            const char** tp = s_tokens;
-            
-            std::string tval;
-            size_t il = 0;
-            size_t ll = 0;
-            size_t cl = 0;
             
-            while(*tp){
-                std::string tok(*tp);
-                if(tok.size() > tval.size()){
-                    if(tokenizer::is_token(tok, text, i, l, c)){
-                        il = i;
-                        ll = l;
-                        cl = c;
-                        
-                        i = ib;
-                        l = lb;
-                        c = cb;
-                        
-                        is_token = true;
-                        tval = tok;
-                    }
-                }
-                // if(tokenizer::is_token(tok, text, i, l, c)){
-                //     is_token = true;
-                //     if(tmp_text.size() > 0)
-                //         t = t->add_next(tmp_text, tl, tc, ti);
-                //     tmp_text = "";
-                //     ti = i;
-                //     tl = l;
-                //     t = t->add_next(tok, lb, cb, ib);
-                //     break;
-                // }
-                ++tp;
-            }
-            
-            if(is_token){
-                if(tmp_text.size() > 0)
-                    t = t->add_next(tmp_text, tl, tc, ti);
-                tmp_text = "";
-                
-                i = il;
-                l = ll;
-                c = cl;
-                
-                ti = i;
-                tl = l;
-                t = t->add_next(tval, lb, cb, ib);
+            c += len;
+            if(len == 1 && text[i] == '\n'){
+                l += 1;
+                c = 1;
             }
+            i += len -1;
             
-            if(!is_token){
-                tmp_text += cur_chr;
-                c += 1;
-            }
+            ti = i;
+            tl = l;
+            t = t->add_next(std::string(text + ib, len), lb, cb, ib);
+            run = i + 1;
         }
         
-        if(tmp_text.size() > 0)
-            t = t->add_next(tmp_text, tl, tc, ti);
+        if(size > run)
+            t = t->add_next(std::string(text + run, size - run), tl, tc, ti);
         
         EVMVC_DEF_DBG(
             md::replace_substring_copy(
@@ -1150,44 +1116,106 @@ public:
             (c >= '0' && c <= '9') || c == '_';
     }
     
-    static bool is_token(
-        const std::string& token,
-        const std::string& text,
-        size_t& i,
-        size_t& l,
-        size_t& c
-        )
+private:
+    /*
+        trie of the s_tokens, a single pass over the source finds the
+        longest valid token starting at each position.
+    */
+    class keyword_automaton
     {
-        size_t start_i = i;
-        
-        if(start_i + token.size() > text.size() -1)
-            return false;
-        
-        std::string val = text.substr(start_i, token.size());
-        bool is_valid = true;
-        if(is_alphanum(*token.rbegin())){
-            char nxt_c = val.size() + start_i < text.size() ?
-                text[val.size() + start_i] : '\0';
-            is_valid = !is_alphanum(nxt_c);
+    public:
+        keyword_automaton()
+        {
+            _states.emplace_back();
+            for(const char** tp = s_tokens; *tp; ++tp)
+                _add(*tp);
+            
+            for(size_t i = 0; i < 256; ++i)
+                _root[i] = _find(0, (unsigned char)i);
         }
         
-        if(val == token && is_valid){
-            if(token == "*@"){
-                if(start_i + token.size() + 1 <= text.size() -1 &&
-                    text.substr(start_i, token.size() + 1) == "*@@"
-                )
+        bool contains(md::string_view text) const
+        {
+            uint32_t s = 0;
+            for(size_t i = 0; i < text.size(); ++i)
+                if((s = _next(s, (unsigned char)text[i])) == 0)
                     return false;
+            return _states[s].accept;
+        }
+        
+        // returns the length of the token at i or zero
+        size_t match(const char* text, size_t size, size_t i) const
+        {
+            size_t len = 0;
+            uint32_t s = 0;
+            // a token never ends on the last character
+            for(size_t k = i; k +1 < size; ++k){
+                s = _next(s, (unsigned char)text[k]);
+                if(s == 0)
+                    break;
+                if(_states[s].accept && _valid(text, size, i, k - i +1))
+                    len = k - i +1;
             }
-            c += token.size();
-            if(token == "\n"){
-                l += 1;
-                c = 1;
+            return len;
+        }
+
+    private:
+        struct state
+        {
+            bool accept = false;
+            std::vector<std::pair<unsigned char, uint32_t>> edges;
+        };
+        
+        void _add(const char* tok)
+        {
+            uint32_t s = 0;
+            for(; *tok; ++tok){
+                uint32_t n = _find(s, (unsigned char)*tok);
+                if(n == 0){
+                    n = (uint32_t)_states.size();
+                    _states[s].edges.emplace_back((unsigned char)*tok, n);
+                    _states.emplace_back();
+                }
+                s = n;
             }
-            i += token.size() -1;
+            _states[s].accept = true;
+        }
+        
+        uint32_t _find(uint32_t s, unsigned char c) const
+        {
+            for(auto& e : _states[s].edges)
+                if(e.first == c)
+                    return e.second;
+            return 0;
+        }
+        
+        uint32_t _next(uint32_t s, unsigned char c) const
+        {
+            return s == 0 ? _root[c] : _find(s, c);
+        }
+        
+        static bool _valid(
+            const char* text, size_t size, size_t i, size_t len)
+        {
+            if(is_alphanum(text[i + len -1]) && is_alphanum(text[i + len]))
+                return false;
+            
+            // *@ must not be the start of a *@@ literal
+            if(len == 2 && text[i] == '*' && text[i +1] == '@' &&
+                i + 3 < size && text[i +2] == '@'
+            )
+                return false;
             return true;
         }
         
-        return false;
+        std::vector<state> _states;
+        uint32_t _root[256];
+    };
+    
+    static const keyword_automaton& _automaton()
+    {
+        static keyword_automaton ka;
+        return ka;
     }
     
     static const char* s_tokens[];
@@ -1267,6 +1295,7 @@ const char* tokenizer::s_tokens[] = {
     
     "@add-section",
     "@write-section",
+    "@cache",
     
     // "\n``````````", "\n`````````", "\n````````", "\n```````", "\n``````", 
     // "\n`````", "\n````", "\n```", "\n``",
@@ -35,6 +35,7 @@ class view_base
     : public evmvc::view_base
 {
     friend class app;
+    friend class view_engine;
 public:
     
     view_base(
@@ -58,6 +59,9 @@ public:
 protected:
     
     
+private:
+    // the library of a reloaded view, unloaded once its views are released
+    std::shared_ptr<void> _lib;
 };
 
 }};//evmvc::fanjet
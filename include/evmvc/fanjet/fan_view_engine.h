@@ -61,6 +61,15 @@ public:
         const evmvc::response& res,
         const std::string& path,
         md::callback::value_cb<const std::string&> cb)
+    {
+        render_view(res, path, cb, view_output::buffer);
+    }
+
+    void render_view(
+        const evmvc::response& res,
+        const std::string& path,
+        md::callback::value_cb<const std::string&> cb,
+        view_output out)
     {
         md::log::default_logger()->debug(MD_ERR(
             "request view at '{}'",
@@ -75,39 +84,20 @@ public:
             ), "");
             return;
         }
-        std::shared_ptr<evmvc::view_base> v = vg(this->shared_from_this(), res);
-
         std::vector<std::shared_ptr<evmvc::view_base>> views;
-        views.emplace_back(v);
-
-        std::shared_ptr<evmvc::view_base> tv = v;
+        views.emplace_back(vg(this->shared_from_this(), res));
+        _add_layouts(res, path, views);
 
-        while(tv && !tv->layout().empty()){
-            std::string s = tv->layout().to_string();
-            if(s.find("::") == std::string::npos){
-                // first find with relative path
-                std::string rel_path = path;
-                size_t rplsep = rel_path.rfind("/");
-                if(rplsep == std::string::npos)
-                    rel_path.clear();
-                else
-                    rel_path = rel_path.substr(0, rplsep +1);
-                tv = this->get_view(res, rel_path + s);
-                // then find with path
-                if(!tv)
-                    tv = this->get_view(res, s);
-            }else
-                tv = evmvc::view_engine::get(res, s);
-
-            if(tv){
-                // assign current view body
-                tv->set_body(*views.rbegin());
-                views.emplace_back(tv);
-            }
-        }
+        // assign each layout body
+        for(size_t i = 1; i < views.size(); ++i)
+            views[i]->set_body(views[i -1]);
 
         // fetch the upper layout
-        v = *views.rbegin();
+        std::shared_ptr<evmvc::view_base> v = *views.rbegin();
+        if(out == view_output::stream)
+            v->enable_streaming(
+                res->get_app()->options().views.stream_flush_size
+            );
 
         // render all views starting with the fartest child
         md::async::each<std::shared_ptr<evmvc::view_base>>(views,
@@ -120,7 +110,7 @@ public:
                     "rendering view '{}'",
                     v->abs_path()
                 ));
-                v->render(v, [v, ecb](const md::callback::cb_error& err){
+                auto rcb = [v, ecb](const md::callback::cb_error& err){
                     if(err){
                         md::log::default_logger()->error(MD_ERR(
                             "view '{}' rendering failed!{}",
@@ -134,13 +124,19 @@ public:
                         ));
                     }
                     ecb(err);
+                };
+                // the partials started by the view are rendered concurrently
+                v->render(v, [v, rcb](const md::callback::cb_error& err){
+                    if(err)
+                        return rcb(err);
+                    v->await_partials(rcb);
                 });
             }catch(const std::exception& err){
                 ecb(err);
             }
         },
         // on completion return view html data
-        [views, res, v, cb](const md::callback::cb_error& err){
+        [views, res, v, cb, out](const md::callback::cb_error& err){
             if(err)
                 return cb(err, "");
 
@@ -148,7 +144,15 @@ public:
                 "view '{}' rendered",
                 v->abs_path()
             ));
-            cb(nullptr, v->buffer());
+            if(out == view_output::buffer)
+                return cb(nullptr, v->buffer());
+
+            try{
+                v->reply();
+            }catch(const std::exception& err){
+                return cb(err, "");
+            }
+            cb(nullptr, "");
         });
 
     }
@@ -170,23 +174,96 @@ public:
 
 
 
+    /**
+     * The views registered afterward keep lib alive, the engine of a
+     * reloaded library knows when its views are all released.
+     */
+    void retain_library(std::shared_ptr<void> lib)
+    {
+        _lib = lib;
+    }
+
     void register_view_generator(bfs::path view_path, view_generator_fn vg)
     {
-        auto it = _views.find(view_path.string());
+        std::string vp = view_path.string();
+        auto it = _views.find(vp);
         if(it != _views.end())
             throw MD_ERR(
                 "Engine '{}' view '{}::{}' is already registered!",
-                this->name(), this->ns(), view_path.string()
+                this->name(), this->ns(), vp
             );
 
+        if(_lib){
+            std::shared_ptr<void> lib = _lib;
+            view_generator_fn lvg = vg;
+            vg = [lib, lvg](sp_view_engine engine, const evmvc::response& res){
+                auto v = lvg(engine, res);
+                if(v)
+                    v->_lib = lib;
+                return v;
+            };
+        }
+
         _views.emplace(
-            std::make_pair(view_path.string(), vg)
+            std::make_pair(vp, vg)
         );
+
+        // index the view by the dir and name it resolves from,
+        // the view itself first then the partials, layouts and helpers.
+        size_t sep = vp.rfind('/');
+        std::string name = sep == std::string::npos ? vp : vp.substr(sep +1);
+        std::string dir = sep == std::string::npos ? "" : vp.substr(0, sep +1);
+        _index_view(vp, 0, vg);
+
+        static const char* sub_dirs[] = {"partials/", "layouts/", "helpers/"};
+        for(size_t i = 0; i < 3; ++i){
+            size_t sl = strlen(sub_dirs[i]);
+            if(dir.size() >= sl &&
+                dir.compare(dir.size() - sl, sl, sub_dirs[i]) == 0
+            )
+                _index_view(dir.substr(0, dir.size() - sl) + name, i +1, vg);
+        }
+
+        _resolved.clear();
+        _chains.clear();
+    }
+
+    /**
+     * Replaces the views of this engine with the views of src,
+     * the views being rendered keep their generator.
+     */
+    void swap_views(view_engine& src)
+    {
+        _views.swap(src._views);
+        _index.swap(src._index);
+        _lib.swap(src._lib);
+        _resolved.clear();
+        _chains.clear();
+        _views_changed();
     }
 
 
 
 private:
+    typedef std::function<
+        std::shared_ptr<evmvc::view_base>(const evmvc::response& res)
+    > layout_fn;
+
+    struct indexed_view
+    {
+        size_t rank;
+        view_generator_fn vg;
+    };
+
+    void _index_view(const std::string& key, size_t rank, view_generator_fn vg)
+    {
+        auto it = _index.find(key);
+        if(it == _index.end())
+            _index.emplace(std::make_pair(key, indexed_view{rank, vg}));
+        else if(rank < it->second.rank)
+            it->second = indexed_view{rank, vg};
+    }
+
     view_generator_fn find_generator(
         const std::string& path) const
     {
@@ -195,74 +272,101 @@ private:
                 "path is empty!"
             );
 
-        //TODO: isolate per namespace
-        // std::string ns;
-        // size_t nsp = path.rfind("::");
-        // if(nsp == std::string::npos)
-        //     ns = doc->ns;
-
-        std::vector<std::string> parts;
-        std::string p = path;
-            //*path.rbegin() == '/' ? path.substr(1) : doc->path + path;
-        boost::split(parts, p, boost::is_any_of("/"));
-
-        std::string name = *parts.rbegin();
-
-        // std::vector<view_generator_fn> ds;
-        // for(auto d : docs)
-        //     if(d->name == name)
-        //         ds.emplace_back(d);
-
-        // if(ds.empty())
-        //     throw MD_ERR(
-        //         "No view matching path: '{}'", path
-        //     );
-
-        for(ssize_t i = (ssize_t)parts.size() -1; i >= 0; --i){
-            // look for the file in this order:
-            //  path dir,
-            //  partials dir,
-            //  layouts dir,
-            //  helpers dir,
+        auto rit = _resolved.find(path);
+        if(rit != _resolved.end())
+            return rit->second;
 
-            std::string rp;
-            for(ssize_t j = 0; j < i; ++j)
-                rp += parts[j] + "/";
-
-            for(auto& v : _views){
-                if(v.first == rp + name)
-                    return v.second;
-
-                if(v.first == rp + "partials/" + name)
-                    return v.second;
+        //TODO: isolate per namespace
 
-                if(v.first == rp + "layouts/" + name)
-                    return v.second;
+        // look for the view from the path dir up to the root,
+        // in the dir itself then in its partials, layouts and helpers.
+        size_t sep = path.rfind('/');
+        std::string name = sep == std::string::npos ?
+            path : path.substr(sep +1);
+
+        view_generator_fn vg = nullptr;
+        size_t dir_len = sep == std::string::npos ? 0 : sep +1;
+        while(true){
+            auto it = _index.find(path.substr(0, dir_len) + name);
+            if(it != _index.end()){
+                vg = it->second.vg;
+                break;
+            }
+            if(dir_len == 0)
+                break;
+            size_t p = dir_len > 1 ?
+                path.rfind('/', dir_len -2) : std::string::npos;
+            dir_len = p == std::string::npos ? 0 : p +1;
+        }
 
-                if(v.first == rp + "helpers/" + name)
-                    return v.second;
+        if(vg)
+            _resolved.emplace(std::make_pair(path, vg));
+        return vg;
+    }
 
-                // if(d->path == rp)
-                //     return d;
+    /*
+        the layouts of a view don't change once registered,
+        the chain is resolved on the first render of each path.
+    */
+    void _add_layouts(
+        const evmvc::response& res,
+        const std::string& path,
+        std::vector<std::shared_ptr<evmvc::view_base>>& views)
+    {
+        auto cit = _chains.find(path);
+        if(cit != _chains.end()){
+            for(auto& lf : cit->second){
+                auto lv = lf(res);
+                if(!lv)
+                    break;
+                views.emplace_back(lv);
+            }
+            return;
+        }
 
-                // if(d->path == rp + "partials/")
-                //     return d;
+        std::string rel_path = path;
+        size_t rplsep = rel_path.rfind("/");
+        if(rplsep == std::string::npos)
+            rel_path.clear();
+        else
+            rel_path = rel_path.substr(0, rplsep +1);
+
+        std::weak_ptr<evmvc::view_engine> we = this->shared_from_this();
+        std::vector<layout_fn> chain;
+        std::string s = views.back()->layout().to_string();
+        while(!s.empty()){
+            layout_fn lf = nullptr;
+            if(s.find("::") == std::string::npos){
+                // first find with relative path then with path
+                view_generator_fn vg = find_generator(rel_path + s);
+                if(!vg)
+                    vg = find_generator(s);
+                if(vg)
+                    lf = [we, vg](const evmvc::response& res){
+                        return vg(we.lock(), res);
+                    };
+            }else
+                lf = [s](const evmvc::response& res){
+                    return evmvc::view_engine::get(res, s);
+                };
 
-                // if(d->path == rp + "layouts/")
-                //     return d;
+            std::shared_ptr<evmvc::view_base> lv = lf ? lf(res) : nullptr;
+            if(!lv)
+                break;
 
-                // if(d->path == rp + "helpers/")
-                //     return d;
-            }
+            views.emplace_back(lv);
+            chain.emplace_back(lf);
+            s = lv->layout().to_string();
         }
 
-        // throw MD_ERR(
-        //     "No view matching path: '{}'", path
-        // );
-        return nullptr;
+        _chains.emplace(std::make_pair(path, std::move(chain)));
     }
 
     std::unordered_map<std::string, view_generator_fn> _views;
+    std::unordered_map<std::string, indexed_view> _index;
+    mutable std::unordered_map<std::string, view_generator_fn> _resolved;
+    std::unordered_map<std::string, std::vector<layout_fn>> _chains;
+    std::shared_ptr<void> _lib;
 
 };
 
@@ -27,6 +27,7 @@ SOFTWARE.
 
 #include "stable_headers.h"
 #include "utils.h"
+#include "compression.h"
 
 namespace evmvc {
 
@@ -43,8 +44,9 @@ public:
         conn(_conn),
         file_desc(_file_desc),
         buffer(evbuffer_new()),
-        zs(nullptr),
-        zs_size(0),
+        zc(),
+        zc_flush(compress_flush::none),
+        zc_pool_size(0),
         cb(_cb),
         log(_log)
     {
@@ -52,22 +54,49 @@ public:
     }
     ~file_reply()
     {
-        if(this->zs){
-            deflateEnd(this->zs);
-            free(this->zs);
-            this->zs = nullptr;
-        }
+        if(this->zc)
+            _internal::compressors().release(
+                std::move(this->zc), this->zc_pool_size
+            );
         
         fclose(this->file_desc);
         evbuffer_free(this->buffer);
         EVMVC_DEF_TRACE("file_reply {:p} released", (void*)this);
     }
+    
+    /**
+     * Reads the file until buffer has output or the end of file is
+     * reached, an idle compressor may consume several reads.
+     * Returns true at the end of file, throws on read or compress error.
+     */
+    bool read_chunk()
+    {
+        char buf[EVMVC_READ_BUF_SIZE];
+        bool eof = false;
+        do{
+            size_t bytes_read = fread(buf, 1, sizeof(buf), this->file_desc);
+            if(ferror(this->file_desc))
+                throw MD_ERR("Unable to read the file, errno: {}", errno);
+            eof = feof(this->file_desc);
+            
+            if(this->zc)
+                this->zc->compress(
+                    buf, bytes_read, this->buffer,
+                    eof ? compress_flush::finish : this->zc_flush
+                );
+            else if(bytes_read > 0)
+                evbuffer_add(this->buffer, buf, bytes_read);
+        }while(!eof && evbuffer_get_length(this->buffer) == 0);
+        return eof;
+    }
+    
     response res;
     wp_connection conn;
     FILE* file_desc;
     struct evbuffer* buffer;
-    z_stream* zs;
-    uLong zs_size;
+    evmvc::compressor zc;
+    compress_flush zc_flush;
+    size_t zc_pool_size;
     md::callback::async_cb cb;
     md::log::logger log;
 };
@@ -0,0 +1,161 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_fragment_cache_h
+#define _libevmvc_fragment_cache_h
+
+#include "stable_headers.h"
+
+#include <list>
+#include <map>
+
+namespace evmvc {
+
+/*
+    rendered view fragments kept per worker,
+    the least recently used fragments are evicted first.
+*/
+class fragment_cache
+{
+    struct entry
+    {
+        std::string data;
+        std::chrono::steady_clock::time_point expires;
+        bool expirable;
+        std::list<const std::string*>::iterator lru;
+    };
+    typedef std::map<std::string, entry> entry_map;
+    
+public:
+    fragment_cache()
+        : _size(0)
+    {
+    }
+    
+    size_t size() const { return _size;}
+    size_t count() const { return _entries.size();}
+    
+    // returns the fragment or nullptr if missing or expired
+    const std::string* get(const std::string& key)
+    {
+        auto it = _entries.find(key);
+        if(it == _entries.end())
+            return nullptr;
+        
+        if(it->second.expirable &&
+            it->second.expires <= std::chrono::steady_clock::now()
+        ){
+            _erase(it);
+            return nullptr;
+        }
+        
+        _lru.splice(_lru.begin(), _lru, it->second.lru);
+        return &it->second.data;
+    }
+    
+    /*
+        ttl is in seconds, zero never expires.
+        fragments bigger than max_size are not cached.
+    */
+    void put(
+        const std::string& key, const std::string& data,
+        size_t ttl, size_t max_size)
+    {
+        auto it = _entries.find(key);
+        if(it != _entries.end())
+            _erase(it);
+        
+        if(key.size() + data.size() > max_size)
+            return;
+        
+        entry e;
+        e.data = data;
+        e.expirable = ttl > 0;
+        if(e.expirable)
+            e.expires =
+                std::chrono::steady_clock::now() + std::chrono::seconds(ttl);
+        
+        it = _entries.emplace(std::make_pair(key, std::move(e))).first;
+        _lru.emplace_front(&it->first);
+        it->second.lru = _lru.begin();
+        _size += key.size() + data.size();
+        
+        while(_size > max_size)
+            _erase(_entries.find(*_lru.back()));
+    }
+    
+    // removes every fragment whose key starts with prefix
+    size_t invalidate(md::string_view prefix)
+    {
+        size_t n = 0;
+        auto it = _entries.lower_bound(prefix.to_string());
+        while(it != _entries.end() &&
+            it->first.compare(0, prefix.size(), prefix.data(), prefix.size())
+                == 0
+        ){
+            auto nit = std::next(it);
+            _erase(it);
+            it = nit;
+            ++n;
+        }
+        return n;
+    }
+    
+    void clear()
+    {
+        _lru.clear();
+        _entries.clear();
+        _size = 0;
+    }
+    
+private:
+    void _erase(entry_map::iterator it)
+    {
+        _lru.erase(it->second.lru);
+        _size -= it->first.size() + it->second.data.size();
+        _entries.erase(it);
+    }
+    
+    entry_map _entries;
+    // keys from the most to the least recently used
+    std::list<const std::string*> _lru;
+    size_t _size;
+};
+
+namespace _internal {
+inline fragment_cache& fragments()
+{
+    static fragment_cache cache;
+    return cache;
+}
+}//::_internal
+
+/*
+    invalidates the cached fragments matching prefix in this worker,
+    when broadcast is true the other workers are notified too.
+*/
+void invalidate_fragments(md::string_view prefix, bool broadcast = false);
+
+} //ns evmvc
+#endif //_libevmvc_fragment_cache_h
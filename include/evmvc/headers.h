@@ -32,8 +32,41 @@ enum class encoding_type
     unsupported,
     gzip,
     deflate,
-    star
+    star,
+    br,
+    zstd
 };
+inline md::string_view to_string(encoding_type t)
+{
+    switch(t){
+        case encoding_type::gzip:
+            return "gzip";
+        case encoding_type::deflate:
+            return "deflate";
+        case encoding_type::star:
+            return "*";
+        case encoding_type::br:
+            return "br";
+        case encoding_type::zstd:
+            return "zstd";
+        default:
+            return "unsupported";
+    }
+}
+inline encoding_type to_encoding_type(md::string_view enc_name)
+{
+    if(enc_name == "gzip" || enc_name == "x-gzip")
+        return encoding_type::gzip;
+    if(enc_name == "deflate")
+        return encoding_type::deflate;
+    if(enc_name == "*")
+        return encoding_type::star;
+    if(enc_name == "br")
+        return encoding_type::br;
+    if(enc_name == "zstd")
+        return encoding_type::zstd;
+    return encoding_type::unsupported;
+}
 
 struct accept_encoding
 {
@@ -244,16 +277,11 @@ public:
             auto qloc = ele.find(";");
             if(qloc == std::string::npos){
                 std::string enc_name = md::trim_copy(ele);
+                // the q value defaults to 1, equal weights keep their order
                 encs.emplace_back(
                     accept_encoding() = {
-                        enc_name == "gzip" ?
-                            encoding_type::gzip :
-                        enc_name == "deflate" ?
-                            encoding_type::deflate :
-                        enc_name == "*" ?
-                            encoding_type::star :
-                            encoding_type::unsupported,
-                        100.0f - (float)i
+                        to_encoding_type(enc_name),
+                        1.0f
                     }
                 );
             } else {
@@ -262,28 +290,22 @@ public:
                 std::string enc_q = 
                     md::trim_copy(ele.substr(qloc+1));
                 auto qvalloc = enc_q.find("=");
-                float q = 100.0f - (float)i;
+                float q = 1.0f;
                 if(qvalloc != std::string::npos)
                     q = md::str_to_num<float>(enc_q.substr(qvalloc+1));
                 
                 encs.emplace_back(
                     accept_encoding() = {
-                        enc_name == "gzip" ?
-                            encoding_type::gzip :
-                        enc_name == "deflate" ?
-                            encoding_type::deflate :
-                        enc_name == "*" ?
-                            encoding_type::star :
-                            encoding_type::unsupported,
+                        to_encoding_type(enc_name),
                         q
                     }
                 );
             }
         }
         
-        std::sort(encs.begin(), encs.end(), 
+        std::stable_sort(encs.begin(), encs.end(), 
         [](const accept_encoding& a, const accept_encoding& b){
-            return a.weight >= b.weight;
+            return a.weight > b.weight;
         });
         
         return encs;
@@ -24,11 +24,61 @@
 #include "router.h"
 #include "fields.h"
 
+#ifndef EVMVC_PARAMS_INLINE_SIZE
+    #define EVMVC_PARAMS_INLINE_SIZE 8
+#endif
+
 namespace evmvc {
 
+namespace _internal {
+
+template<typename NUM_T,
+    typename std::enable_if<std::is_integral<NUM_T>::value, int32_t>::type = -1
+>
+inline NUM_T param_to_num(md::string_view v)
+{
+#if __cplusplus >= 201703L
+    NUM_T n = 0;
+    auto r = std::from_chars(v.data(), v.data() + v.size(), n);
+    if(r.ec != std::errc() || r.ptr != v.data() + v.size())
+        throw MD_ERR("Invalid numeric value: '{}'", v);
+    return n;
+#else
+    return md::str_to_num<NUM_T>(v.to_string());
+#endif
+}
+
+template<typename NUM_T,
+    typename std::enable_if<
+        std::is_floating_point<NUM_T>::value, int32_t
+    >::type = -1
+>
+inline NUM_T param_to_num(md::string_view v)
+{
+#if defined(__cpp_lib_to_chars)
+    NUM_T n = 0;
+    auto r = std::from_chars(v.data(), v.data() + v.size(), n);
+    if(r.ec != std::errc() || r.ptr != v.data() + v.size())
+        throw MD_ERR("Invalid numeric value: '{}'", v);
+    return n;
+#else
+    return md::str_to_num<NUM_T>(v.to_string());
+#endif
+}
+
+}//::_internal
+
+/*
+    name and value are views, the storage is owned by the http_params_t
+    the param belongs to.
+*/
 class http_param
 {
 public:
+    http_param()
+    {
+    }
+    
     http_param(
         const md::string_view& param_name,
         const md::string_view& param_value)
@@ -36,7 +86,15 @@ public:
     {
     }
     
-    const char* name(){ return _param_name.c_str();}
+    const char* name() const { return _param_name.data();}
+    md::string_view name_view() const { return _param_name;}
+    md::string_view value() const { return _param_value;}
+    
+    bool is(md::string_view name) const
+    {
+        return _param_name.size() == name.size() &&
+            strncasecmp(_param_name.data(), name.data(), name.size()) == 0;
+    }
     
     template<typename ParamType,
         typename std::enable_if<
@@ -77,7 +135,7 @@ public:
     >
     ParamType get() const
     {
-        return md::str_to_num<ParamType>(_param_value);
+        return _internal::param_to_num<ParamType>(_param_value);
     }
     
     template<typename PARAM_T>
@@ -87,41 +145,57 @@ public:
     }
     
 private:
-    std::string _param_name;
-    std::string _param_value;
+    md::string_view _param_name;
+    md::string_view _param_value;
 };
 
 template<>
 inline std::string evmvc::http_param::get<std::string, -1>() const
 {
-    return _param_value;
+    return _param_value.to_string();
 }
 template<>
 inline const char* evmvc::http_param::get<const char*, -1>() const
 {
-    return _param_value.c_str();
+    return _param_value.data();
+}
+template<>
+inline md::string_view evmvc::http_param::get<md::string_view, -1>() const
+{
+    return _param_value;
 }
-// template<>
-// inline md::string_view evmvc::http_param::get<md::string_view, -1>() const
-// {
-//     return _param_value.c_str();
-// }
 template<>
 inline nlohmann::json evmvc::http_param::get<nlohmann::json, -1>() const
 {
-    return nlohmann::json::parse(_param_value);
+    return nlohmann::json::parse(
+        _param_value.data(), _param_value.data() + _param_value.size()
+    );
 }
 
 template<>
 inline bool evmvc::http_param::get<bool, -1>() const
 {
-    std::string lv = md::lower_case_copy(_param_value);
-    if(lv.empty() || lv == "false" || lv == "0" || lv == "0.0")
+    if(_param_value.empty())
+        return false;
+    if(_param_value.size() == 1)
+        return _param_value[0] != '0';
+    if(_param_value.size() == 3 &&
+        strncmp(_param_value.data(), "0.0", 3) == 0
+    )
+        return false;
+    if(_param_value.size() == 5 &&
+        strncasecmp(_param_value.data(), "false", 5) == 0
+    )
         return false;
     return true;
 }
 
 
+/*
+    the first EVMVC_PARAMS_INLINE_SIZE params are stored inline,
+    names and values are views into the parsed buffer (query string or
+    request body) or into _storage for copied values.
+*/
 class http_params_t
 {
     friend class multip::multipart_content_form_t;
@@ -133,76 +207,147 @@ public:
     {
     }
     
-    http_params_t(std::initializer_list<sp_http_param> lst)
-        : _params(lst)
+    http_params_t(const http_params_t& o)
     {
+        for(size_t i = 0; i < o.size(); ++i)
+            emplace_back(o.at(i).name_view(), o.at(i).value());
     }
-
-    http_params_t(const std::vector<std::shared_ptr<evmvc::http_param>>& p)
-        : _params(p)
+    
+    http_params_t(http_params_t&& o)
+        : _size(o._size),
+        _more(std::move(o._more)),
+        _storage(std::move(o._storage)),
+        _buf(o._buf)
     {
+        for(size_t i = 0; i < EVMVC_PARAMS_INLINE_SIZE && i < _size; ++i)
+            _inline[i] = o._inline[i];
+        o._size = 0;
+        o._buf = nullptr;
     }
-
-    http_params_t(const http_params_t& o)
+    
+    ~http_params_t()
+    {
+        if(_buf)
+            evbuffer_free(_buf);
+    }
+    
+    http_params_t& operator=(const http_params_t&) = delete;
+    
+    /*
+        copy name and value into the params storage
+    */
+    void emplace_back(md::string_view name, md::string_view value)
+    {
+        _storage.emplace_back(name.data(), name.size());
+        const std::string& n = _storage.back();
+        _storage.emplace_back(value.data(), value.size());
+        const std::string& v = _storage.back();
+        emplace_back_view(n, v);
+    }
+    
+    /*
+        name and value must outlive the params
+    */
+    void emplace_back_view(md::string_view name, md::string_view value)
+    {
+        if(_size < EVMVC_PARAMS_INLINE_SIZE)
+            _inline[_size] = http_param(name, value);
+        else
+            _more.emplace_back(name, value);
+        ++_size;
+    }
+    
+    /*
+        takes ownership of buf, returns its null terminated content
+    */
+    char* adopt_buffer(evbuffer* buf)
+    {
+        if(_buf)
+            throw MD_ERR("params buffer is already set!");
+        _buf = buf;
+        size_t len = evbuffer_get_length(buf);
+        evbuffer_add(buf, "", 1);
+        return (char*)evbuffer_pullup(buf, len +1);
+    }
+    
+    /*
+        decode data in place, data must be null terminated
+        and outlive the params
+    */
+    void parse_urlencoded(char* data, size_t len)
+    {
+        evmvc::parse_urlencoded(data, len,
+        [this](md::string_view k, md::string_view v){
+            this->emplace_back_view(k, v);
+        });
+    }
+    
+    /*
+        the query string is kept in the params storage
+    */
+    void parse_urlencoded(std::string&& data)
     {
-        _params = o._params;
+        _storage.emplace_back(std::move(data));
+        std::string& s = _storage.back();
+        parse_urlencoded(&s[0], s.size());
     }
     
-    void emplace_back(sp_http_param p)
+    const http_param& at(size_t idx) const
     {
-        _params.emplace_back(p);
+        if(idx < EVMVC_PARAMS_INLINE_SIZE)
+            return _inline[idx];
+        return _more[idx - EVMVC_PARAMS_INLINE_SIZE];
     }
     
-    sp_http_param get(md::string_view name) const
+    const http_param* get(md::string_view name) const
     {
-        for(auto it : _params)
-            if(strcasecmp(it->name(), name.data()) == 0)
-                return it;
+        for(size_t i = 0; i < _size; ++i)
+            if(at(i).is(name))
+                return &at(i);
         return nullptr;
     }
     
     template<typename PARAM_T>
     PARAM_T get(md::string_view name, PARAM_T def_val = PARAM_T()) const
     {
-        for(auto it : _params)
-            if(strcasecmp(it->name(), name.data()) == 0)
-                return it->get<PARAM_T>();
+        auto p = get(name);
+        if(p)
+            return p->get<PARAM_T>();
         return def_val;
     }
     
     size_t size() const
     {
-        return _params.size();
+        return _size;
     }
     
     template<typename PARAM_T>
     PARAM_T operator[](size_t idx) const
     {
-        return _params[idx]->get<PARAM_T>();
+        return at(idx).get<PARAM_T>();
     }
 
     template<typename PARAM_T>
     PARAM_T operator[](md::string_view name) const
     {
-        for(auto it : _params)
-            if(strcasecmp(it->name(), name.data()) == 0)
-                return it->get<PARAM_T>();
-        return PARAM_T();
+        return get<PARAM_T>(name, PARAM_T());
     }
     
     template<typename PARAM_T>
     PARAM_T operator()(
         md::string_view name, PARAM_T def_val = PARAM_T()) const
     {
-        for(auto it : _params)
-            if(strcasecmp(it->name(), name.data()) == 0)
-                return it->get<PARAM_T>();
-        return def_val;
+        return get<PARAM_T>(name, def_val);
     }
 
     
 private:
-    std::vector<sp_http_param> _params;
+    size_t _size = 0;
+    http_param _inline[EVMVC_PARAMS_INLINE_SIZE];
+    std::vector<http_param> _more;
+    // deque keeps the strings in place when growing or moved
+    std::deque<std::string> _storage;
+    evbuffer* _buf = nullptr;
 };
 
 }//ns evmvc
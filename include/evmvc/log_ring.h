@@ -0,0 +1,409 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_log_ring_h
+#define _libevmvc_log_ring_h
+
+#include "stable_headers.h"
+#include "cached_clock.h"
+
+#include <atomic>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+// number of log paths a worker keeps an id for
+#define EVMVC_LOG_RING_PATHS 256
+
+namespace evmvc {
+
+static_assert(
+    ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+    "the log ring requires address free atomics"
+);
+
+/*
+    single producer, single consumer ring of binary log records
+    shared by a child worker and the master, it is mapped before fork.
+    The child writes without any syscall while the master is draining,
+    the master is woken up by an eventfd once it is waiting.
+*/
+class log_ring
+{
+    enum class rec_type : uint32_t
+    {
+        pad = 0,
+        path = 1,
+        log = 2
+    };
+
+    struct record
+    {
+        uint32_t size;
+        rec_type type;
+        int32_t level;
+        uint32_t path_id;
+        int64_t time;
+        uint64_t data_size;
+    };
+
+    struct control
+    {
+        // each side writes on its own cache line
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        std::atomic<uint32_t> waiting;
+        std::atomic<uint64_t> written;
+        std::atomic<uint64_t> dropped;
+        std::atomic<uint64_t> oversized;
+    };
+
+public:
+    typedef std::function<void(
+        md::log::log_level lvl, md::string_view path,
+        int64_t time, md::string_view msg
+    )> record_fn;
+
+    struct stats
+    {
+        uint64_t written;
+        uint64_t dropped;
+        uint64_t oversized;
+    };
+
+    // size is rounded up to a power of two
+    log_ring(size_t size)
+        : _ctl(nullptr), _data(nullptr), _size(64), _efd(-1),
+        _ev(nullptr), _timer(nullptr), _watch_pid(-1), _next_slot(0),
+        _reported{0,0,0}
+    {
+        while(_size < size)
+            _size <<= 1;
+
+        void* m = mmap(
+            nullptr, sizeof(control) + _size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0
+        );
+        if(m == MAP_FAILED)
+            throw MD_ERR("Unable to map the log ring, errno: '{}'", errno);
+
+        _ctl = new(m) control();
+        _data = (char*)m + sizeof(control);
+
+        _efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(_efd == -1){
+            munmap(m, sizeof(control) + _size);
+            throw MD_ERR("Unable to create the log ring eventfd: '{}'", errno);
+        }
+
+        _slots.resize(EVMVC_LOG_RING_PATHS);
+        _paths.resize(EVMVC_LOG_RING_PATHS);
+    }
+
+    ~log_ring()
+    {
+        unwatch();
+        close(_efd);
+        munmap(_ctl, sizeof(control) + _size);
+    }
+
+    log_ring(const log_ring&) = delete;
+    log_ring& operator=(const log_ring&) = delete;
+
+    stats get_stats() const
+    {
+        return stats{
+            _ctl->written.load(), _ctl->dropped.load(), _ctl->oversized.load()
+        };
+    }
+
+    // largest message carried by the ring
+    size_t max_msg_size() const { return _size / 4;}
+
+    /**
+     * Producer side, returns false when the record is dropped
+     * because the ring is full or the message is too large.
+     */
+    bool write(
+        md::log::log_level lvl, md::string_view path, md::string_view msg)
+    {
+        if(msg.size() > max_msg_size()){
+            _ctl->oversized.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        uint32_t pid = 0;
+        bool new_path = !_path_id(path, pid);
+
+        size_t need = _rec_size(msg.size());
+        size_t def = new_path ? _rec_size(path.size()) : 0;
+
+        uint64_t tail = _ctl->tail.load(std::memory_order_relaxed);
+        uint64_t head = _ctl->head.load(std::memory_order_acquire);
+
+        // the records are contiguous, the end of the ring may be padded
+        uint64_t end = tail;
+        if(def)
+            end = _reserve(end, def);
+        end = _reserve(end, need);
+        if(end - head > _size){
+            _ctl->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if(def){
+            tail = _write(tail, rec_type::path, 0, pid, 0, path);
+            _assign_path(path, pid);
+        }
+        tail = _write(
+            tail, rec_type::log, (int32_t)lvl, pid,
+            _internal::coarse_clock().now_ns(), msg
+        );
+
+        _ctl->tail.store(tail);
+        _ctl->written.fetch_add(1, std::memory_order_relaxed);
+
+        // wake up the master only when it is waiting
+        if(_ctl->waiting.load(std::memory_order_relaxed) &&
+            _ctl->waiting.exchange(0)
+        ){
+            uint64_t v = 1;
+            ::write(_efd, &v, sizeof(v));
+        }
+        return true;
+    }
+
+    /**
+     * Consumer side, calls fn for each available record and
+     * returns the number of log records read.
+     */
+    size_t drain(const record_fn& fn)
+    {
+        size_t count = 0;
+        uint64_t head = _ctl->head.load(std::memory_order_relaxed);
+        uint64_t tail = _ctl->tail.load(std::memory_order_acquire);
+
+        while(head < tail){
+            const record* r = (const record*)(_data + (head & (_size -1)));
+            const char* d = (const char*)(r +1);
+
+            if(r->type == rec_type::path)
+                _paths[r->path_id].assign(d, r->data_size);
+
+            else if(r->type == rec_type::log){
+                ++count;
+                fn(
+                    (md::log::log_level)r->level, _paths[r->path_id],
+                    r->time, md::string_view(d, r->data_size)
+                );
+            }
+
+            head += r->size;
+        }
+
+        _ctl->head.store(head, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * Drains the ring on the master event loop, the drop counters are
+     * reported to log every report_ms.
+     */
+    void watch(
+        event_base* base, record_fn fn,
+        md::log::logger log, int report_ms = 1000)
+    {
+        _fn = fn;
+        _log = log;
+        _watch_pid = getpid();
+        _ev = event_new(
+            base, _efd, EV_READ | EV_PERSIST, log_ring::_on_wakeup, this
+        );
+        event_add(_ev, nullptr);
+
+        _timer = event_new(base, -1, EV_PERSIST, log_ring::_on_timer, this);
+        timeval tv = md::date::ms_to_timeval(report_ms);
+        event_add(_timer, &tv);
+
+        _drain_all();
+    }
+
+    void unwatch()
+    {
+        // the forked workers inherit the rings watched by the master
+        if(_watch_pid != getpid())
+            return;
+
+        if(_ev){
+            event_del(_ev);
+            event_free(_ev);
+            _ev = nullptr;
+        }
+        if(_timer){
+            event_del(_timer);
+            event_free(_timer);
+            _timer = nullptr;
+        }
+        if(_fn)
+            _drain_all();
+        _fn = nullptr;
+    }
+
+private:
+    static size_t _rec_size(size_t data_size)
+    {
+        return (sizeof(record) + data_size + 7) & ~(size_t)7;
+    }
+
+    uint64_t _reserve(uint64_t pos, size_t need)
+    {
+        size_t left = _size - (pos & (_size -1));
+        return (left < need ? pos + left : pos) + need;
+    }
+
+    uint64_t _write(
+        uint64_t pos, rec_type type, int32_t lvl, uint32_t pid, int64_t time,
+        md::string_view data)
+    {
+        size_t need = _rec_size(data.size());
+        size_t left = _size - (pos & (_size -1));
+        if(left < need){
+            // left is at least 8, enough for the size and the type
+            record* pad = (record*)(_data + (pos & (_size -1)));
+            pad->size = (uint32_t)left;
+            pad->type = rec_type::pad;
+            pos += left;
+        }
+
+        record* r = (record*)(_data + (pos & (_size -1)));
+        r->size = (uint32_t)need;
+        r->type = type;
+        r->level = lvl;
+        r->path_id = pid;
+        r->time = time;
+        r->data_size = data.size();
+        memcpy(r +1, data.data(), data.size());
+        return pos + need;
+    }
+
+    // fnv-1a, the paths are looked up without being copied
+    struct path_hash
+    {
+        size_t operator()(md::string_view s) const
+        {
+            uint64_t h = 14695981039346656037ULL;
+            for(size_t i = 0; i < s.size(); ++i){
+                h ^= (unsigned char)s[i];
+                h *= 1099511628211ULL;
+            }
+            return (size_t)h;
+        }
+    };
+
+    // the least recently assigned id is reused for a new path
+    bool _path_id(md::string_view path, uint32_t& pid)
+    {
+        auto it = _path_ids.find(path);
+        if(it != _path_ids.end()){
+            pid = it->second;
+            return true;
+        }
+        pid = _next_slot;
+        return false;
+    }
+
+    void _assign_path(md::string_view path, uint32_t pid)
+    {
+        // the keys are views of the slots
+        auto it = _path_ids.find(md::string_view(_slots[pid]));
+        if(it != _path_ids.end() && it->second == pid)
+            _path_ids.erase(it);
+        _slots[pid].assign(path.data(), path.size());
+        _path_ids[md::string_view(_slots[pid])] = pid;
+        _next_slot = (pid +1) % EVMVC_LOG_RING_PATHS;
+    }
+
+    void _drain_all()
+    {
+        if(!_fn)
+            return;
+
+        // the producer wakes us up once waiting is set and it writes
+        do{
+            _ctl->waiting.store(0);
+            while(drain(_fn) > 0);
+            _ctl->waiting.store(1);
+        }while(_ctl->tail.load() != _ctl->head.load());
+    }
+
+    void _report()
+    {
+        stats s = get_stats();
+        if(s.dropped != _reported.dropped || s.oversized != _reported.oversized)
+            _log->warn(
+                "Log ring of {} bytes dropped {} records, "
+                "{} oversized messages were sent by pipe",
+                _size,
+                s.dropped - _reported.dropped,
+                s.oversized - _reported.oversized
+            );
+        _reported = s;
+    }
+
+    static void _on_wakeup(int fd, short events, void* arg)
+    {
+        uint64_t v;
+        while(read(fd, &v, sizeof(v)) > 0);
+        ((log_ring*)arg)->_drain_all();
+    }
+
+    static void _on_timer(int fd, short events, void* arg)
+    {
+        log_ring* self = (log_ring*)arg;
+        self->_drain_all();
+        self->_report();
+    }
+
+    control* _ctl;
+    char* _data;
+    size_t _size;
+    int _efd;
+
+    // master side
+    event* _ev;
+    event* _timer;
+    pid_t _watch_pid;
+    record_fn _fn;
+    md::log::logger _log;
+    std::vector<std::string> _paths;
+
+    // child side
+    std::unordered_map<md::string_view, uint32_t, path_hash> _path_ids;
+    std::vector<std::string> _slots;
+    uint32_t _next_slot;
+
+    stats _reported;
+};
+
+}//::evmvc
+#endif //_libevmvc_log_ring_h
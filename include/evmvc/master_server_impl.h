@@ -96,28 +96,23 @@ inline void listener::master_listen_cb(
     *((int*)CMSG_DATA(cmsgp)) = sock;
     #pragma GCC diagnostic pop
     
-    // select prefered worker;
-    if(++rridx >= a->workers().size())
-        rridx = 0;
-    size_t cur_idx = rridx;
-    
+    // select prefered worker, a stalled worker is only selected
+    // when every http worker is stalled
     worker pw = nullptr;
-    while(!pw){
-        if(a->workers()[rridx]->work_type() == worker_type::http &&
-            a->workers()[rridx]->is_valid()
-        )
-            pw = a->workers()[rridx];
-        else{
-            ++rridx;
-            if(rridx >= a->workers().size())
-                rridx = 0;
-            if(rridx == cur_idx &&
-                a->workers()[rridx]->work_type() != worker_type::http
-            ){
-                break;
-            }
-        }
+    worker stalled = nullptr;
+    for(size_t i = 0; i < a->workers().size() && !pw; ++i){
+        if(++rridx >= a->workers().size())
+            rridx = 0;
+        auto& w = a->workers()[rridx];
+        if(w->work_type() != worker_type::http || !w->is_valid())
+            continue;
+        if(!w->stalled())
+            pw = w;
+        else if(!stalled)
+            stalled = w;
     }
+    if(!pw)
+        pw = stalled;
     // worker pw;
     // for(auto& w : a->workers())
     //     if(w->work_type() == worker_type::http){
@@ -0,0 +1,685 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_metrics_h
+#define _libevmvc_metrics_h
+
+#include "stable_headers.h"
+
+#include <atomic>
+#include <sys/mman.h>
+
+// counters and gauges slots available to the app
+#ifndef EVMVC_METRICS_CUSTOM
+    #define EVMVC_METRICS_CUSTOM 64
+#endif
+#ifndef EVMVC_METRICS_CUSTOM_HISTOGRAMS
+    #define EVMVC_METRICS_CUSTOM_HISTOGRAMS 8
+#endif
+// slots kept for the respawned workers
+#ifndef EVMVC_METRICS_SPARE_SLOTS
+    #define EVMVC_METRICS_SPARE_SLOTS 4
+#endif
+
+// log-linear buckets, 4 sub buckets per power of two
+#define EVMVC_HISTOGRAM_SUB_BITS 2
+#define EVMVC_HISTOGRAM_OCTAVES 28
+#define EVMVC_HISTOGRAM_BUCKETS \
+    (EVMVC_HISTOGRAM_OCTAVES << EVMVC_HISTOGRAM_SUB_BITS)
+
+namespace evmvc {
+
+// phases of the traced requests, see trace.h
+enum class trace_phase
+{
+    parse,
+    route,
+    policy,
+    handler,
+    render
+};
+#define EVMVC_TRACE_PHASES 5
+
+inline md::string_view to_string(trace_phase p)
+{
+    switch(p){
+        case trace_phase::parse:
+            return "parse";
+        case trace_phase::route:
+            return "route";
+        case trace_phase::policy:
+            return "policy";
+        case trace_phase::handler:
+            return "handler";
+        case trace_phase::render:
+            return "render";
+        default:
+            return "unknown";
+    }
+}
+
+// callbacks attributed by the event loop watchdog, see watchdog.h
+enum class callback_kind
+{
+    route,
+    view,
+    command
+};
+#define EVMVC_CALLBACK_KINDS 3
+
+inline md::string_view to_string(callback_kind k)
+{
+    switch(k){
+        case callback_kind::route:
+            return "route";
+        case callback_kind::view:
+            return "view";
+        case callback_kind::command:
+            return "command";
+        default:
+            return "unknown";
+    }
+}
+
+static_assert(
+    ATOMIC_LLONG_LOCK_FREE == 2,
+    "the metrics require address free atomics"
+);
+
+/*
+    HDR style histogram, the values are recorded with a relative
+    precision of 25% in buckets up to 2^29.
+*/
+struct histogram_data
+{
+    std::atomic<uint64_t> buckets[EVMVC_HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    
+    static size_t bucket_index(uint64_t v)
+    {
+        const uint64_t sub = 1 << EVMVC_HISTOGRAM_SUB_BITS;
+        if(v < sub)
+            return v;
+        
+        size_t e = 63 - __builtin_clzll(v);
+        size_t idx =
+            ((e - EVMVC_HISTOGRAM_SUB_BITS + 1) << EVMVC_HISTOGRAM_SUB_BITS) +
+            ((v >> (e - EVMVC_HISTOGRAM_SUB_BITS)) & (sub -1));
+        return std::min(idx, (size_t)EVMVC_HISTOGRAM_BUCKETS -1);
+    }
+    
+    // exclusive upper bound of a bucket
+    static uint64_t bucket_upper(size_t idx)
+    {
+        const uint64_t sub = 1 << EVMVC_HISTOGRAM_SUB_BITS;
+        if(idx < sub)
+            return idx +1;
+        
+        size_t e = (idx >> EVMVC_HISTOGRAM_SUB_BITS) +
+            EVMVC_HISTOGRAM_SUB_BITS -1;
+        return (sub + (idx & (sub -1)) +1) << (e - EVMVC_HISTOGRAM_SUB_BITS);
+    }
+    
+    void record(uint64_t v)
+    {
+        buckets[bucket_index(v)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(v, std::memory_order_relaxed);
+    }
+};
+
+/*
+    metrics of a worker, updated by the worker only.
+*/
+struct alignas(64) metrics_block
+{
+    std::atomic<int64_t> connections_open;
+    std::atomic<uint64_t> connections;
+    std::atomic<uint64_t> requests;
+    // by status class, 0 for invalid status
+    std::atomic<uint64_t> responses[6];
+    std::atomic<uint64_t> parser_errors;
+    std::atomic<uint64_t> handler_errors;
+    std::atomic<uint64_t> bytes_sent;
+    // microseconds from the request line to the end of the response
+    histogram_data latency;
+    // microseconds by phase of the traced requests
+    histogram_data phases[EVMVC_TRACE_PHASES];
+    
+    // microseconds of delay of the watchdog timer
+    histogram_data loop_lag;
+    std::atomic<uint64_t> slow_callbacks[EVMVC_CALLBACK_KINDS];
+    // steady clock ms of the last watchdog tick, 0 without watchdog
+    std::atomic<int64_t> heartbeat_ms;
+    
+    // jobs waiting for a thread of the offload pool
+    std::atomic<int64_t> offload_queued;
+    std::atomic<uint64_t> offload_rejected;
+    // microseconds waiting for a thread, and until the completion ran
+    histogram_data offload_wait;
+    histogram_data offload_latency;
+    
+    std::atomic<int64_t> custom[EVMVC_METRICS_CUSTOM];
+    histogram_data custom_histograms[EVMVC_METRICS_CUSTOM_HISTOGRAMS];
+    
+    void add_response(int16_t status, uint64_t latency_us)
+    {
+        size_t c = status >= 100 && status < 600 ? status / 100 : 0;
+        responses[c].fetch_add(1, std::memory_order_relaxed);
+        latency.record(latency_us);
+    }
+};
+
+struct histogram_snapshot
+{
+    uint64_t buckets[EVMVC_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    
+    void add(const histogram_data& h)
+    {
+        for(size_t i = 0; i < EVMVC_HISTOGRAM_BUCKETS; ++i)
+            buckets[i] += h.buckets[i].load(std::memory_order_relaxed);
+        count += h.count.load(std::memory_order_relaxed);
+        sum += h.sum.load(std::memory_order_relaxed);
+    }
+    
+    // upper bound of the value at the quantile q, 0 <= q <= 1
+    uint64_t quantile(double q) const
+    {
+        if(count == 0)
+            return 0;
+        uint64_t rank = (uint64_t)(q * (count -1)) +1;
+        uint64_t n = 0;
+        for(size_t i = 0; i < EVMVC_HISTOGRAM_BUCKETS; ++i){
+            n += buckets[i];
+            if(n >= rank)
+                return histogram_data::bucket_upper(i);
+        }
+        return histogram_data::bucket_upper(EVMVC_HISTOGRAM_BUCKETS -1);
+    }
+};
+
+enum class metric_type
+{
+    counter,
+    gauge,
+    histogram
+};
+
+namespace _internal {
+
+/*
+    one shared mapping holding a block per worker, mapped by the master
+    before forking so every process reads the blocks of its siblings.
+*/
+class metrics_registry
+{
+public:
+    struct metric_def
+    {
+        metric_type type;
+        std::string name;
+        std::string help;
+        size_t slot;
+    };
+    
+    metrics_registry()
+        : _blocks(nullptr), _count(0), _local(new metrics_block()),
+        _active(_local), _ncustom(0), _nhisto(0)
+    {
+    }
+    
+    bool mapped() const { return _blocks != nullptr;}
+    size_t block_count() const { return _count;}
+    const std::vector<metric_def>& defs() const { return _defs;}
+    
+    // metrics of the current process
+    metrics_block* active() const { return _active;}
+    void activate(metrics_block* b) { _active = b ? b : _local;}
+    
+    void map(size_t count)
+    {
+        if(_blocks)
+            return;
+        
+        void* m = mmap(
+            nullptr, sizeof(metrics_block) * count, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0
+        );
+        if(m == MAP_FAILED)
+            throw MD_ERR("Unable to map the metrics, errno: '{}'", errno);
+        
+        _blocks = (metrics_block*)m;
+        for(size_t i = 0; i < count; ++i)
+            new(_blocks + i) metrics_block();
+        _count = count;
+        _used.assign(count, false);
+    }
+    
+    // returns nullptr when no slot is left
+    metrics_block* acquire()
+    {
+        for(size_t i = 0; i < _count; ++i)
+            if(!_used[i]){
+                _used[i] = true;
+                _blocks[i].connections_open = 0;
+                _blocks[i].heartbeat_ms = 0;
+                return _blocks + i;
+            }
+        return nullptr;
+    }
+    
+    // the counters of a released block are kept in the totals
+    void release(metrics_block* b)
+    {
+        if(!b || b < _blocks || b >= _blocks + _count)
+            return;
+        b->connections_open = 0;
+        b->heartbeat_ms = 0;
+        _used[b - _blocks] = false;
+    }
+    
+    size_t add(metric_type t, md::string_view name, md::string_view help)
+    {
+        if(_blocks)
+            throw MD_ERR(
+                "Metric '{}' must be registered before starting the app", name
+            );
+        for(auto& d : _defs)
+            if(d.name == name)
+                throw MD_ERR("Metric '{}' already registered", name);
+        
+        size_t slot;
+        if(t == metric_type::histogram){
+            if(_nhisto == EVMVC_METRICS_CUSTOM_HISTOGRAMS)
+                throw MD_ERR("Too many histograms, max: '{}'",
+                    EVMVC_METRICS_CUSTOM_HISTOGRAMS
+                );
+            slot = _nhisto++;
+        }else{
+            if(_ncustom == EVMVC_METRICS_CUSTOM)
+                throw MD_ERR("Too many metrics, max: '{}'",
+                    EVMVC_METRICS_CUSTOM
+                );
+            slot = _ncustom++;
+        }
+        _defs.emplace_back(
+            metric_def{t, name.to_string(), help.to_string(), slot}
+        );
+        return slot;
+    }
+    
+    // sums the blocks of every worker
+    template<typename T, typename Fn>
+    T sum(Fn fn) const
+    {
+        if(!_blocks)
+            return fn(*_local);
+        T v = 0;
+        for(size_t i = 0; i < _count; ++i)
+            v += fn(_blocks[i]);
+        return v;
+    }
+    
+    histogram_snapshot histogram(
+        const histogram_data metrics_block::* h) const
+    {
+        histogram_snapshot s = {};
+        if(!_blocks)
+            s.add(_local->*h);
+        for(size_t i = 0; i < _count; ++i)
+            s.add(_blocks[i].*h);
+        return s;
+    }
+    
+    histogram_snapshot phase_histogram(size_t phase) const
+    {
+        histogram_snapshot s = {};
+        if(!_blocks)
+            s.add(_local->phases[phase]);
+        for(size_t i = 0; i < _count; ++i)
+            s.add(_blocks[i].phases[phase]);
+        return s;
+    }
+    
+    histogram_snapshot custom_histogram(size_t slot) const
+    {
+        histogram_snapshot s = {};
+        if(!_blocks)
+            s.add(_local->custom_histograms[slot]);
+        for(size_t i = 0; i < _count; ++i)
+            s.add(_blocks[i].custom_histograms[slot]);
+        return s;
+    }
+
+private:
+    metrics_block* _blocks;
+    size_t _count;
+    std::vector<bool> _used;
+    metrics_block* _local;
+    metrics_block* _active;
+    
+    std::vector<metric_def> _defs;
+    size_t _ncustom;
+    size_t _nhisto;
+};
+
+inline metrics_registry& metrics()
+{
+    static metrics_registry r;
+    return r;
+}
+
+}//::_internal
+
+// metrics block of the current worker
+inline metrics_block& worker_metrics()
+{
+    return *_internal::metrics().active();
+}
+
+class metric_counter
+{
+public:
+    metric_counter(size_t slot): _slot(slot) {}
+    
+    void inc(int64_t n = 1) const
+    {
+        worker_metrics().custom[_slot].fetch_add(
+            n, std::memory_order_relaxed
+        );
+    }
+    
+    int64_t value() const
+    {
+        size_t s = _slot;
+        return _internal::metrics().sum<int64_t>(
+        [s](const metrics_block& b){
+            return b.custom[s].load(std::memory_order_relaxed);
+        });
+    }
+
+private:
+    size_t _slot;
+};
+
+class metric_gauge
+{
+public:
+    metric_gauge(size_t slot): _slot(slot) {}
+    
+    // the gauges of the workers are added together
+    void set(int64_t v) const
+    {
+        worker_metrics().custom[_slot].store(v, std::memory_order_relaxed);
+    }
+    void add(int64_t n) const
+    {
+        worker_metrics().custom[_slot].fetch_add(
+            n, std::memory_order_relaxed
+        );
+    }
+    
+    int64_t value() const
+    {
+        size_t s = _slot;
+        return _internal::metrics().sum<int64_t>(
+        [s](const metrics_block& b){
+            return b.custom[s].load(std::memory_order_relaxed);
+        });
+    }
+
+private:
+    size_t _slot;
+};
+
+class metric_histogram
+{
+public:
+    metric_histogram(size_t slot): _slot(slot) {}
+    
+    void record(uint64_t v) const
+    {
+        worker_metrics().custom_histograms[_slot].record(v);
+    }
+    
+    histogram_snapshot snapshot() const
+    {
+        return _internal::metrics().custom_histogram(_slot);
+    }
+
+private:
+    size_t _slot;
+};
+
+/**
+ * Registers an app metric, must be called before starting the app.
+ */
+inline metric_counter register_counter(
+    md::string_view name, md::string_view help)
+{
+    return metric_counter(
+        _internal::metrics().add(metric_type::counter, name, help)
+    );
+}
+inline metric_gauge register_gauge(
+    md::string_view name, md::string_view help)
+{
+    return metric_gauge(
+        _internal::metrics().add(metric_type::gauge, name, help)
+    );
+}
+inline metric_histogram register_histogram(
+    md::string_view name, md::string_view help)
+{
+    return metric_histogram(
+        _internal::metrics().add(metric_type::histogram, name, help)
+    );
+}
+
+namespace _internal {
+
+inline void metric_header(
+    std::string& out, md::string_view name, md::string_view type,
+    md::string_view help)
+{
+    out += fmt::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+// only the power of two bounds are exported,
+// labels is empty or ends with a comma
+inline void metric_histogram_series(
+    std::string& out, md::string_view name, md::string_view labels,
+    const histogram_snapshot& s, double scale)
+{
+    uint64_t n = 0;
+    const size_t sub = 1 << EVMVC_HISTOGRAM_SUB_BITS;
+    for(size_t i = 0; i < EVMVC_HISTOGRAM_BUCKETS; ++i){
+        n += s.buckets[i];
+        if((i & (sub -1)) == sub -1)
+            out += fmt::format(
+                "{}_bucket{{{}le=\"{}\"}} {}\n",
+                name, labels, histogram_data::bucket_upper(i) * scale, n
+            );
+    }
+    
+    std::string sl;
+    if(!labels.empty())
+        sl = "{" + std::string(labels.data(), labels.size() -1) + "}";
+    out += fmt::format(
+        "{}_bucket{{{}le=\"+Inf\"}} {}\n{}_sum{} {}\n{}_count{} {}\n",
+        name, labels, s.count, name, sl, s.sum * scale, name, sl, s.count
+    );
+}
+
+inline void metric_histogram_text(
+    std::string& out, md::string_view name, md::string_view help,
+    const histogram_snapshot& s, double scale)
+{
+    metric_header(out, name, "histogram", help);
+    metric_histogram_series(out, name, "", s, scale);
+}
+
+}//::_internal
+
+/**
+ * Aggregates the metrics of every worker in the prometheus text format.
+ */
+inline std::string metrics_text()
+{
+    auto& r = _internal::metrics();
+    std::string out;
+    
+    auto single = [&r](
+        md::string_view name, md::string_view type, md::string_view help,
+        std::function<int64_t(const metrics_block&)> fn
+    ) -> std::string {
+        std::string s;
+        _internal::metric_header(s, name, type, help);
+        s += fmt::format("{} {}\n", name, r.sum<int64_t>(fn));
+        return s;
+    };
+    
+    out += single(
+        "evmvc_connections_open", "gauge", "Open connections.",
+    [](const metrics_block& b){ return b.connections_open.load();});
+    out += single(
+        "evmvc_connections_total", "counter", "Accepted connections.",
+    [](const metrics_block& b){ return b.connections.load();});
+    out += single(
+        "evmvc_requests_total", "counter", "Requests received.",
+    [](const metrics_block& b){ return b.requests.load();});
+    
+    _internal::metric_header(
+        out, "evmvc_responses_total", "counter", "Responses by status class."
+    );
+    static const char* classes[] = {
+        "invalid", "1xx", "2xx", "3xx", "4xx", "5xx"
+    };
+    for(size_t i = 0; i < 6; ++i)
+        out += fmt::format(
+            "evmvc_responses_total{{class=\"{}\"}} {}\n",
+            classes[i],
+            r.sum<uint64_t>([i](const metrics_block& b) -> uint64_t {
+                return b.responses[i].load(std::memory_order_relaxed);
+            })
+        );
+    
+    out += single(
+        "evmvc_parser_errors_total", "counter", "Malformed requests.",
+    [](const metrics_block& b){ return b.parser_errors.load();});
+    out += single(
+        "evmvc_handler_errors_total", "counter",
+        "Exceptions thrown by the route handlers.",
+    [](const metrics_block& b){ return b.handler_errors.load();});
+    out += single(
+        "evmvc_sent_bytes_total", "counter", "Bytes written to the sockets.",
+    [](const metrics_block& b){ return b.bytes_sent.load();});
+    
+    _internal::metric_histogram_text(
+        out, "evmvc_request_duration_seconds", "Requests latency.",
+        r.histogram(&metrics_block::latency), 1e-6
+    );
+    
+    out += single(
+        "evmvc_offload_queued", "gauge",
+        "Jobs waiting for a thread of the offload pool.",
+    [](const metrics_block& b){ return b.offload_queued.load();});
+    out += single(
+        "evmvc_offload_rejected_total", "counter",
+        "Jobs rejected by a full offload queue.",
+    [](const metrics_block& b){ return b.offload_rejected.load();});
+    _internal::metric_histogram_text(
+        out, "evmvc_offload_wait_seconds",
+        "Time spent by the offloaded jobs in the queue.",
+        r.histogram(&metrics_block::offload_wait), 1e-6
+    );
+    _internal::metric_histogram_text(
+        out, "evmvc_offload_duration_seconds",
+        "Time from the submission of a job to its completion on the loop.",
+        r.histogram(&metrics_block::offload_latency), 1e-6
+    );
+    
+    _internal::metric_histogram_text(
+        out, "evmvc_loop_lag_seconds",
+        "Delay of the event loop measured by the watchdog.",
+        r.histogram(&metrics_block::loop_lag), 1e-6
+    );
+    _internal::metric_header(
+        out, "evmvc_slow_callbacks_total", "counter",
+        "Callbacks blocking the event loop longer than slow_ms."
+    );
+    for(size_t i = 0; i < EVMVC_CALLBACK_KINDS; ++i)
+        out += fmt::format(
+            "evmvc_slow_callbacks_total{{kind=\"{}\"}} {}\n",
+            to_string((callback_kind)i),
+            r.sum<uint64_t>([i](const metrics_block& b) -> uint64_t {
+                return b.slow_callbacks[i].load(std::memory_order_relaxed);
+            })
+        );
+    
+    histogram_snapshot phases[EVMVC_TRACE_PHASES] = {};
+    uint64_t traced = 0;
+    for(size_t p = 0; p < EVMVC_TRACE_PHASES; ++p){
+        phases[p] = r.phase_histogram(p);
+        traced += phases[p].count;
+    }
+    if(traced > 0){
+        _internal::metric_header(
+            out, "evmvc_request_phase_seconds", "histogram",
+            "Latency by phase of the traced requests."
+        );
+        for(size_t p = 0; p < EVMVC_TRACE_PHASES; ++p)
+            _internal::metric_histogram_series(
+                out, "evmvc_request_phase_seconds",
+                fmt::format("phase=\"{}\",", to_string((trace_phase)p)),
+                phases[p], 1e-6
+            );
+    }
+    
+    for(auto& d : r.defs()){
+        size_t s = d.slot;
+        if(d.type == metric_type::histogram){
+            _internal::metric_histogram_text(
+                out, d.name, d.help, r.custom_histogram(s), 1
+            );
+            continue;
+        }
+        _internal::metric_header(
+            out, d.name,
+            d.type == metric_type::counter ? "counter" : "gauge", d.help
+        );
+        out += fmt::format("{} {}\n", d.name, r.sum<int64_t>(
+        [s](const metrics_block& b){
+            return b.custom[s].load(std::memory_order_relaxed);
+        }));
+    }
+    
+    return out;
+}
+
+}//::evmvc
+#endif //_libevmvc_metrics_h
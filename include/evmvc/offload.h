@@ -0,0 +1,348 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_offload_h
+#define _libevmvc_offload_h
+
+#include "stable_headers.h"
+#include "global.h"
+#include "configuration.h"
+#include "metrics.h"
+
+#include <thread>
+#include <deque>
+#include <sys/eventfd.h>
+
+namespace evmvc {
+
+/*
+    bounded thread pool of a worker process for the blocking work,
+    the completions are run on the event loop, woken up by an eventfd.
+    The threads are started on the first job, after the fork.
+*/
+class offload_pool
+{
+    struct job
+    {
+        std::function<void()> work;
+        std::function<void()> done;
+        int64_t queued_us;
+    };
+    
+    // a forked child leaks the state of its parent, the threads
+    // and the lock owners do not exist in the child
+    struct state
+    {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<job> jobs;
+        std::vector<job> completed;
+        std::vector<std::thread> threads;
+        bool stop = false;
+        int efd = -1;
+        event* ev = nullptr;
+    };
+
+public:
+    offload_pool()
+        : _st(nullptr), _pid(-1)
+    {
+    }
+    
+    // the event loop may already be released, only the threads are joined
+    ~offload_pool()
+    {
+        if(_st && _pid == getpid())
+            _join();
+    }
+    
+    offload_pool(const offload_pool&) = delete;
+    offload_pool& operator=(const offload_pool&) = delete;
+    
+    // called by the master before forking the workers
+    void configure(const offload_options& opts)
+    {
+        _opts = opts;
+    }
+    
+    const offload_options& options() const { return _opts;}
+    
+    static int64_t steady_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+    
+    /**
+     * Runs work on a thread of the pool then done on the event loop,
+     * returns false without calling them when the queue is full.
+     */
+    bool submit(std::function<void()> work, std::function<void()> done)
+    {
+        if(_pid != getpid())
+            _start();
+        
+        if(!_st){
+            work();
+            done();
+            return true;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lk(_st->mtx);
+            if(_st->jobs.size() >= _opts.max_queue){
+                worker_metrics().offload_rejected.fetch_add(
+                    1, std::memory_order_relaxed
+                );
+                return false;
+            }
+            _st->jobs.emplace_back(
+                job{std::move(work), std::move(done), steady_us()}
+            );
+        }
+        worker_metrics().offload_queued.fetch_add(
+            1, std::memory_order_relaxed
+        );
+        _st->cv.notify_one();
+        return true;
+    }
+    
+    /**
+     * Runs fn on the event loop, it may be called by any thread.
+     * fn is run inline when the pool has no thread.
+     */
+    void post(std::function<void()> fn)
+    {
+        if(!_st || _pid != getpid()){
+            fn();
+            return;
+        }
+        
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lk(_st->mtx);
+            wake = _st->completed.empty();
+            _st->completed.emplace_back(job{nullptr, std::move(fn), 0});
+        }
+        if(wake)
+            _wake(_st);
+    }
+    
+    // false on the threads of the pool
+    bool on_loop() const
+    {
+        return !_st || _pid != getpid() ||
+            std::this_thread::get_id() == _loop_id;
+    }
+    
+    // waits for the running jobs, the queued jobs are dropped
+    void stop()
+    {
+        if(!_st || _pid != getpid())
+            return;
+        
+        _join();
+        if(_st->ev){
+            event_del(_st->ev);
+            event_free(_st->ev);
+        }
+        close(_st->efd);
+        delete _st;
+        _st = nullptr;
+        _pid = -1;
+    }
+
+private:
+    void _join()
+    {
+        {
+            std::lock_guard<std::mutex> lk(_st->mtx);
+            _st->stop = true;
+            worker_metrics().offload_queued.fetch_sub(
+                _st->jobs.size(), std::memory_order_relaxed
+            );
+            _st->jobs.clear();
+        }
+        _st->cv.notify_all();
+        for(auto& t : _st->threads)
+            t.join();
+        _st->threads.clear();
+    }
+    
+    void _start()
+    {
+        _pid = getpid();
+        _loop_id = std::this_thread::get_id();
+        _st = nullptr;
+        if(_opts.threads == 0)
+            return;
+        
+        int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(efd == -1)
+            throw MD_ERR(
+                "Unable to create the offload pool eventfd: '{}'", errno
+            );
+        
+        _st = new state();
+        _st->efd = efd;
+        _st->ev = event_new(
+            global::ev_base(), efd, EV_READ | EV_PERSIST,
+            offload_pool::_on_completed, _st
+        );
+        event_add(_st->ev, nullptr);
+        
+        for(size_t i = 0; i < _opts.threads; ++i)
+            _st->threads.emplace_back(offload_pool::_run, _st);
+    }
+    
+    static void _run(state* st)
+    {
+        std::unique_lock<std::mutex> lk(st->mtx);
+        while(true){
+            st->cv.wait(lk, [st]{ return st->stop || !st->jobs.empty();});
+            if(st->stop)
+                return;
+            
+            job j = std::move(st->jobs.front());
+            st->jobs.pop_front();
+            lk.unlock();
+            
+            worker_metrics().offload_queued.fetch_sub(
+                1, std::memory_order_relaxed
+            );
+            worker_metrics().offload_wait.record(steady_us() - j.queued_us);
+            j.work();
+            
+            lk.lock();
+            // the loop is only woken up by the first completion
+            bool wake = st->completed.empty();
+            st->completed.emplace_back(std::move(j));
+            if(wake){
+                // the error is logged through post
+                lk.unlock();
+                _wake(st);
+                lk.lock();
+            }
+        }
+    }
+    
+    static void _wake(state* st)
+    {
+        uint64_t v = 1;
+        if(write(st->efd, &v, sizeof(v)) == -1 && errno != EAGAIN)
+            md::log::default_logger()->error(MD_ERR(
+                "Unable to wake up the event loop, errno: {}", errno
+            ));
+    }
+    
+    static void _on_completed(int fd, short /*events*/, void* arg)
+    {
+        state* st = (state*)arg;
+        uint64_t v;
+        while(read(fd, &v, sizeof(v)) > 0);
+        
+        std::vector<job> completed;
+        {
+            std::lock_guard<std::mutex> lk(st->mtx);
+            completed.swap(st->completed);
+        }
+        for(auto& j : completed){
+            // the posted functions have no work
+            if(j.work)
+                worker_metrics().offload_latency.record(
+                    steady_us() - j.queued_us
+                );
+            j.done();
+        }
+    }
+    
+    offload_options _opts;
+    state* _st;
+    pid_t _pid;
+    std::thread::id _loop_id;
+};
+
+namespace _internal {
+inline offload_pool& offload()
+{
+    static offload_pool _pool;
+    return _pool;
+}
+}//::_internal
+
+/**
+ * Runs fn on the offload pool of the worker, cb is called on the event
+ * loop with the error thrown by fn or the error of a full queue.
+ */
+inline void offload(std::function<void()> fn, md::callback::async_cb cb)
+{
+    auto err = std::make_shared<md::callback::cb_error>();
+    bool queued = _internal::offload().submit(
+        [fn, err](){
+            try{
+                fn();
+            }catch(const std::exception& e){
+                *err = MD_ERR("{}", e.what());
+            }catch(...){
+                *err = MD_ERR("Unknown error thrown by an offloaded job");
+            }
+        },
+        [cb, err](){
+            cb(*err);
+        }
+    );
+    if(!queued)
+        cb(MD_ERR("The offload queue is full"));
+}
+
+template<typename T>
+inline void offload(std::function<T()> fn, md::callback::value_cb<T> cb)
+{
+    struct result
+    {
+        md::callback::cb_error err;
+        T val;
+    };
+    auto r = std::make_shared<result>();
+    bool queued = _internal::offload().submit(
+        [fn, r](){
+            try{
+                r->val = fn();
+            }catch(const std::exception& e){
+                r->err = MD_ERR("{}", e.what());
+            }catch(...){
+                r->err = MD_ERR("Unknown error thrown by an offloaded job");
+            }
+        },
+        [cb, r](){
+            cb(r->err, std::move(r->val));
+        }
+    );
+    if(!queued)
+        cb(MD_ERR("The offload queue is full"), T());
+}
+
+}//::evmvc
+#endif //_libevmvc_offload_h
@@ -31,6 +31,9 @@ SOFTWARE.
 #include "statuses.h"
 #include "headers.h"
 #include "response.h"
+#include "arena.h"
+#include "metrics.h"
+#include "trace.h"
 
 #include "multipart_utils.h"
 
@@ -119,9 +122,8 @@ class http_parser
 {
     friend class connection;
 public:
-    http_parser(wp_connection conn, const md::log::logger& log)
-        : _conn(conn),
-        _log(log->add_child("parser"))
+    http_parser(wp_connection conn)
+        : _conn(conn), _bytes_out(0)
     {
         EVMVC_DEF_TRACE("http_parser {:p} created", (void*)this);
     }
@@ -133,7 +135,7 @@ public:
     }
     
     sp_connection get_connection() const { return _conn.lock();}
-    md::log::logger log() const { return _log;}
+    md::log::logger log() const;
     
     struct bufferevent* bev() const;
     
@@ -192,9 +194,27 @@ public:
         return completed() || !ok();
     }
     
+    const sp_request_arena& arena()
+    {
+        if(!_arena)
+            _acquire_arena();
+        return _arena;
+    }
+    
+    // time of the current request line
+    std::chrono::steady_clock::time_point started_at() const
+    {
+        return _started_at;
+    }
+    
+    // bytes queued on the output since the current request line
+    uint64_t bytes_out() const { return _bytes_out;}
+    
+    request_trace& trace() { return _trace;}
+    
     void reset()
     {
-        EVMVC_DBG(_log, "parser reset");
+        EVMVC_DBG(log(), "parser reset");
         
         _status = parser_state::parse_req_line;
         
@@ -213,7 +233,7 @@ public:
     
     size_t parse(const char* in_data, size_t in_len, md::callback::cb_error& ec)
     {
-        EVMVC_TRACE(_log,
+        EVMVC_TRACE(log(),
             "parsing, len: {}\n{}", in_len, std::string(in_data, in_len)
         );
         
@@ -405,11 +425,20 @@ private:
             //     _http_ver = http_version::http_2;
             */
             _status = parser_state::parse_header;
-            _hdrs = std::make_shared<header_map_t>();
+            _started_at = std::chrono::steady_clock::now();
+            _bytes_out = 0;
+            _trace.begin(_started_at, _internal::tracing().active());
+            worker_metrics().requests.fetch_add(
+                1, std::memory_order_relaxed
+            );
+            _acquire_arena();
+            _hdrs = std::allocate_shared<header_map_t>(
+                arena_allocator<header_map_t>(_arena)
+            );
             
             //_bytes_read += eol_idx + EVMVC_EOL_SIZE;
         }catch(const std::exception& err){
-            _log->error("Failed to parse request line!\n{}", err.what());
+            log()->error("Failed to parse request line!\n{}", err.what());
             this->reset();
         }
         
@@ -435,7 +464,7 @@ private:
             }
             
             std::string hn(line, sep);
-            // EVMVC_TRACE(_log,
+            // EVMVC_TRACE(log(),
             //     "Inserting header, name: '{}', value: '{}'",
             //     hn, data_substring(line, sep+1, line_len)
             // );
@@ -465,7 +494,7 @@ private:
                 ));
             
         }catch(const std::exception& err){
-            _log->error("Failed to parse header line!\n{}", err.what());
+            log()->error("Failed to parse header line!\n{}", err.what());
             this->reset();
         }
         
@@ -559,7 +588,7 @@ private:
         
         //size_t blen = evbuffer_get_length(buf);
         
-        EVMVC_TRACE(_log,
+        EVMVC_TRACE(log(),
             "on_read_multipart_data received '{}' bytes", in_len
         );
         
@@ -581,14 +610,11 @@ private:
         size_t r = read_body(in_data, in_len, ec);
         
         if(_mp_completed){
-            std::string sbody(
-                (const char*)evbuffer_pullup(_mp_buf, _body_size),
-                _body_size
-            );
-            _res->_req->_body_params->emplace_back(
-                std::make_shared<http_param>(
-                    "", sbody
-                )
+            auto& bp = _res->_req->_body_params;
+            char* data = bp->adopt_buffer(_mp_buf);
+            _mp_buf = nullptr;
+            bp->emplace_back_view(
+                md::string_view("", 0), md::string_view(data, _body_size)
             );
             reset_body();
             _status = parser_state::ready_to_exec;
@@ -603,45 +629,10 @@ private:
         size_t r = read_body(in_data, in_len, ec);
         
         if(_mp_completed){
-            evmvc::http_params body_params = std::make_unique<http_params_t>();
-            std::string sbody(
-                (const char*)evbuffer_pullup(_mp_buf, _body_size),
-                _body_size
-            );
-            // replace '+' with ' '
-            md::replace_substring(sbody, "+", " ");
-            
-            // true = key, false = value
-            bool tkfv = true;
-            std::string k;
-            std::string v;
-            for(auto c : sbody){
-                if(c == '=')
-                    tkfv = false;
-                else if(c == '&'){
-                    _res->_req->_body_params->emplace_back(
-                        std::make_shared<http_param>(
-                            evmvc::unescape(k),
-                            evmvc::unescape(v)
-                        )
-                    );
-                    
-                    tkfv = true;
-                    k.clear();
-                    v.clear();
-                    
-                }else if(tkfv)
-                    k += c;
-                else
-                    v += c;
-            }
-            if(!k.empty() || !v.empty())
-                _res->_req->_body_params->emplace_back(
-                    std::make_shared<http_param>(
-                        evmvc::unescape(k),
-                        evmvc::unescape(v)
-                    )
-                );
+            auto& bp = _res->_req->_body_params;
+            char* data = bp->adopt_buffer(_mp_buf);
+            _mp_buf = nullptr;
+            bp->parse_urlencoded(data, _body_size);
             
             reset_body();
             _status = parser_state::ready_to_exec;
@@ -685,14 +676,14 @@ private:
         std::string hdr_line(hdr);
         size_t col_idx = hdr_line.find_first_of(":");
         if(col_idx == std::string::npos){
-            _log->error("Invalid boundary header format!");
+            log()->error("Invalid boundary header format!");
             return false;
         }
         
         std::string hdr_name = hdr_line.substr(0, col_idx);
         std::string hdr_val = hdr_line.substr(col_idx +1);
         
-        EVMVC_TRACE(_log,
+        EVMVC_TRACE(log(),
             "Inserting multipart header, name: '{}', value: '{}'",
             hdr_name, hdr_val
         );
@@ -801,11 +792,11 @@ private:
     
     md::callback::cb_error _mp_parse_end_of_section(bool& ended, char* line)
     {
-        EVMVC_TRACE(_log, "parse_end_of_section");
+        EVMVC_TRACE(log(), "parse_end_of_section");
 
         if(_mp_current->get_parent()->start_boundary == line){
             ended = true;
-            EVMVC_TRACE(_log, "start boundary detected");
+            EVMVC_TRACE(log(), "start boundary detected");
             
             _mp_state = evmvc::multip::multipart_parser_state::headers;
             if(auto sp = _mp_current->parent.lock()){
@@ -824,7 +815,7 @@ private:
         
         if(_mp_current->get_parent()->end_boundary == line){
             ended = true;
-            EVMVC_TRACE(_log, "end boundary detected");
+            EVMVC_TRACE(log(), "end boundary detected");
             
             _mp_state = evmvc::multip::multipart_parser_state::headers;
             if(std::shared_ptr<multip::multipart_subcontent> spa = 
@@ -851,7 +842,7 @@ private:
         }
         
         if(ended && _mp_current == _mp_root){
-            EVMVC_TRACE(_log, "on_read_file_data transmission is completed!");
+            EVMVC_TRACE(log(), "on_read_file_data transmission is completed!");
             _mp_completed = true;
         }
         
@@ -860,7 +851,7 @@ private:
     
     md::callback::cb_error _mp_on_read_form_data(bool& has_works)
     {
-        EVMVC_TRACE(_log, "on_read_form_data");
+        EVMVC_TRACE(log(), "on_read_form_data");
         
         size_t len;
         char* line = evbuffer_readln(_mp_buf, &len, EVBUFFER_EOL_CRLF_STRICT);
@@ -870,7 +861,7 @@ private:
             return nullptr;
         }
         
-        EVMVC_TRACE(_log, "recv: '{}'\n", line);
+        EVMVC_TRACE(log(), "recv: '{}'\n", line);
         bool ended = false;
         md::callback::cb_error cberr = _mp_parse_end_of_section(ended, line);
         if(cberr || ended){
@@ -890,7 +881,7 @@ private:
     
     md::callback::cb_error _mp_on_read_file_data(bool& has_works)
     {
-        EVMVC_TRACE(_log, "on_read_file_data");
+        EVMVC_TRACE(log(), "on_read_file_data");
         size_t len;
         char* line = evbuffer_readln(_mp_buf, &len, EVBUFFER_EOL_CRLF_STRICT);
         
@@ -899,7 +890,7 @@ private:
         );
         
         if(line != nullptr){
-            EVMVC_TRACE(_log, "recv: '{}'\n", line);
+            EVMVC_TRACE(log(), "recv: '{}'\n", line);
             bool ended = false;
             md::callback::cb_error cberr = _mp_parse_end_of_section(
                 ended, line
@@ -932,7 +923,7 @@ private:
                 
                 char buf[buf_size];
                 evbuffer_remove(_mp_buf, buf, buf_size);
-                EVMVC_TRACE(_log,
+                EVMVC_TRACE(log(),
                     "extracted: '{}'",
                     std::string(buf, buf+buf_size)
                 );
@@ -971,7 +962,7 @@ private:
 
     void _mp_on_request_end()
     {
-        EVMVC_TRACE(_log, "on multipart request end");
+        EVMVC_TRACE(log(), "on multipart request end");
         reset_multip();
         _status = parser_state::ready_to_exec;
     }
@@ -986,7 +977,7 @@ private:
         
         //size_t blen = evbuffer_get_length(buf);
         
-        EVMVC_TRACE(_log,
+        EVMVC_TRACE(log(),
             "on_read_multipart_data received '{}' bytes", in_len
         );
         
@@ -1009,7 +1000,7 @@ private:
                         break;
                     }
                     
-                    EVMVC_TRACE(_log, "recv: '{}'", line);
+                    EVMVC_TRACE(log(), "recv: '{}'", line);
                     if(_mp_current->get_parent()->start_boundary != line){
                         free(line);
                         cberr = MD_ERR(
@@ -1054,7 +1045,7 @@ private:
                         break;
                     }
                     
-                    EVMVC_TRACE(_log, "recv: '{}'", line);
+                    EVMVC_TRACE(log(), "recv: '{}'", line);
                     if(len == 0){
                         // end of header part
                         free(line);
@@ -1137,7 +1128,7 @@ private:
         }
         
         if(_mp_completed){
-            EVMVC_TRACE(_log, "Multipart parser task completed!");
+            EVMVC_TRACE(log(), "Multipart parser task completed!");
             _res->req()->_load_multipart_params(_mp_root);
             _mp_on_request_end();
         }
@@ -1146,9 +1137,17 @@ private:
     }
     
     
+    // the arena is recycled once the previous request objects are released
+    void _acquire_arena()
+    {
+        if(_arena && _arena.use_count() == 1)
+            return _arena->rewind();
+        _arena = std::make_shared<request_arena>();
+    }
+    
     /// private vars
     wp_connection _conn;
-    md::log::logger _log;
+    mutable md::log::logger _log;
     
     parser_state _status = parser_state::parse_req_line;
     
@@ -1163,7 +1162,12 @@ private:
     evmvc::url _uri;
     std::string _http_ver_string;
     http_version _http_ver;
+    std::chrono::steady_clock::time_point _started_at;
+    uint64_t _bytes_out;
+    request_trace _trace;
     
+    // backs the objects of the current request
+    sp_request_arena _arena;
     std::shared_ptr<header_map_t> _hdrs;
     response _res;
     route_result _rr;
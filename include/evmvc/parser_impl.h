@@ -38,6 +38,8 @@ inline void http_parser::exec()
     if(_status != parser_state::ready_to_exec)
         throw MD_ERR("Invalid state: {}", to_string(_status));
     _status = parser_state::responding;
+    _trace.mark(trace_mark::handler);
+    callback_scope scope(callback_kind::route, _rr->_route->path());
     
     try{
         _rr->execute(_rr, _res, [res = _res](auto error){
@@ -57,6 +59,9 @@ inline void http_parser::exec()
         });
         _rr.reset();
     }catch(const std::exception& err){
+        worker_metrics().handler_errors.fetch_add(
+            1, std::memory_order_relaxed
+        );
         _res->error(
             evmvc::status::internal_server_error,
             MD_ERR(err.what())
@@ -65,8 +70,18 @@ inline void http_parser::exec()
 }
 
 
+inline md::log::logger http_parser::log() const
+{
+    if(!_log){
+        sp_connection c = _conn.lock();
+        _log = (c ? c->log() : md::log::default_logger())->add_child("parser");
+    }
+    return _log;
+}
+
 inline void http_parser::validate_headers()
 {
+    _trace.mark(trace_mark::headers);
     sp_connection c = this->_conn.lock();
     if(!c){
         _status = parser_state::error;
@@ -81,23 +96,27 @@ inline void http_parser::validate_headers()
     base_url += md::trim_copy(it->second.front());
     _uri = url(base_url, _uri_string);
     
-    _log->success(
-        "REQ received, "
-        "host: '{}', method: '{}', uri: '{}'",
-        _uri.hostname(),
-        _method_string,
-        _uri_string
-    );
+    if(c->should_log(md::log::log_level::info))
+        log()->success(
+            "REQ received, "
+            "host: '{}', method: '{}', uri: '{}'",
+            _uri.hostname(),
+            _method_string,
+            _uri_string
+        );
     
     app a = this->_conn.lock()->get_worker()->get_app();
     
     _rr = a->_router->resolve_url(_method_string, _uri.path());
     if(!_rr && _method == evmvc::method::head)
         _rr = a->_router->resolve_url(evmvc::method::get, _uri.path());
+    _trace.mark(trace_mark::route);
+    if(_trace.enabled())
+        _trace.enable(!_rr || _rr->_route->traced());
     
     // stop request if no valid route_t found
     if(!_rr){
-        _log->fail(
+        log()->fail(
             "recv: [{}] [{}] from: [{}:{}], err: 404",
             _method_string,
             _uri.to_string(),
@@ -122,8 +141,9 @@ inline void http_parser::validate_headers()
             ctx,
         [self = this->shared_from_this(), a, rr = _rr, res = _res, uri = _uri]
         (const md::callback::cb_error& err){
+            self->_trace.mark(trace_mark::policies);
             if(err)
-                self->_log->fail("Access Denied!\n{}", err.c_str());
+                self->log()->fail("Access Denied!\n{}", err.c_str());
             
             res->resume([a, /*_rr = rr, */res, v_err = err, uri]
             (const md::callback::cb_error& err){
@@ -153,13 +173,14 @@ inline void http_parser::validate_headers()
         return;
     }
     
-    c->log()->success(
-        "recv: [{}] [{}] from: [{}:{}]",
-        _method_string,
-        _uri.to_string(),
-        c->remote_address(),
-        c->remote_port()
-    );
+    if(c->should_log(md::log::log_level::info))
+        c->log()->success(
+            "recv: [{}] [{}] from: [{}:{}]",
+            _method_string,
+            _uri.to_string(),
+            c->remote_address(),
+            c->remote_port()
+        );
     
     // create the response
     _res = _internal::create_http_response(
@@ -175,8 +196,9 @@ inline void http_parser::validate_headers()
         ctx,
     [self = this->shared_from_this(), a, rr = _rr, res = _res]
     (const md::callback::cb_error& err){
+        self->_trace.mark(trace_mark::policies);
         if(err)
-            self->_log->fail("Access Denied!\n{}", err.c_str());
+            self->log()->fail("Access Denied!\n{}", err.c_str());
         
         res->resume([a, /*_rr = rr, */res, v_err = err]
         (const md::callback::cb_error& err){
@@ -204,9 +226,9 @@ inline void http_parser::init_multip()
     
     _mp_buf = evbuffer_new();
     
-    std::string boundary = multip::get_boundary(_log, _hdrs);
+    std::string boundary = multip::get_boundary(log(), _hdrs);
     if(boundary.size() == 0){
-        _log->error(MD_ERR(
+        log()->error(MD_ERR(
             "Invalid multipart/form-data boundary"
         ));
         _status = parser_state::error;
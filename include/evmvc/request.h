@@ -35,6 +35,7 @@ SOFTWARE.
 #include "http_param.h"
 #include "files.h"
 #include "jwt.h"
+#include "arena.h"
 
 namespace evmvc {
 
@@ -66,36 +67,35 @@ public:
         uint64_t id,
         http_version ver,
         wp_connection conn,
-        md::log::logger log,
         const evmvc::route& rt,
         url uri,
         evmvc::method met,
         md::string_view smet,
         header_map hdrs,
         const http_cookies& http_cookies_t,
-        const std::vector<std::shared_ptr<evmvc::http_param>>& p
+        evmvc::http_params_t&& p,
+        const sp_request_arena& arena
         )
         : _id(id),
         _version(ver),
         _conn(conn),
-        _log(log->add_child(
-            "req-" + md::num_to_str(id, false) +
-            "/" + uri.to_string()
-        )),
         _rt(rt),
         _uri(std::move(uri)),
         _met(met),
         _smet(smet.to_string()),
-        _headers(std::make_shared<evmvc::request_headers_t>(hdrs)),
+        _headers(std::allocate_shared<evmvc::request_headers_t>(
+            arena_allocator<evmvc::request_headers_t>(arena), hdrs
+        )),
         _cookies(http_cookies_t),
-        _rt_params(std::make_unique<http_params_t>(p)),
-        _qry_params(std::make_unique<http_params_t>()),
+        _rt_params(std::make_unique<http_params_t>(std::move(p))),
+        _qry_params(),
         _body_params(std::make_unique<http_params_t>()),
         _files()
     {
         EVMVC_DEF_TRACE("request_t {} {:p} created", _id, (void*)this);
         
-        if(_log->should_log(md::log::log_level::trace)){
+        #if EVMVC_BUILD_DEBUG
+        if(log()->should_log(md::log::log_level::trace)){
             std::string hdrs_dbg;
             for(auto& it : *hdrs.get())
                 hdrs_dbg += fmt::format(
@@ -103,42 +103,9 @@ public:
                     it.first,
                     md::join(it.second, "; ")
                 );
-            EVMVC_TRACE(_log, hdrs_dbg);
+            EVMVC_TRACE(log(), hdrs_dbg);
         }
-        
-        // building the _qry_params object
-        std::string qry = uri.query();
-        if(qry.empty())
-            return;
-        
-        ssize_t it_idx = 0;
-        do{
-            ssize_t nit_idx = evmvc::find_ch(
-                qry.c_str(), qry.size(), '&', it_idx
-            );
-            
-            if(nit_idx == -1)
-                nit_idx = qry.size();
-            
-            ssize_t sep_idx = evmvc::find_ch(
-                qry.c_str(), qry.size(), '=', it_idx
-            );
-            
-            if(sep_idx > -1 && sep_idx < nit_idx){
-                _qry_params->emplace_back(std::make_shared<evmvc::http_param>(
-                    sep_idx == it_idx ? "" : 
-                        evmvc::data_substring(qry.c_str(), it_idx, sep_idx),
-                    evmvc::data_substring(qry.c_str(), sep_idx+1, nit_idx)
-                ));
-            }else{
-                _qry_params->emplace_back(std::make_shared<evmvc::http_param>(
-                    evmvc::data_substring(qry.c_str(), it_idx, nit_idx),
-                    ""
-                ));
-            }
-            
-            it_idx = nit_idx +1;
-        }while(it_idx > -1 && it_idx < (ssize_t)qry.size());
+        #endif //EVMVC_BUILD_DEBUG
     }
     
     ~request_t()
@@ -150,7 +117,15 @@ public:
     evmvc::app get_app() const;
     evmvc::router get_router()const;
     evmvc::route get_route()const { return _rt;}
-    md::log::logger log() const { return _log;}
+    // the child logger is only created once something is logged
+    md::log::logger log() const
+    {
+        if(!_log)
+            _log = _internal::request_logger(_conn, _rt)->add_child(
+                "req-" + md::num_to_str(_id, false) + "/" + _uri.to_string()
+            );
+        return _log;
+    }
     const url& uri() const { return _uri;}
     
     std::string connection_ip() const;
@@ -229,55 +204,57 @@ public:
     http_files& files() const { return *(_files.get());}
     
     http_params_t& params() const { return *(_rt_params.get());}
-    http_param& params(md::string_view name) const
+    const http_param& params(md::string_view name) const
     {
         auto p = _rt_params->get(name);
         if(p)
-            return *(p.get());
+            return *p;
         throw MD_ERR("Param do not exist: '{}'", name);
     }
     template<typename PARAM_T>
     PARAM_T params(md::string_view name, PARAM_T def_val) const
     {
-        auto p = _rt_params->get(name);
-        if(p)
-            return p->get<PARAM_T>();
-        return def_val;
+        return _rt_params->get<PARAM_T>(name, def_val);
     }
     
-    http_params_t& query() const { return *(_qry_params.get());}
-    http_param& query(md::string_view name) const
+    http_params_t& query() const
     {
-        return *(_qry_params->get(name).get());
+        if(!_qry_params){
+            // the query string is only parsed on first access
+            _qry_params = std::make_unique<http_params_t>();
+            _qry_params->parse_urlencoded(_uri.query());
+        }
+        return *(_qry_params.get());
+    }
+    const http_param& query(md::string_view name) const
+    {
+        auto p = query().get(name);
+        if(p)
+            return *p;
+        throw MD_ERR("Query param do not exist: '{}'", name);
     }
     template<typename PARAM_T>
     PARAM_T query(md::string_view name, PARAM_T def_val) const
     {
-        auto p = _qry_params->get(name);
-        if(p)
-            return p->get<PARAM_T>();
-        return def_val;
+        return query().get<PARAM_T>(name, def_val);
     }
     
     bool has_body(md::string_view name) const
     {
-        auto p = _body_params->get(name);
-        if(p)
-            return true;
-        return false;
+        return _body_params->get(name) != nullptr;
     }
     http_params_t& body() const { return *(_body_params.get());}
-    http_param& body(md::string_view name) const
+    const http_param& body(md::string_view name) const
     {
-        return *(_body_params->get(name).get());
+        auto p = _body_params->get(name);
+        if(p)
+            return *p;
+        throw MD_ERR("Body param do not exist: '{}'", name);
     }
     template<typename PARAM_T>
     PARAM_T body(md::string_view name, PARAM_T def_val) const
     {
-        auto p = _body_params->get(name);
-        if(p)
-            return p->get<PARAM_T>();
-        return def_val;
+        return _body_params->get<PARAM_T>(name, def_val);
     }
     
     evmvc::method method()
@@ -336,7 +313,7 @@ public:
                 return nlohmann::json();
             return p->get<nlohmann::json>();
         }catch(const std::exception& err){
-            _log->error(
+            log()->error(
                 "Body is not a valid JSON!\n{}",
                 err.what()
             );
@@ -371,7 +348,7 @@ protected:
     uint64_t _id;
     http_version _version;
     wp_connection _conn;
-    md::log::logger _log;
+    mutable md::log::logger _log;
     evmvc::route _rt;
     evmvc::url _uri;
     evmvc::method _met;
@@ -381,7 +358,7 @@ protected:
     http_cookies _cookies;
     
     evmvc::http_params _rt_params;
-    evmvc::http_params _qry_params;
+    mutable evmvc::http_params _qry_params;
     evmvc::http_params _body_params;
     
     evmvc::sp_http_files _files;
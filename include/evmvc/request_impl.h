@@ -117,11 +117,7 @@ inline void request_t::_load_multipart_params(
                 std::static_pointer_cast<
                     multip::multipart_content_form
                 >(ct);
-            _body_params->emplace_back(
-                std::make_shared<http_param>(
-                    mcf->name, mcf->value
-                )
-            );
+            _body_params->emplace_back(mcf->name, mcf->value);
         }
     }
 }
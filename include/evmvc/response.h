@@ -32,9 +32,12 @@ SOFTWARE.
 #include "headers.h"
 #include "fields.h"
 #include "mime.h"
+#include "compression.h"
 #include "cookies.h"
 #include "request.h"
 #include "response_data.h"
+#include "arena.h"
+#include "offload.h"
 
 #include <boost/filesystem.hpp>
 
@@ -52,10 +55,10 @@ public:
         uint64_t id,
         request req,
         wp_connection conn,
-        md::log::logger log,
         const route& rt,
         url uri,
-        const http_cookies& http_cookies_t
+        const http_cookies& http_cookies_t,
+        const sp_request_arena& arena
     );
     
     ~response_t()
@@ -71,7 +74,15 @@ public:
     evmvc::app get_app() const;
     evmvc::router get_router()const;
     evmvc::route get_route()const { return _rt;}
-    md::log::logger log() const { return _log;}
+    // the child logger is only created once something is logged
+    md::log::logger log() const
+    {
+        if(!_log)
+            _log = _internal::request_logger(_conn, _rt)->add_child(
+                "res-" + md::num_to_str(_id, false) + _req->uri().path()
+            );
+        return _log;
+    }
     
     evmvc::response_headers_t& headers() const { return *(_headers.get());}
     http_cookies_t& cookies() const { return *(_cookies.get());}
@@ -82,7 +93,7 @@ public:
     void resume(md::callback::async_cb cb)
     {
         if(!_paused || _resuming){
-            _log->warn(MD_ERR(
+            log()->warn(MD_ERR(
                 "SHOULD NOT RESUME, is paused: {}, is resuming: {}",
                 _paused ? "true" : "false",
                 _resuming ? "true" : "false"
@@ -94,6 +105,14 @@ public:
     }
     void resume();
     
+    /**
+     * Runs the blocking fn on the offload pool of the worker,
+     * the response is paused until cb is called on the event loop.
+     */
+    void offload(std::function<void()> fn, md::callback::async_cb cb);
+    template<typename T>
+    void offload(std::function<T()> fn, md::callback::value_cb<T> cb);
+    
     bool started(){ return _started;};
     bool ended(){ return _ended;}
     void end()
@@ -101,7 +120,7 @@ public:
         if(!_started)
             this->encoding("utf-8").type("txt")._reply_start();
         if(_ended){
-            _log->error(MD_ERR(
+            log()->error(MD_ERR(
                 "MUST NOT END, ended: true"
             ));
             return;
@@ -177,6 +196,9 @@ public:
         if(_type.empty())
             this->type("txt", "utf-8");
         
+        if(this->_init_compression(body.size()))
+            return this->_send_compressed(body);
+        
         this->headers().set(
             evmvc::field::content_length,
             md::num_to_str(body.size())
@@ -187,6 +209,12 @@ public:
         this->end();
     }
     
+    /**
+     * Sends the content of body, its segments are moved to the connection
+     * and written with a single gather write.
+     */
+    void send(evbuffer* body);
+    
     void send_event(
         md::string_view event,
         md::string_view data = "",
@@ -305,7 +333,7 @@ public:
     {
         return _scripts;
     }
-    std::map<std::string, std::string>& sections()
+    std::map<std::string, std::shared_ptr<std::string>>& sections()
     {
         return _sections;
     }
@@ -331,7 +359,7 @@ public:
         if(!_err)
             return;
         
-        this->_log->info(
+        this->log()->info(
             "Clearing current error: '{}'",
             _err
         );
@@ -408,12 +436,22 @@ public:
     
     void render(const std::string& view_path, md::callback::async_cb cb);
     
+    /*
+        chunked body streaming, headers are sent by stream_start,
+        each stream_write sends the whole chunk content as one chunk.
+    */
+    bool streaming() const { return _streaming;}
+    void stream_start();
+    void stream_write(evbuffer* chunk);
+    void stream_end();
+    void stream_abort();
+    
 private:
     
     void _resume(md::callback::cb_error err)
     {
         if(!_paused || !_resuming){
-            _log->warn(MD_ERR(
+            log()->warn(MD_ERR(
                 "SHOULD NOT RESUME, is paused: {}, is resuming: {}",
                 _paused ? "true" : "false",
                 _resuming ? "true" : "false"
@@ -432,37 +470,48 @@ private:
     void _reply_start()
     {
         if(_started){
-            _log->error(MD_ERR(
+            log()->error(MD_ERR(
                 "MUST NOT _reply_start, started: true"
             ));
             return;
         }
-        EVMVC_TRACE(_log, "_reply_start");
+        EVMVC_TRACE(log(), "_reply_start");
         
         _prepare_headers();
         _started = true;
     }
     
     void _reply_end();
+    void _record_reply(connection& c);
     
     void _reply_raw(const char* data, size_t len);
     
+    bool _init_compression(size_t body_size);
+    void _send_compressed(md::string_view body);
+    void _send_compressed(evbuffer* body);
+    void _compress_buffer(evbuffer* src, evbuffer* zbuf, compress_flush last);
+    void _release_compressor();
+    void _abort_compression(evbuffer* zbuf);
+    void _send_chunk(evbuffer* chunk);
+    
     uint64_t _id;
     evmvc::request _req;
     wp_connection _conn;
-    md::log::logger _log;
+    mutable md::log::logger _log;
     route _rt;
     evmvc::response_headers _headers;
     http_cookies _cookies;
     bool _started;
     bool _event_started;
     bool _ended;
+    bool _streaming;
     int16_t _status;
     std::string _type;
     std::string _enc;
     bool _paused;
     bool _resuming;
     md::callback::async_cb _resume_cb;
+    evmvc::compressor _zc;
     
     evmvc::response_data_map _res_data;
     
@@ -471,7 +520,7 @@ private:
     
     std::vector<std::string> _styles;
     std::vector<std::string> _scripts;
-    std::map<std::string, std::string> _sections;
+    std::map<std::string, std::shared_ptr<std::string>> _sections;
 };
 
 
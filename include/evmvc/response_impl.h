@@ -28,8 +28,7 @@ SOFTWARE.
 #include "response.h"
 
 #include "view_engine.h"
-
-#include <boost/date_time/posix_time/posix_time.hpp>
+#include "cached_clock.h"
 
 
 #define EVMVC_MAX_RES_STATUS_LINE_LEN 47
@@ -42,24 +41,26 @@ inline response_t::response_t(
     uint64_t id,
     request req,
     wp_connection conn,
-    md::log::logger log,
     const route& rt,
     url uri,
-    const http_cookies& http_cookies_t)
+    const http_cookies& http_cookies_t,
+    const sp_request_arena& arena)
     : _id(id),
     _req(req),
     _conn(conn),
-    _log(log->add_child(
-        "res-" + md::num_to_str(id, false) + uri.path()
-    )),
     _rt(rt),
-    _headers(std::make_shared<response_headers_t>()),
+    _headers(std::allocate_shared<response_headers_t>(
+        arena_allocator<response_headers_t>(arena)
+    )),
     _cookies(http_cookies_t),
     _started(false), _event_started(false), _ended(false),
+    _streaming(false),
     _status(-1), _type(""), _enc(""),
     _paused(false),
     _resuming(false),
-    _res_data(std::make_shared<evmvc::response_data_map_t>()),
+    _res_data(std::allocate_shared<evmvc::response_data_map_t>(
+        arena_allocator<evmvc::response_data_map_t>(arena)
+    )),
     _err(nullptr), _err_status(evmvc::status::ok)
 {
     EVMVC_DEF_TRACE("response_t {} {:p} created", _id, (void*)this);
@@ -111,7 +112,7 @@ inline void response_t::pause()
 inline void response_t::resume()
 {
     if(!_paused || _resuming){
-        _log->warn(MD_ERR(
+        log()->warn(MD_ERR(
             "SHOULD NOT RESUME, is paused: {}, is resuming: {}",
             _paused ? "true" : "false",
             _resuming ? "true" : "false"
@@ -132,7 +133,7 @@ inline void response_t::set_error(
     evmvc::status status_code)
 {
     if(_err)
-        this->_log->warn(
+        this->log()->warn(
             "Overriding current error: '{}' with error: '{}'",
             _err, err
         );
@@ -257,12 +258,16 @@ inline void response_t::error(
         this->log()->error(MD_ERR(err.what()));
     }
     
+    // a streamed response can't be replaced by the error page
+    if(_ended)
+        return;
+    
     this->status(err_status).html(err_msg);
 }
 
 inline void response_t::_prepare_headers()
 {
-    EVMVC_TRACE(_log, "_prepare_headers");
+    EVMVC_TRACE(log(), "_prepare_headers");
     
     if(_started)
         throw std::runtime_error(
@@ -271,12 +276,12 @@ inline void response_t::_prepare_headers()
         
     auto c = _conn.lock();
     if(!c){
-        _log->warn("Unable to lock the connection");
+        log()->warn("Unable to lock the connection");
         return;
     }
     
     if(this->_status == -1){
-        EVMVC_DBG(_log, "Status not set, setting status to 200 OK");
+        EVMVC_DBG(log(), "Status not set, setting status to 200 OK");
         this->_status = 200;
     }
     
@@ -332,9 +337,26 @@ inline void response_t::_prepare_headers()
         }
     }
     
+    auto& tr = c->parser()->trace();
+    tr.mark(trace_mark::first_byte);
+    if(tr.enabled() && _internal::tracing().options().server_timing &&
+        !_headers->exists("server-timing")
+    )
+        _headers->set("Server-Timing", tr.server_timing());
+    
     // write headers
     char* hl = header_line_buf();
     
+    if(!_headers->exists(field::date)){
+        md::string_view dl = _internal::coarse_clock().date_line();
+        #if EVMVC_BUILD_DEBUG
+        dbg_hdrs += dl.to_string();
+        #endif //EVMVC_BUILD_DEBUG
+        
+        if(bufferevent_write(c->bev(), dl.data(), dl.size()))
+            return this->_reply_end();
+    }
+    
     for(auto& it : *_headers->_hdrs.get()){
         for(auto& itv : it.second){
             if(it.first.size() + itv.size() + 5 > EVMVC_MAX_RES_HEADER_LINE_LEN)
@@ -393,7 +415,7 @@ inline void response_t::_prepare_headers()
     }
     
     #if EVMVC_BUILD_DEBUG
-        _log->trace("Headers sent:\n{}", dbg_hdrs);
+        log()->trace("Headers sent:\n{}", dbg_hdrs);
     #endif //EVMVC_BUILD_DEBUG
     
     if(bufferevent_write(c->bev(), "\r\n", 2))
@@ -404,7 +426,7 @@ inline void response_t::_prepare_headers()
 
 inline void response_t::_reply_raw(const char* data, size_t len)
 {
-    EVMVC_TRACE(_log, "_reply_raw");
+    EVMVC_TRACE(log(), "_reply_raw");
     if(auto c = this->_conn.lock()){
         if(bufferevent_write(c->bev(), data, len))
             return this->_reply_end();
@@ -413,18 +435,299 @@ inline void response_t::_reply_raw(const char* data, size_t len)
     }
 }
 
+inline bool response_t::_init_compression(size_t body_size)
+{
+    const auto& opts = this->get_app()->options().compression;
+    if(!compression_eligible(opts, body_size, _type))
+        return false;
+    if(_headers->exists(evmvc::field::content_encoding))
+        return false;
+    
+    _headers->set(evmvc::field::vary, "Accept-Encoding", false);
+    
+    shared_header hdr = _req->headers().get(evmvc::field::accept_encoding);
+    if(!hdr)
+        return false;
+    
+    encoding_type enc = negotiate_encoding(hdr->accept_encodings());
+    if(enc == encoding_type::unsupported)
+        return false;
+    
+    _zc = _internal::compressors().acquire(enc, opts);
+    _headers->set(evmvc::field::content_encoding, to_string(enc));
+    return true;
+}
+
+inline void response_t::send(evbuffer* body)
+{
+    if(this->_paused)
+        this->resume();
+    
+    if(_type.empty())
+        this->type("txt", "utf-8");
+    
+    size_t len = evbuffer_get_length(body);
+    if(this->_init_compression(len))
+        return this->_send_compressed(body);
+    
+    this->headers().set(
+        evmvc::field::content_length,
+        md::num_to_str(len)
+    );
+    
+    _reply_start();
+    auto c = this->_conn.lock();
+    if(!c || bufferevent_write_buffer(c->bev(), body))
+        return this->_reply_end();
+    this->end();
+}
+
+inline void response_t::_send_compressed(md::string_view body)
+{
+    auto c = this->_conn.lock();
+    if(!c){
+        _release_compressor();
+        return this->_reply_end();
+    }
+    
+    // the compressed body is moved to the connection output without copy
+    evbuffer* zbuf = _internal::compression_buffer();
+    try{
+        _zc->compress(body.data(), body.size(), zbuf, compress_flush::finish);
+    }catch(...){
+        _abort_compression(zbuf);
+        throw;
+    }
+    _release_compressor();
+    
+    EVMVC_TRACE(log(),
+        "compressed body from {} to {} bytes",
+        body.size(), evbuffer_get_length(zbuf)
+    );
+    
+    this->headers().set(
+        evmvc::field::content_length,
+        md::num_to_str(evbuffer_get_length(zbuf))
+    );
+    
+    _reply_start();
+    if(bufferevent_write_buffer(c->bev(), zbuf))
+        return this->_reply_end();
+    this->end();
+}
+
+inline void response_t::_send_compressed(evbuffer* body)
+{
+    auto c = this->_conn.lock();
+    if(!c){
+        _release_compressor();
+        evbuffer_drain(body, evbuffer_get_length(body));
+        return this->_reply_end();
+    }
+    
+    size_t len = evbuffer_get_length(body);
+    evbuffer* zbuf = _internal::compression_buffer();
+    try{
+        _compress_buffer(body, zbuf, compress_flush::finish);
+    }catch(...){
+        _abort_compression(zbuf);
+        throw;
+    }
+    _release_compressor();
+    
+    EVMVC_TRACE(log(),
+        "compressed body from {} to {} bytes",
+        len, evbuffer_get_length(zbuf)
+    );
+    
+    this->headers().set(
+        evmvc::field::content_length,
+        md::num_to_str(evbuffer_get_length(zbuf))
+    );
+    
+    _reply_start();
+    if(bufferevent_write_buffer(c->bev(), zbuf))
+        return this->_reply_end();
+    this->end();
+}
+
+inline void response_t::_compress_buffer(
+    evbuffer* src, evbuffer* zbuf, compress_flush last)
+{
+    // each segment is compressed in place, src is drained
+    size_t left = evbuffer_get_length(src);
+    if(left == 0)
+        return _zc->compress(nullptr, 0, zbuf, last);
+    
+    evbuffer_iovec v[8];
+    while(left > 0){
+        int n = std::min(evbuffer_peek(src, -1, nullptr, v, 8), 8);
+        size_t used = 0;
+        for(int i = 0; i < n; ++i){
+            used += v[i].iov_len;
+            left -= v[i].iov_len;
+            _zc->compress(
+                (const char*)v[i].iov_base, v[i].iov_len, zbuf,
+                left == 0 ? last : compress_flush::none
+            );
+        }
+        evbuffer_drain(src, used);
+    }
+}
+
+inline void response_t::_release_compressor()
+{
+    if(!_zc)
+        return;
+    _internal::compressors().release(
+        std::move(_zc),
+        this->get_app()->options().compression.pool_size
+    );
+}
+
+// the error response is sent uncompressed
+inline void response_t::_abort_compression(evbuffer* zbuf)
+{
+    _release_compressor();
+    evbuffer_drain(zbuf, evbuffer_get_length(zbuf));
+    _headers->remove(evmvc::field::content_encoding);
+}
+
+inline void response_t::stream_start()
+{
+    if(_started)
+        throw MD_ERR("Unable to stream, the response is already started!");
+    
+    EVMVC_TRACE(log(), "stream_start");
+    
+    if(_type.empty())
+        this->type("txt", "utf-8");
+    
+    _headers->remove(evmvc::field::content_length);
+    _headers->set(evmvc::field::transfer_encoding, "chunked");
+    
+    // the stream length is unknown, only the type is considered
+    _init_compression(std::numeric_limits<size_t>::max());
+    
+    _reply_start();
+    _streaming = true;
+}
+
+inline void response_t::stream_write(evbuffer* chunk)
+{
+    if(!_streaming)
+        throw MD_ERR("stream_start must be called before stream_write!");
+    
+    if(!_zc)
+        return _send_chunk(chunk);
+    
+    // the last segment is synced so the client can decode everything
+    // sent so far.
+    if(evbuffer_get_length(chunk) == 0)
+        return;
+    evbuffer* zbuf = _internal::compression_buffer();
+    _compress_buffer(chunk, zbuf, compress_flush::sync);
+    _send_chunk(zbuf);
+}
+
+inline void response_t::stream_end()
+{
+    if(!_streaming)
+        return;
+    
+    EVMVC_TRACE(log(), "stream_end");
+    
+    if(_zc){
+        evbuffer* zbuf = _internal::compression_buffer();
+        _zc->compress(nullptr, 0, zbuf, compress_flush::finish);
+        _release_compressor();
+        _send_chunk(zbuf);
+    }
+    
+    _streaming = false;
+    if(auto c = this->_conn.lock()){
+        evbuffer_add(c->bev_out(), "0\r\n\r\n", 5);
+        bufferevent_flush(c->bev(), EV_WRITE, BEV_FLUSH);
+    }
+    this->end();
+}
+
+inline void response_t::stream_abort()
+{
+    if(!_streaming)
+        return;
+    
+    EVMVC_TRACE(log(), "stream_abort");
+    
+    // the status is already sent, closing without the last chunk
+    // lets the client detect the truncated body.
+    _release_compressor();
+    _streaming = false;
+    _ended = true;
+    if(auto c = this->_conn.lock())
+        c->close();
+}
+
+inline void response_t::_send_chunk(evbuffer* chunk)
+{
+    size_t cs = evbuffer_get_length(chunk);
+    if(cs == 0)
+        return;
+    
+    auto c = this->_conn.lock();
+    if(!c){
+        evbuffer_drain(chunk, cs);
+        return;
+    }
+    
+    EVMVC_TRACE(log(), "_send_chunk, size: {}", cs);
+    
+    evbuffer* out = c->bev_out();
+    evbuffer_add_printf(out, "%x\r\n", (unsigned)cs);
+    bufferevent_write_buffer(c->bev(), chunk);
+    evbuffer_add(out, "\r\n", 2);
+    bufferevent_flush(c->bev(), EV_WRITE, BEV_FLUSH);
+}
+
 inline void response_t::_reply_end()
 {
-    EVMVC_TRACE(_log, "_reply_end");
+    EVMVC_TRACE(log(), "_reply_end");
 
     _ended = true;
     auto c = this->_conn.lock();
     if(!c)
-        return _log->error(MD_ERR("Connection closed!"));
-        
+        return log()->error(MD_ERR("Connection closed!"));
+    
+    _record_reply(*c);
     c->complete_response();
 }
 
+// metrics, trace and access record of every reply, file replies included
+inline void response_t::_record_reply(connection& c)
+{
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - c.parser()->started_at()
+    ).count();
+    worker_metrics().add_response(get_status(), us);
+    
+    md::string_view path = _req->uri().path();
+    auto& tr = c.parser()->trace();
+    if(tr.enabled()){
+        tr.end();
+        _internal::tracing().record(
+            tr, c.id(), _id, _req->method(), path, get_status()
+        );
+    }
+    
+    auto w = c.get_worker();
+    if(w && w->access_ring())
+        write_access_record(
+            *w->access_ring(), _id, _req->method(),
+            c.remote_address(), c.remote_port(), path,
+            get_status(), c.parser()->bytes_out(), us
+        );
+}
+
 inline void response_t::send_event(
     md::string_view event, md::string_view data, md::string_view id)
 {
@@ -439,7 +742,7 @@ inline void response_t::send_event(
         this->_event_started = true;
     }
     
-    EVMVC_TRACE(_log, "send_event");
+    EVMVC_TRACE(log(), "send_event");
     if(auto c = this->_conn.lock()){
         if(!event.empty()){
             std::string val = "event: " + event.to_string();
@@ -489,7 +792,7 @@ inline void response_t::send_event_message(md::string_view message)
         this->_event_started = true;
     }
     
-    EVMVC_TRACE(_log, "send_event");
+    EVMVC_TRACE(log(), "send_event");
     if(auto c = this->_conn.lock()){
         if(!message.empty()){
             std::vector<std::string> lines;
@@ -525,7 +828,7 @@ inline void response_t::send_event_comment(md::string_view comment)
         this->_event_started = true;
     }
     
-    EVMVC_TRACE(_log, "send_event");
+    EVMVC_TRACE(log(), "send_event");
     if(auto c = this->_conn.lock()){
         if(!comment.empty()){
             std::vector<std::string> lines;
@@ -553,28 +856,6 @@ inline void response_t::send_file(
     const md::string_view& enc, 
     md::callback::async_cb cb)
 {
-    static std::locale out_loc = std::locale(
-        std::locale::classic(),
-        new boost::posix_time::time_facet(
-            "%a, %d %b %Y %H:%M:%S GMT"
-        )
-    );
-    static std::locale in_loc = std::locale(
-        std::locale::classic(),
-        new boost::posix_time::time_input_facet(
-            "%a, %d %b %Y %H:%M:%S GMT"
-        )
-    );
-    
-    // static boost::posix_time::time_facet* tout_facet =
-    //     new boost::posix_time::time_facet(
-    //         "%a, %d %b %Y %H:%M:%S GMT"
-    //     );
-    // static boost::posix_time::time_input_facet* tin_facet =
-    //     new boost::posix_time::time_input_facet(
-    //         "%a, %d %b %Y %H:%M:%S GMT"
-    //     );
-    
     auto c = this->_conn.lock();
     if(!c){
         if(cb)
@@ -583,7 +864,7 @@ inline void response_t::send_file(
     }
     
     if(filepath.empty()){
-        _log->error(MD_ERR(
+        log()->error(MD_ERR(
             "Filepath is empty!"
         ));
         
@@ -594,7 +875,7 @@ inline void response_t::send_file(
     boost::system::error_code ec;
     if(!bfs::exists(filepath, ec)){
         if(ec){
-            _log->error(MD_ERR(
+            log()->error(MD_ERR(
                 "Unable to verify file '{}' existence!\n{}",
                 filepath.string(), ec.message()
             ));
@@ -606,13 +887,13 @@ inline void response_t::send_file(
         return;
     }
     
-    boost::posix_time::ptime fmtime;
+    int64_t fmtime;
     std::string fetag;
     //size_t fsize;
     {
         struct stat fstat;
         stat(filepath.c_str(), &fstat);
-        fmtime = boost::posix_time::from_time_t(fstat.st_mtime);
+        fmtime = fstat.st_mtime;
         evmvc::get_etag(fstat, fetag);
         //fsize = fstat.st_size;
     }
@@ -624,21 +905,16 @@ inline void response_t::send_file(
         md::trim(retag);
         
         if(_req->headers().exists(evmvc::field::if_modified_since)){
-            boost::posix_time::ptime rmtime;
+            int64_t rmtime;
             
             std::string srmtime = _req->headers().get(
                 evmvc::field::if_modified_since
             )->value();
-            
-            std::stringstream ss;
-            ss.write(srmtime.c_str(), srmtime.size());
-            //ss.imbue(std::locale(std::locale::classic(), tin_facet));
-            ss.imbue(in_loc);
-            ss >> rmtime;
+            md::trim(srmtime);
             
             if(
                 retag == fetag &&
-                !rmtime.is_not_a_date_time() &&
+                parse_http_date(srmtime, rmtime) &&
                 rmtime == fmtime
             ){
                 return this->send_status(evmvc::status::not_modified);
@@ -646,18 +922,15 @@ inline void response_t::send_file(
         }
     }
     
-    std::stringstream ss;
-    //ss.imbue(std::locale(ss.getloc(), tout_facet));
-    ss.imbue(out_loc);
-    ss << fmtime;
-    
-    this->_headers->set(evmvc::field::last_modified, ss.str());
+    this->_headers->set(
+        evmvc::field::last_modified, format_http_date(fmtime)
+    );
     this->_headers->set(evmvc::field::etag, fetag);
     this->_headers->set(evmvc::field::cache_control, "max-age=2592000");
     
     FILE* file_desc = fopen(filepath.c_str(), "r");
     if(!file_desc){
-        _log->error(MD_ERR(
+        log()->error(MD_ERR(
             "fopen failed, errno: {}", errno
         ));
         
@@ -671,58 +944,29 @@ inline void response_t::send_file(
         this->_conn,
         file_desc,
         cb,
-        this->_log
+        this->log()
     );
     
     // set file content-type
     auto mime_type = evmvc::mime::get_type(filepath.extension().c_str());
     if(evmvc::mime::compressible(mime_type)){
-        EVMVC_DBG(this->_log, "file is compressible");
+        EVMVC_DBG(this->log(), "file is compressible");
         
+        this->headers().set(evmvc::field::vary, "Accept-Encoding", false);
         shared_header hdr = _req->headers().get(
             evmvc::field::accept_encoding
         );
         
         if(hdr){
-            auto encs = hdr->accept_encodings();
-            int wsize = EVMVC_COMPRESSION_NOT_SUPPORTED;
-            if(encs.size() == 0)
-                wsize = EVMVC_ZLIB_GZIP_WSIZE;
-            for(const auto& cenc : encs){
-                if(cenc.type == encoding_type::gzip){
-                    wsize = EVMVC_ZLIB_GZIP_WSIZE;
-                    break;
-                }
-                if(cenc.type == encoding_type::deflate){
-                    wsize = EVMVC_ZLIB_DEFLATE_WSIZE;
-                    break;
-                }
-                if(cenc.type == encoding_type::star){
-                    wsize = EVMVC_ZLIB_GZIP_WSIZE;
-                    break;
-                }
-            }
-            
-            if(wsize != EVMVC_COMPRESSION_NOT_SUPPORTED){
-                reply->zs = (z_stream*)malloc(sizeof(*reply->zs));
-                memset(reply->zs, 0, sizeof(*reply->zs));
-                
-                int compression_level = Z_DEFAULT_COMPRESSION;
-                if(deflateInit2(
-                    reply->zs,
-                    compression_level,
-                    Z_DEFLATED,
-                    wsize, //MOD_GZIP_ZLIB_WINDOWSIZE + 16,
-                    EVMVC_ZLIB_MEM_LEVEL,// MOD_GZIP_ZLIB_CFACTOR,
-                    EVMVC_ZLIB_STRATEGY// Z_DEFAULT_STRATEGY
-                    ) != Z_OK
-                ){
-                    throw MD_ERR("deflateInit2 failed!");
-                }
+            encoding_type enc = negotiate_encoding(hdr->accept_encodings());
+            if(enc != encoding_type::unsupported){
+                const auto& copts = this->get_app()->options().compression;
+                reply->zc = _internal::compressors().acquire(enc, copts);
+                reply->zc_flush = copts.file_flush;
+                reply->zc_pool_size = copts.pool_size;
                 
                 this->headers().set(
-                    evmvc::field::content_encoding, 
-                    wsize == EVMVC_ZLIB_GZIP_WSIZE ? "gzip" : "deflate"
+                    evmvc::field::content_encoding, to_string(enc)
                 );
             }
         }
@@ -737,19 +981,69 @@ inline void response_t::send_file(
     c->send_file(reply);
 }
 
+inline void response_t::offload(
+    std::function<void()> fn, md::callback::async_cb cb)
+{
+    auto self = this->shared_from_this();
+    this->pause();
+    evmvc::offload(fn, [self, cb](const md::callback::cb_error& err){
+        self->resume([cb, err](const md::callback::cb_error& rerr){
+            cb(rerr ? rerr : err);
+        });
+    });
+}
+
+template<typename T>
+inline void response_t::offload(
+    std::function<T()> fn, md::callback::value_cb<T> cb)
+{
+    auto self = this->shared_from_this();
+    this->pause();
+    evmvc::offload<T>(fn,
+    [self, cb](const md::callback::cb_error& err, T val){
+        auto v = std::make_shared<T>(std::move(val));
+        self->resume([cb, err, v](const md::callback::cb_error& rerr){
+            cb(rerr ? rerr : err, std::move(*v));
+        });
+    });
+}
+
 inline void response_t::render(
     const std::string& view_path, md::callback::async_cb cb)
 {
     auto self = this->shared_from_this();
     
+    // streaming requires chunked encoding and the whole html output
+    bool stream = false;
+    if(this->get_app()->options().views.stream &&
+        !view_engine::has_html_parser()
+    ){
+        auto c = _conn.lock();
+        stream = c && c->parser()->http_ver() != http_version::http_10;
+    }
+    if(stream)
+        this->encoding("utf-8").type("html");
+    
+    if(auto c = _conn.lock())
+        c->parser()->trace().mark(trace_mark::render_start);
+    callback_scope scope(callback_kind::view, view_path);
+    
+    // the view replies itself, its output is never joined. The engines
+    // ignoring the requested output return it buffered instead.
     view_engine::render(
     this->shared_from_this(), view_path,
-    [self, cb](md::callback::cb_error err, std::string data){
-        if(err)
-            return cb(err);
-        self->html(data);
-        cb(nullptr);
-    });
+    [self, cb](md::callback::cb_error err, const std::string& data){
+        if(auto c = self->_conn.lock())
+            c->parser()->trace().mark(trace_mark::render_end);
+        if(self->_streaming){
+            if(err)
+                self->stream_abort();
+            else
+                self->stream_end();
+        }else if(!err && !self->_started)
+            self->html(data);
+        cb(err);
+    }, stream ? view_output::stream : view_output::reply);
 }
 
 template<>
@@ -774,6 +1068,18 @@ inline std::string response_t::get_data<std::string>(md::string_view name)
     return it->second->to_string();
 }
 
+/**
+ * Route handler sending the metrics of the workers,
+ * e.g. app->get("/metrics", evmvc::metrics_handler).
+ */
+inline void metrics_handler(
+    const evmvc::request /*req*/, evmvc::response res,
+    md::callback::async_cb cb)
+{
+    res->headers().set(evmvc::field::cache_control, "no-store");
+    res->encoding("utf-8").type("txt").send(evmvc::metrics_text());
+    cb(nullptr);
+}
 
 
 }//::evmvc
@@ -30,6 +30,7 @@ SOFTWARE.
 #include "filter_policies.h"
 #include "request.h"
 #include "response.h"
+#include "trace.h"
 //#include "multipart_parser.h"
 
 namespace evmvc {
@@ -73,7 +74,7 @@ public:
     );
     
     route _route;
-    std::vector<std::shared_ptr<evmvc::http_param>> params;
+    evmvc::http_params_t params;
 };
 
 class route_t
@@ -93,14 +94,14 @@ class route_t
 
 protected:
     route_t(std::weak_ptr<router_t> rtr)
-        : _rtr(rtr), _log(), _rp(""), _re(nullptr)
+        : _rtr(rtr), _log(), _rp(""), _trace(-1), _re(nullptr)
     {
         EVMVC_DEF_TRACE("route {:p} created", (void*)this);
     }
     
 public:
     route_t(std::weak_ptr<router_t> rtr, md::string_view route_path)
-        : _rtr(rtr), _log(), _rp(route_path), _re(nullptr)
+        : _rtr(rtr), _log(), _rp(route_path), _trace(-1), _re(nullptr)
     {
         EVMVC_DEF_TRACE("route {:p} created", (void*)this);
         this->_build_route_re(route_path);
@@ -121,10 +122,29 @@ public:
     
     evmvc::router get_router() const { return _rtr.lock();}
     md::log::logger log() const;
+    md::string_view path() const { return _rp;}
     
     bool has_callbacks() const { return !_handlers.empty();}
     bool has_policies() const { return !_policies.empty();}
     
+    // overrides tracing_options::enabled for this route
+    route trace(bool enabled)
+    {
+        if(enabled != (_trace == 1)){
+            if(enabled)
+                _internal::tracing().add_route();
+            else if(_trace == 1)
+                _internal::tracing().remove_route();
+        }
+        _trace = enabled ? 1 : 0;
+        return this->shared_from_this();
+    }
+    bool traced() const
+    {
+        return _trace == -1 ?
+            _internal::tracing().options().enabled : _trace == 1;
+    }
+    
     route register_policy(policies::filter_policy pol)
     {
         _policies.emplace_back(pol);
@@ -202,12 +222,8 @@ public:
                 ovector[2*n+1] - ovector[2*n]
             );
             if(!pval.empty()){
-                char* dp = evhttp_uridecode(pval.c_str(), false, nullptr);
-                rr->params.emplace_back(
-                    std::make_shared<evmvc::http_param>(pname, std::string(dp))
-                );
-                
-                free(dp);
+                pval.resize(evmvc::uri_decode_inplace(&pval[0], pval.size()));
+                rr->params.emplace_back(pname, pval);
             }
             
             tabptr += name_entry_size;
@@ -412,6 +428,8 @@ protected:
     std::weak_ptr<router_t> _rtr;
     mutable md::log::logger _log;
     std::string _rp;
+    // -1 follows tracing_options::enabled
+    int8_t _trace;
     
     std::vector<std::string> _param_names;
     std::vector<route_handler_cb> _handlers;
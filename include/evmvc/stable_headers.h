@@ -55,6 +55,12 @@ SOFTWARE.
 #include <vector>
 #include <initializer_list>
 #include <pthread.h>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "fmt/format.h"
 
@@ -248,6 +254,7 @@ namespace multip{
 namespace _internal{
     md::log::logger& default_logger();
     
+    md::log::logger request_logger(const wp_connection& conn, const route& rt);
     evmvc::response create_http_response(
         wp_connection conn,
         http_version ver,
@@ -322,6 +329,9 @@ namespace _internal{
 #define EVMVC_ZLIB_MEM_LEVEL 8
 #define EVMVC_ZLIB_STRATEGY Z_DEFAULT_STRATEGY
 
+// output space reserved per compression pass
+#define EVMVC_COMPRESSION_CHUNK_SIZE 16384
+
 #define EVMVC_PCRE_DATE EVMVC_STRING(PCRE_DATE)
 
 
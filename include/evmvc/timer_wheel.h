@@ -0,0 +1,337 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_timer_wheel_h
+#define _libevmvc_timer_wheel_h
+
+#include "stable_headers.h"
+#include "global.h"
+
+#ifndef EVMVC_TIMER_WHEEL_TICK_MS
+    #define EVMVC_TIMER_WHEEL_TICK_MS 1
+#endif
+
+#define EVMVC_TIMER_WHEEL_BITS 6
+#define EVMVC_TIMER_WHEEL_SLOTS (1 << EVMVC_TIMER_WHEEL_BITS)
+#define EVMVC_TIMER_WHEEL_MASK (EVMVC_TIMER_WHEEL_SLOTS -1)
+#define EVMVC_TIMER_WHEEL_LEVELS 4
+
+namespace evmvc {
+
+class timer_wheel;
+
+namespace _internal {
+struct timer_link
+{
+    timer_link* prev = nullptr;
+    timer_link* next = nullptr;
+};
+}//::_internal
+
+/*
+    timer armed on the timer wheel of the process,
+    arming, re-arming and canceling are O(1).
+*/
+class wheel_timer
+    : private _internal::timer_link
+{
+    friend class timer_wheel;
+
+public:
+    typedef void (*callback)(wheel_timer* t, void* arg);
+
+    wheel_timer(callback cb = nullptr, void* arg = nullptr)
+        : _expires(0), _cb(cb), _arg(arg)
+    {
+    }
+
+    ~wheel_timer()
+    {
+        cancel();
+    }
+
+    wheel_timer(const wheel_timer&) = delete;
+    wheel_timer& operator=(const wheel_timer&) = delete;
+
+    void set_callback(callback cb, void* arg)
+    {
+        _cb = cb;
+        _arg = arg;
+    }
+
+    bool armed() const { return next != nullptr;}
+
+    // fires once in ms milliseconds, re-arming replaces the previous delay
+    void arm(uint64_t ms);
+    void cancel();
+
+private:
+    uint64_t _expires;
+    callback _cb;
+    void* _arg;
+};
+
+/*
+    hierarchical hashed timer wheel driven by a single libevent timer,
+    four levels of 64 slots cover 2^24 ticks, longer delays are
+    cascaded again until they expire.
+*/
+class timer_wheel
+{
+    typedef _internal::timer_link link;
+
+public:
+    timer_wheel()
+        : _base(nullptr), _ev(nullptr), _now(0), _count(0),
+        _wake(UINT64_MAX), _running(false)
+    {
+        for(auto& level : _slots)
+            for(auto& s : level)
+                s.prev = s.next = &s;
+    }
+
+    size_t size() const { return _count;}
+
+    static uint64_t clock_tick()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count() / EVMVC_TIMER_WHEEL_TICK_MS;
+    }
+
+    // cur is the current tick
+    void add(wheel_timer* t, uint64_t ms, uint64_t cur = clock_tick())
+    {
+        _bind();
+        if(t->armed())
+            _unlink(t);
+        else if(_count++ == 0 && _now < cur)
+            // nothing was pending, the wheel jumps to the current tick
+            _now = cur;
+
+        t->_expires = cur +
+            (ms + EVMVC_TIMER_WHEEL_TICK_MS -1) / EVMVC_TIMER_WHEEL_TICK_MS;
+        _insert(t);
+
+        if(!_running && std::max(t->_expires, _now) < _wake)
+            _schedule(cur);
+    }
+
+    void remove(wheel_timer* t)
+    {
+        if(!t->armed())
+            return;
+        _unlink(t);
+        --_count;
+    }
+
+    // fires the timers expired at the cur tick
+    void run(uint64_t cur = clock_tick())
+    {
+        _running = true;
+        while(_now <= cur && _count > 0)
+            _tick();
+        if(_count == 0)
+            _now = cur +1;
+        _running = false;
+        _schedule(cur);
+    }
+
+private:
+    void _bind()
+    {
+        event_base* b = global::ev_base();
+        if(b == _base)
+            return;
+
+        // a forked worker drops the timers of the master, the event
+        // belongs to the master loop and is never released here
+        if(_base)
+            _drop();
+        _base = b;
+        _ev = event_new(b, -1, 0, timer_wheel::_on_tick, this);
+        _wake = UINT64_MAX;
+    }
+
+    void _drop()
+    {
+        for(auto& level : _slots)
+            for(auto& s : level){
+                while(s.next != &s){
+                    link* l = s.next;
+                    _unlink(l);
+                }
+            }
+        _count = 0;
+    }
+
+    static void _unlink(link* l)
+    {
+        l->prev->next = l->next;
+        l->next->prev = l->prev;
+        l->prev = l->next = nullptr;
+    }
+
+    static void _push(link& head, link* l)
+    {
+        l->prev = head.prev;
+        l->next = &head;
+        head.prev->next = l;
+        head.prev = l;
+    }
+
+    void _insert(wheel_timer* t)
+    {
+        uint64_t e = std::max(t->_expires, _now);
+        uint64_t d = e - _now;
+
+        size_t l = 0;
+        while(l < EVMVC_TIMER_WHEEL_LEVELS -1 &&
+            d >= (1ull << (EVMVC_TIMER_WHEEL_BITS * (l +1)))
+        )
+            ++l;
+        if(d >= (1ull << (EVMVC_TIMER_WHEEL_BITS * EVMVC_TIMER_WHEEL_LEVELS)))
+            e = _now +
+                (1ull << (EVMVC_TIMER_WHEEL_BITS * EVMVC_TIMER_WHEEL_LEVELS))
+                -1;
+
+        _push(
+            _slots[l][(e >> (EVMVC_TIMER_WHEEL_BITS * l)) &
+                EVMVC_TIMER_WHEEL_MASK],
+            t
+        );
+    }
+
+    // moves the timers of an upper slot to the lower levels
+    size_t _cascade(size_t level)
+    {
+        size_t idx = (_now >> (EVMVC_TIMER_WHEEL_BITS * level)) &
+            EVMVC_TIMER_WHEEL_MASK;
+        link& s = _slots[level][idx];
+        while(s.next != &s){
+            wheel_timer* t = static_cast<wheel_timer*>(s.next);
+            _unlink(t);
+            _insert(t);
+        }
+        return idx;
+    }
+
+    void _tick()
+    {
+        size_t idx = _now & EVMVC_TIMER_WHEEL_MASK;
+        if(idx == 0)
+            for(size_t l = 1; l < EVMVC_TIMER_WHEEL_LEVELS; ++l)
+                if(_cascade(l) != 0)
+                    break;
+
+        link& s = _slots[0][idx];
+        if(s.next == &s){
+            ++_now;
+            return;
+        }
+
+        link expired;
+        expired.prev = s.prev;
+        expired.next = s.next;
+        expired.prev->next = expired.next->prev = &expired;
+        s.prev = s.next = &s;
+        ++_now;
+
+        // the callbacks may re-arm or cancel any timer
+        while(expired.next != &expired){
+            wheel_timer* t = static_cast<wheel_timer*>(expired.next);
+            _unlink(t);
+            // a delay longer than the wheel was clamped, not expired yet
+            if(t->_expires >= _now){
+                _insert(t);
+                continue;
+            }
+            --_count;
+            if(t->_cb)
+                t->_cb(t, t->_arg);
+        }
+    }
+
+    // wakes up on the next non empty slot or the next cascade
+    void _schedule(uint64_t cur)
+    {
+        if(!_ev)
+            return;
+        if(_count == 0){
+            event_del(_ev);
+            _wake = UINT64_MAX;
+            return;
+        }
+
+        uint64_t wake = _now;
+        for(size_t i = 0; i < EVMVC_TIMER_WHEEL_SLOTS; ++i, ++wake){
+            if(i > 0 && (wake & EVMVC_TIMER_WHEEL_MASK) == 0)
+                break;
+            link& s = _slots[0][wake & EVMVC_TIMER_WHEEL_MASK];
+            if(s.next != &s)
+                break;
+        }
+
+        _wake = wake;
+        uint64_t ms = wake > cur ? (wake - cur) * EVMVC_TIMER_WHEEL_TICK_MS : 0;
+        timeval tv = md::date::ms_to_timeval(ms);
+        event_add(_ev, &tv);
+    }
+
+    static void _on_tick(int /*fd*/, short /*events*/, void* arg)
+    {
+        ((timer_wheel*)arg)->run();
+    }
+
+    event_base* _base;
+    event* _ev;
+    uint64_t _now;
+    size_t _count;
+    uint64_t _wake;
+    bool _running;
+    link _slots[EVMVC_TIMER_WHEEL_LEVELS][EVMVC_TIMER_WHEEL_SLOTS];
+};
+
+namespace _internal {
+// never released, the event base may be freed first
+inline timer_wheel& timers()
+{
+    static timer_wheel* tw = new timer_wheel();
+    return *tw;
+}
+}//::_internal
+
+inline void wheel_timer::arm(uint64_t ms)
+{
+    _internal::timers().add(this, ms);
+}
+
+inline void wheel_timer::cancel()
+{
+    if(armed())
+        _internal::timers().remove(this);
+}
+
+}//::evmvc
+#endif //_libevmvc_timer_wheel_h
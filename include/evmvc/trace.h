@@ -0,0 +1,359 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_trace_h
+#define _libevmvc_trace_h
+
+#include "stable_headers.h"
+#include "global.h"
+#include "configuration.h"
+#include "methods.h"
+#include "metrics.h"
+
+#include <fcntl.h>
+
+namespace evmvc {
+
+// points of a request, the phases are measured between two marks
+enum class trace_mark
+{
+    // request line received
+    start,
+    headers,
+    route,
+    // filter policies validated
+    policies,
+    // first route handler called
+    handler,
+    render_start,
+    render_end,
+    // status line and headers queued
+    first_byte,
+    // response ended
+    last_byte
+};
+#define EVMVC_TRACE_MARKS 9
+
+namespace _internal {
+struct trace_bounds
+{
+    trace_mark from;
+    trace_mark to;
+};
+
+inline const trace_bounds& phase_bounds(trace_phase p)
+{
+    static const trace_bounds bounds[EVMVC_TRACE_PHASES] = {
+        {trace_mark::start, trace_mark::headers},
+        {trace_mark::headers, trace_mark::route},
+        {trace_mark::route, trace_mark::policies},
+        {trace_mark::handler, trace_mark::last_byte},
+        {trace_mark::render_start, trace_mark::render_end}
+    };
+    return bounds[(size_t)p];
+}
+}//::_internal
+
+/*
+    steady clock timestamps of the current request of a parser,
+    the marks of the requests that are not traced are skipped.
+*/
+class request_trace
+{
+public:
+    typedef std::chrono::steady_clock clock;
+    
+    request_trace()
+    {
+        clear();
+    }
+    
+    bool enabled() const { return _enabled;}
+    void enable(bool val) { _enabled = val;}
+    
+    void clear()
+    {
+        _enabled = false;
+        for(auto& m : _marks)
+            m = 0;
+    }
+    
+    // starts a new request at the time of its request line
+    void begin(clock::time_point start, bool enabled)
+    {
+        clear();
+        _enabled = enabled;
+        if(enabled)
+            _marks[(size_t)trace_mark::start] = _ns(start);
+    }
+    
+    void mark(trace_mark m)
+    {
+        if(_enabled)
+            _marks[(size_t)m] = _ns(clock::now());
+    }
+    
+    // the views reply before their callback, a render in progress
+    // ends with the response
+    void end()
+    {
+        if(!_enabled)
+            return;
+        mark(trace_mark::last_byte);
+        if(at(trace_mark::render_start) > at(trace_mark::render_end))
+            _marks[(size_t)trace_mark::render_end] =
+                at(trace_mark::last_byte);
+    }
+    
+    // ns of the steady clock, 0 when the mark is missing
+    int64_t at(trace_mark m) const { return _marks[(size_t)m];}
+    
+    // -1 when one of the marks is missing
+    int64_t elapsed_us(trace_mark from, trace_mark to) const
+    {
+        int64_t f = at(from);
+        int64_t t = at(to);
+        if(f == 0 || t == 0 || t < f)
+            return -1;
+        return (t - f) / 1000;
+    }
+    
+    int64_t phase_us(trace_phase p) const
+    {
+        auto& b = _internal::phase_bounds(p);
+        return elapsed_us(b.from, b.to);
+    }
+    
+    /**
+     * Server-Timing value of the completed phases in ms,
+     * total is the time until the first byte.
+     */
+    std::string server_timing() const
+    {
+        std::string st;
+        auto add = [&st](md::string_view name, int64_t us){
+            if(us < 0)
+                return;
+            if(!st.empty())
+                st += ", ";
+            st += fmt::format("{};dur={:.3f}", name, us / 1000.0);
+        };
+        
+        for(size_t p = 0; p < EVMVC_TRACE_PHASES; ++p)
+            add(to_string((trace_phase)p), phase_us((trace_phase)p));
+        add("total", elapsed_us(trace_mark::start, trace_mark::first_byte));
+        return st;
+    }
+
+private:
+    static int64_t _ns(clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            t.time_since_epoch()
+        ).count();
+    }
+    
+    bool _enabled;
+    int64_t _marks[EVMVC_TRACE_MARKS];
+};
+
+/*
+    tracing state of the process, the phases of the traced requests
+    are recorded in the worker metrics and one request out of
+    sample_rate is appended to the trace file of the worker.
+*/
+class tracer
+{
+public:
+    tracer()
+        : _routes(0), _sampled(0), _pid(-1), _fd(-1),
+        _buf(nullptr), _timer(nullptr)
+    {
+    }
+    
+    // the timer belongs to the loop of the worker, already released
+    ~tracer()
+    {
+        if(_pid != getpid())
+            return;
+        flush();
+        if(_fd != -1)
+            ::close(_fd);
+        evbuffer_free(_buf);
+    }
+    
+    tracer(const tracer&) = delete;
+    tracer& operator=(const tracer&) = delete;
+    
+    // called by the master before forking the workers
+    void configure(const tracing_options& opts, const bfs::path& log_dir)
+    {
+        _opts = opts;
+        _filename = opts.filename.empty() ?
+            log_dir / "trace.json" : opts.filename;
+    }
+    
+    const tracing_options& options() const { return _opts;}
+    
+    // false when no route can be traced
+    bool active() const { return _opts.enabled || _routes > 0;}
+    void add_route() { ++_routes;}
+    void remove_route() { --_routes;}
+    
+    void record(
+        const request_trace& tr, uint64_t tid, uint64_t id,
+        evmvc::method met, md::string_view path, int status)
+    {
+        if(_opts.metrics)
+            for(size_t p = 0; p < EVMVC_TRACE_PHASES; ++p){
+                int64_t us = tr.phase_us((trace_phase)p);
+                if(us >= 0)
+                    worker_metrics().phases[p].record(us);
+            }
+        
+        if(_opts.sample_rate == 0 || _sampled++ % _opts.sample_rate != 0)
+            return;
+        if(_pid != getpid())
+            _open();
+        if(_fd == -1)
+            return;
+        
+        chrome_events(_buf, tr, _pid, tid, id, met, path, status);
+        if(evbuffer_get_length(_buf) >= _opts.flush_size)
+            flush();
+    }
+    
+    void flush()
+    {
+        if(_fd == -1)
+            return;
+        while(evbuffer_get_length(_buf) > 0)
+            if(evbuffer_write(_buf, _fd) < 0 && errno != EINTR){
+                evbuffer_drain(_buf, evbuffer_get_length(_buf));
+                return;
+            }
+    }
+    
+    /**
+     * Appends the request and its phases as chrome trace complete
+     * events, the requests of a connection share the same tid.
+     */
+    static void chrome_events(
+        evbuffer* b, const request_trace& tr, pid_t pid, uint64_t tid,
+        uint64_t id, evmvc::method met, md::string_view path, int status)
+    {
+        int64_t start = tr.at(trace_mark::start);
+        int64_t total = tr.elapsed_us(trace_mark::start, trace_mark::last_byte);
+        if(start == 0 || total < 0)
+            return;
+        
+        auto met_str = to_string(met);
+        evbuffer_add_printf(b,
+            "{\"name\":\"%.*s ",
+            (int)met_str.size(), met_str.data()
+        );
+        json_escape_to(path, [b](const char* d, size_t l){
+            evbuffer_add(b, d, l);
+        });
+        evbuffer_add_printf(b,
+            "\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%.3f,"
+            "\"dur\":%" PRId64 ",\"pid\":%d,\"tid\":%" PRIu64 ","
+            "\"args\":{\"id\":%" PRIu64 ",\"status\":%d}},\n",
+            start / 1000.0, total, (int)pid, tid, id, status
+        );
+        
+        for(size_t p = 0; p < EVMVC_TRACE_PHASES; ++p){
+            int64_t us = tr.phase_us((trace_phase)p);
+            if(us < 0)
+                continue;
+            auto name = to_string((trace_phase)p);
+            evbuffer_add_printf(b,
+                "{\"name\":\"%.*s\",\"cat\":\"phase\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%" PRId64 ",\"pid\":%d,"
+                "\"tid\":%" PRIu64 "},\n",
+                (int)name.size(), name.data(),
+                tr.at(_internal::phase_bounds((trace_phase)p).from) / 1000.0,
+                us, (int)pid, tid
+            );
+        }
+    }
+
+private:
+    // each worker writes its own file, trace-{pid}.json
+    void _open()
+    {
+        _pid = getpid();
+        if(!_buf)
+            _buf = evbuffer_new();
+        evbuffer_drain(_buf, evbuffer_get_length(_buf));
+        
+        std::string fn = (
+            _filename.parent_path() / (
+                _filename.stem().string() + "-" +
+                md::num_to_str(_pid, false) +
+                _filename.extension().string()
+            )
+        ).string();
+        _fd = ::open(
+            fn.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640
+        );
+        if(_fd == -1)
+            return;
+        
+        // the closing bracket is optional in the chrome trace format
+        evbuffer_add(_buf, "[\n", 2);
+        if(_opts.flush_ms > 0){
+            _timer = event_new(
+                global::ev_base(), -1, EV_PERSIST, tracer::_on_timer, this
+            );
+            timeval tv = md::date::ms_to_timeval(_opts.flush_ms);
+            event_add(_timer, &tv);
+        }
+    }
+    
+    static void _on_timer(int /*fd*/, short /*events*/, void* arg)
+    {
+        ((tracer*)arg)->flush();
+    }
+    
+    tracing_options _opts;
+    bfs::path _filename;
+    size_t _routes;
+    size_t _sampled;
+    pid_t _pid;
+    int _fd;
+    evbuffer* _buf;
+    event* _timer;
+};
+
+namespace _internal {
+inline tracer& tracing()
+{
+    static tracer _tracer;
+    return _tracer;
+}
+}//::_internal
+
+}//::evmvc
+#endif //_libevmvc_trace_h
@@ -223,7 +223,7 @@ public:
     uint16_t port() const { return _port;}
     std::string port_string() const { return _port_string;}
     
-    std::string path() const { return _path;}
+    const std::string& path() const { return _path;}
     std::string query() const { return _query;}
     std::string fragment() const { return _fragment;}
     
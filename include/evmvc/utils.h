@@ -216,6 +216,149 @@ inline ssize_t find_eol(const char* data, size_t len, size_t start_pos)
     return -1;
 }
 
+namespace _internal {
+inline int hex_to_int(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// returns the length of the run without any of '&', '=', '+' or '%'
+inline size_t urlenc_plain_run(const char* data, size_t len)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i eq = _mm_set1_epi8('=');
+    const __m128i plus = _mm_set1_epi8('+');
+    const __m128i pct = _mm_set1_epi8('%');
+    for(; i + 16 <= len; i += 16){
+        __m128i b = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(b, amp), _mm_cmpeq_epi8(b, eq)),
+            _mm_or_si128(_mm_cmpeq_epi8(b, plus), _mm_cmpeq_epi8(b, pct))
+        );
+        int mask = _mm_movemask_epi8(m);
+        if(mask)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+    for(; i < len; ++i)
+        switch(data[i]){
+            case '&': case '=': case '+': case '%':
+                return i;
+        }
+    return len;
+}
+}//::_internal
+
+/*
+    in place '%XX' decoding, returns the decoded length.
+*/
+inline size_t uri_decode_inplace(char* data, size_t len)
+{
+    size_t w = 0;
+    for(size_t r = 0; r < len; ++r){
+        if(data[r] == '%' && r + 2 < len){
+            int h = _internal::hex_to_int(data[r+1]);
+            int l = h > -1 ? _internal::hex_to_int(data[r+2]) : -1;
+            if(l > -1){
+                data[w++] = (char)((h << 4) | l);
+                r += 2;
+                continue;
+            }
+        }
+        data[w++] = data[r];
+    }
+    return w;
+}
+
+/*
+    single pass, in place, application/x-www-form-urlencoded decoder.
+    '+' and '%XX' are decoded into data and cb(name, value) is called
+    for every pair with views pointing into data.
+    once it returns, names and values are null terminated,
+    data[len] must be writable.
+*/
+template<typename PAIR_CB>
+inline void parse_urlencoded(char* data, size_t len, PAIR_CB cb)
+{
+    size_t r = 0;
+    size_t w = 0;
+    size_t ks = 0;
+    ssize_t vs = -1;
+    
+    while(r < len){
+        size_t run = _internal::urlenc_plain_run(data + r, len - r);
+        if(run > 0){
+            if(w != r)
+                memmove(data + w, data + r, run);
+            w += run;
+            r += run;
+            if(r >= len)
+                break;
+        }
+        
+        switch(data[r]){
+            case '+':
+                data[w++] = ' ';
+                ++r;
+                break;
+            case '%':{
+                int h = r + 2 < len ? _internal::hex_to_int(data[r+1]) : -1;
+                int l = h > -1 ? _internal::hex_to_int(data[r+2]) : -1;
+                if(l > -1){
+                    data[w++] = (char)((h << 4) | l);
+                    r += 3;
+                }else
+                    data[w++] = data[r++];
+                break;
+            }
+            case '=':
+                if(vs == -1){
+                    data[w++] = '\0';
+                    vs = (ssize_t)w;
+                }else
+                    data[w++] = '=';
+                ++r;
+                break;
+            case '&':
+                if(vs > -1)
+                    cb(
+                        md::string_view(data + ks, vs - ks - 1),
+                        md::string_view(data + vs, w - vs)
+                    );
+                else if(w > ks)
+                    cb(
+                        md::string_view(data + ks, w - ks),
+                        md::string_view(data + w, 0)
+                    );
+                data[w++] = '\0';
+                ks = w;
+                vs = -1;
+                ++r;
+                break;
+        }
+    }
+    
+    data[w] = '\0';
+    if(vs > -1)
+        cb(
+            md::string_view(data + ks, vs - ks - 1),
+            md::string_view(data + vs, w - vs)
+        );
+    else if(w > ks)
+        cb(
+            md::string_view(data + ks, w - ks),
+            md::string_view(data + w, 0)
+        );
+}
+
 inline std::string escape(md::string_view s)
 {
     char* r = evhttp_encode_uri(s.data());
@@ -230,13 +373,106 @@ inline std::string unescape(md::string_view s)
     free(r);
     return tmp;
 }
+namespace _internal {
+// returns the length of the run without any of '&', '<', '>', '"' or '\''
+inline size_t html_plain_run(const char* data, size_t len)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i dq = _mm_set1_epi8('"');
+    const __m128i sq = _mm_set1_epi8('\'');
+    for(; i + 16 <= len; i += 16){
+        __m128i b = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(b, amp), _mm_cmpeq_epi8(b, lt)),
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(b, gt), _mm_cmpeq_epi8(b, dq)),
+                _mm_cmpeq_epi8(b, sq)
+            )
+        );
+        int mask = _mm_movemask_epi8(m);
+        if(mask)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+    for(; i < len; ++i)
+        switch(data[i]){
+            case '&': case '<': case '>': case '"': case '\'':
+                return i;
+        }
+    return len;
+}
+}//::_internal
+
+/*
+    escapes s in a single pass, sink(const char* data, size_t len)
+    receives the plain runs and the entities in order.
+*/
+template<typename SINK>
+inline void html_escape_to(md::string_view s, SINK&& sink)
+{
+    const char* d = s.data();
+    size_t len = s.size();
+    size_t i = 0;
+    while(i < len){
+        size_t run = _internal::html_plain_run(d + i, len - i);
+        if(run > 0){
+            sink(d + i, run);
+            i += run;
+            if(i >= len)
+                break;
+        }
+        
+        switch(d[i++]){
+            case '&': sink("&amp;", 5); break;
+            case '<': sink("&lt;", 4); break;
+            case '>': sink("&gt;", 4); break;
+            case '"': sink("&quot;", 6); break;
+            default: sink("&#039;", 6); break;
+        }
+    }
+}
+
 inline std::string html_escape(md::string_view s)
 {
-    char* r = evhttp_htmlescape(s.data());
-    std::string tmp(r);
-    free(r);
-    return tmp;
+    std::string r;
+    r.reserve(s.size());
+    html_escape_to(s, [&r](const char* d, size_t l){ r.append(d, l);});
+    return r;
 }
+/*
+    escapes s as the content of a json string,
+    the control chars are written as \u00XX.
+*/
+template<typename SINK>
+inline void json_escape_to(md::string_view s, SINK&& sink)
+{
+    static const char* hex = "0123456789abcdef";
+    const char* d = s.data();
+    size_t start = 0;
+    for(size_t i = 0; i < s.size(); ++i){
+        unsigned char c = d[i];
+        if(c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        if(i > start)
+            sink(d + start, i - start);
+        start = i +1;
+        
+        if(c == '"' || c == '\\'){
+            char e[2] = {'\\', (char)c};
+            sink(e, 2);
+        }else{
+            char e[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            sink(e, 6);
+        }
+    }
+    if(s.size() > start)
+        sink(d + start, s.size() - start);
+}
+
 inline std::string html_unescape(md::string_view s)
 {
     static std::unordered_map<std::string, std::string> html_entities = {
@@ -27,22 +27,215 @@ SOFTWARE.
 
 #include "stable_headers.h"
 #include "response.h"
+#include "fragment_cache.h"
 
 #include <stack>
 
-#define EVMVC_VIEW_BASE_ADD_TYPE(T, w_data, wr_data) \
+// smaller buffers are copied to the views output instead of referenced
+#ifndef EVMVC_VIEW_OUT_REF_MIN_SIZE
+    #define EVMVC_VIEW_OUT_REF_MIN_SIZE 512
+#endif
+
+#define EVMVC_VIEW_BASE_ADD_TYPE(T) \
     void write_enc(T data) \
     { \
-        _append_buffer(w_data); \
+        _append_escaped(data); \
     } \
     void write_raw(T data) \
     { \
-        _append_buffer(wr_data); \
+        _append_buffer(data); \
     } \
 
 
 namespace evmvc {
 
+namespace _internal {
+// numbers written by the views, char and bool are excluded
+template<typename T>
+struct is_view_number
+    : std::integral_constant<bool,
+        std::is_arithmetic<T>::value &&
+        !std::is_same<bool, T>::value &&
+        !std::is_same<char, T>::value &&
+        !std::is_same<signed char, T>::value &&
+        !std::is_same<unsigned char, T>::value
+    >
+{
+};
+
+// output of a partial rendered concurrently with its view
+struct partial_slot
+{
+    partial_slot(): done(false), async(false) {}
+    
+    std::string data;
+    md::callback::cb_error err;
+    bool done;
+    bool async;
+};
+
+// offset of a partial still rendering in its buffer, section or fragment
+struct partial_ref
+{
+    size_t offset;
+    size_t idx;
+};
+typedef std::vector<partial_ref> partial_refs;
+
+// inserts the partials output at their offsets, sorted in ascending order
+inline void stitch_partials(
+    std::string& src, const partial_refs& refs,
+    const std::vector<partial_slot>& slots)
+{
+    if(refs.empty())
+        return;
+    
+    size_t len = src.size();
+    for(auto& r : refs)
+        len += slots[r.idx].data.size();
+    
+    std::string out;
+    out.reserve(len);
+    size_t beg = 0;
+    for(auto& r : refs){
+        out.append(src, beg, r.offset - beg);
+        out += slots[r.idx].data;
+        beg = r.offset;
+    }
+    out.append(src, beg, std::string::npos);
+    src.swap(out);
+}
+
+// appends src to dst, the offsets of src_refs are moved along
+inline void append_partials(
+    std::string& dst, partial_refs& dst_refs,
+    const std::string& src, const partial_refs& src_refs)
+{
+    for(auto& r : src_refs)
+        dst_refs.push_back({dst.size() + r.offset, r.idx});
+    dst += src;
+}
+
+/*
+    top level output of a view, the large buffers are referenced instead
+    of copied. Once streaming, the output is flushed by flush_size bytes.
+*/
+class view_out
+{
+public:
+    typedef std::function<void(evbuffer*)> flush_cb;
+    
+    view_out()
+        : _buf(evbuffer_new()), _flush_size(0)
+    {
+    }
+    
+    ~view_out()
+    {
+        evbuffer_free(_buf);
+    }
+    
+    view_out(const view_out&) = delete;
+    view_out& operator=(const view_out&) = delete;
+    
+    evbuffer* buffer() const { return _buf;}
+    size_t size() const { return evbuffer_get_length(_buf);}
+    
+    void stream(size_t flush_size, flush_cb cb)
+    {
+        _flush_size = flush_size;
+        _flush = cb;
+    }
+    bool streaming() const { return (bool)_flush;}
+    
+    void flush()
+    {
+        if(_flush)
+            _flush(_buf);
+    }
+    
+    void append(const char* data, size_t len)
+    {
+        evbuffer_add(_buf, data, len);
+        _written();
+    }
+    
+    void append_escaped(md::string_view d)
+    {
+        evbuffer* buf = _buf;
+        html_escape_to(d, [buf](const char* s, size_t l){
+            evbuffer_add(buf, s, l);
+        });
+        _written();
+    }
+    
+    // data is referenced by the output for as long as owner lives
+    template<typename T>
+    void reference(
+        const std::shared_ptr<T>& owner, const char* data, size_t len)
+    {
+        _reference(owner, data, len);
+        _written();
+    }
+    
+    /*
+        the segments of src are referenced by the output for as long as
+        owner lives, src must not change afterward. Unlike
+        evbuffer_add_buffer_reference, src may itself hold references.
+    */
+    template<typename T>
+    void splice(const std::shared_ptr<T>& owner, evbuffer* src)
+    {
+        int n = evbuffer_peek(src, -1, nullptr, nullptr, 0);
+        if(n <= 0)
+            return;
+        std::vector<evbuffer_iovec> segs(n);
+        evbuffer_peek(src, -1, nullptr, segs.data(), n);
+        for(auto& seg : segs)
+            _reference(owner, (const char*)seg.iov_base, seg.iov_len);
+        _written();
+    }
+    
+    // moves a buffer to the output, the small ones are copied
+    void move(std::string&& data)
+    {
+        if(data.size() < EVMVC_VIEW_OUT_REF_MIN_SIZE)
+            return append(data.data(), data.size());
+        auto sp = std::make_shared<std::string>(std::move(data));
+        reference(sp, sp->data(), sp->size());
+    }
+    
+private:
+    template<typename T>
+    void _reference(
+        const std::shared_ptr<T>& owner, const char* data, size_t len)
+    {
+        if(len == 0)
+            return;
+        auto ref = new std::shared_ptr<T>(owner);
+        if(evbuffer_add_reference(_buf, data, len,
+            [](const void* data, size_t len, void* arg){
+                delete (std::shared_ptr<T>*)arg;
+            }, ref)
+        ){
+            delete ref;
+            throw MD_ERR("evbuffer_add_reference failed!");
+        }
+    }
+    
+    void _written()
+    {
+        if(_flush && evbuffer_get_length(_buf) >= _flush_size)
+            _flush(_buf);
+    }
+    
+    evbuffer* _buf;
+    size_t _flush_size;
+    flush_cb _flush;
+};
+
+}//::_internal
+
 class view_engine;
 typedef std::shared_ptr<view_engine> sp_view_engine;
 
@@ -55,6 +248,16 @@ enum class view_type
     body = 3
 };
 
+enum class view_output
+{
+    // the callback receives the rendered view
+    buffer = 0,
+    // the outer view is sent as the response
+    reply = 1,
+    // the outer view is sent with chunked encoding as it renders
+    stream = 2
+};
+
 class view_base
     : public std::enable_shared_from_this<view_base>
 {
@@ -63,12 +266,17 @@ public:
     view_base(
         sp_view_engine engine,
         const evmvc::response& _res)
-        : _engine(engine),
+        : _engine(engine), _direct(false),
+        _partials_pending(0),
         res(_res),
         req(_res->req())
     {
     }
     
+    virtual ~view_base()
+    {
+    }
+    
     sp_view_engine engine() const { return _engine.lock();}
     
     virtual evmvc::view_type type() const = 0;
@@ -84,13 +292,35 @@ public:
     ) = 0;
     
     
-    void begin_write(md::string_view lng)
+    /**
+     * Sends the top level output to the response with chunked encoding
+     * as it renders.
+     */
+    void enable_streaming(size_t flush_size)
     {
-        _push_buffer(lng);
+        evmvc::response r = res;
+        _out.stream(flush_size, [r](evbuffer* out){
+            if(!r->streaming())
+                r->stream_start();
+            r->stream_write(out);
+        });
     }
-    void commit_write(md::string_view lng)
+    bool streaming() const { return _out.streaming();}
+    
+    /**
+     * Sends the rendered output as the response, the segments of the
+     * output are written to the connection without being joined.
+     */
+    void reply();
+    
+    void begin_write(md::string_view lng);
+    void commit_write(md::string_view lng);
+    
+    // static literal, the length is known at compile time
+    template<size_t N>
+    void write_lit(const char (&data)[N])
     {
-        _pop_buffer(lng);
+        _append_buffer(md::string_view(data, N -1));
     }
     
     // ==================
@@ -99,19 +329,8 @@ public:
     
     template<typename T,
         typename std::enable_if<
-            !(
-                std::is_same<int16_t, T>::value ||
-                std::is_same<int32_t, T>::value ||
-                std::is_same<int64_t, T>::value ||
-
-                std::is_same<uint16_t, T>::value ||
-                std::is_same<uint32_t, T>::value ||
-                std::is_same<uint64_t, T>::value ||
-                
-                std::is_same<float, T>::value ||
-                std::is_same<double, T>::value
-            )
-        , int32_t>::type = -1
+            !_internal::is_view_number<T>::value, int32_t
+        >::type = -1
     >
     void write_enc(T data)
     {
@@ -122,19 +341,8 @@ public:
 
     template<typename T,
         typename std::enable_if<
-            !(
-                std::is_same<int16_t, T>::value ||
-                std::is_same<int32_t, T>::value ||
-                std::is_same<int64_t, T>::value ||
-
-                std::is_same<uint16_t, T>::value ||
-                std::is_same<uint32_t, T>::value ||
-                std::is_same<uint64_t, T>::value ||
-                
-                std::is_same<float, T>::value ||
-                std::is_same<double, T>::value
-            )
-        , int32_t>::type = -1
+            !_internal::is_view_number<T>::value, int32_t
+        >::type = -1
     >
     void write_raw(T data)
     {
@@ -147,56 +355,74 @@ public:
     // == VALID TYPE ==
     // ================
     
+    // numbers never need to be escaped
     template<
         typename T,
         typename std::enable_if<
-            std::is_same<int16_t, T>::value ||
-            std::is_same<int32_t, T>::value ||
-            std::is_same<int64_t, T>::value ||
-
-            std::is_same<uint16_t, T>::value ||
-            std::is_same<uint32_t, T>::value ||
-            std::is_same<uint64_t, T>::value ||
-
-            std::is_same<float, T>::value ||
-            std::is_same<double, T>::value
-        , int32_t>::type = -1
+            _internal::is_view_number<T>::value, int32_t
+        >::type = -1
     >
     void write_enc(T data)
     {
-        _append_buffer(html_escape(md::num_to_str(data)));
+        write_raw(data);
     }
     
     template<
         typename T,
         typename std::enable_if<
-            std::is_same<int16_t, T>::value ||
-            std::is_same<int32_t, T>::value ||
-            std::is_same<int64_t, T>::value ||
-
-            std::is_same<uint16_t, T>::value ||
-            std::is_same<uint32_t, T>::value ||
-            std::is_same<uint64_t, T>::value ||
-
-            std::is_same<float, T>::value ||
-            std::is_same<double, T>::value
-        , int32_t>::type = -1
+            std::is_integral<T>::value &&
+            _internal::is_view_number<T>::value, int32_t
+        >::type = -1
+    >
+    void write_raw(T data)
+    {
+        fmt::format_int f(data);
+        _append_buffer(md::string_view(f.data(), f.size()));
+    }
+    
+    template<
+        typename T,
+        typename std::enable_if<
+            std::is_floating_point<T>::value, int32_t
+        >::type = -1
     >
     void write_raw(T data)
     {
-        _append_buffer(md::num_to_str(data));
+        char buf[64];
+        auto r = fmt::format_to_n(buf, sizeof(buf), "{}", data);
+        _append_buffer(
+            md::string_view(buf, std::min(r.size, sizeof(buf)))
+        );
     }
     
-    EVMVC_VIEW_BASE_ADD_TYPE(
-        const char*,
-        evmvc::html_escape(data),
-        data
-    )
-    EVMVC_VIEW_BASE_ADD_TYPE(
-        const std::string&,
-        evmvc::html_escape(data),
-        data
-    )
+    void write_enc(bool data)
+    {
+        write_raw(data);
+    }
+    void write_raw(bool data)
+    {
+        if(data)
+            write_lit("true");
+        else
+            write_lit("false");
+    }
+    
+    void write_enc(const evmvc::json& data)
+    {
+        if(data.is_string())
+            return _append_escaped(data.get_ref<const std::string&>());
+        _write_json(data, true);
+    }
+    void write_raw(const evmvc::json& data)
+    {
+        if(data.is_string())
+            return _append_buffer(data.get_ref<const std::string&>());
+        _write_json(data, false);
+    }
+    
+    EVMVC_VIEW_BASE_ADD_TYPE(const char*)
+    EVMVC_VIEW_BASE_ADD_TYPE(const std::string&)
+    EVMVC_VIEW_BASE_ADD_TYPE(md::string_view)
     
     // ===============
     // == view data ==
@@ -243,6 +469,30 @@ public:
         return fmt::format(f.data(), args...);
     }
     
+    // =======================
+    // == fragments caching ==
+    // =======================
+    
+    /**
+     * Writes the cached fragment and returns false when key is cached,
+     * otherwise the output is captured until commit_cache.
+     * ttl is in seconds, zero never expires.
+     */
+    bool begin_cache(const std::string& key, size_t ttl = 0)
+    {
+        if(auto data = _internal::fragments().get(key)){
+            this->write_raw(*data);
+            return false;
+        }
+        _cache_keys.push(std::make_pair(key, ttl));
+        _push_buffer("#");
+        return true;
+    }
+    void commit_cache()
+    {
+        _pop_buffer("#");
+    }
+    
     // ==============================
     // == body, scripts and styles ==
     // ==============================
@@ -256,6 +506,11 @@ public:
     {
         if(!_body)
             return;
+        if(_direct_out()){
+            // the head is sent as soon as the layout reaches its body
+            _out.flush();
+            return _out.splice(_body, _body->_out.buffer());
+        }
         
         this->begin_write("html");
         this->write_raw(_body->buffer());
@@ -263,6 +518,17 @@ public:
     }
     void render_view(md::string_view path, md::callback::async_cb cb);
     
+    /**
+     * Starts the rendering of the partial at path without waiting for it,
+     * its output is stitched in place once the view rendering is done.
+     */
+    void render_partial(md::string_view path);
+    
+    /**
+     * Calls cb once all the partials of the view are rendered and written.
+     */
+    void await_partials(md::callback::async_cb cb);
+    
     void add_script(const std::string& src)
     {
         res->scripts().emplace_back(src);
@@ -280,11 +546,16 @@ public:
     
     void add_section(const std::string& name, const std::string& src)
     {
+        this->add_section(name, std::string(src));
+    }
+    void add_section(const std::string& name, std::string&& src)
+    {
+        auto sec = std::make_shared<std::string>(std::move(src));
         auto it = res->sections().find(name);
         if(it != res->sections().end())
-            it->second = src;
+            it->second = sec;
         else
-            res->sections().emplace(std::make_pair(name, src));
+            res->sections().emplace(std::make_pair(name, sec));
     }
     
     void write_scripts()
@@ -328,33 +599,117 @@ public:
             return;
         }
         
+        // shared with the output until written to the connection
+        std::shared_ptr<std::string> sec = it->second;
+        if(_direct_out())
+            return _out.reference(sec, sec->data(), sec->size());
+        
         this->begin_write("html");
-        this->write_raw(it->second);
+        _append_section(sec);
         this->commit_write("html");
     }
     
-    const std::string& buffer() const
+    const std::string& buffer()
     {
+        // joined on demand, the segments may be referenced by a layout
+        size_t len = _out.size();
+        if(_out_buffer.size() != len){
+            _out_buffer.resize(len);
+            evbuffer_copyout(_out.buffer(), &_out_buffer[0], len);
+        }
         return _out_buffer;
     }
     
 private:
     std::weak_ptr<view_engine> _engine;
     std::shared_ptr<view_base> _body;
+    
+    // top level output, the body and the sections are spliced
+    // in by reference
+    _internal::view_out _out;
     std::string _out_buffer;
+    // top level output following a pending partial
+    std::string _out_tail;
+    _internal::partial_refs _out_tail_partials;
+    bool _direct;
     
     std::stack<std::string> _buffers;
     std::stack<std::string> _buffer_lngs;
+    // nested html writes merged in the top buffer
+    std::stack<size_t> _buffer_merged;
+    // pending partials of each buffer
+    std::stack<_internal::partial_refs> _buffer_partials;
+    // keys and ttl of the fragments being cached
+    std::stack<std::pair<std::string, size_t>> _cache_keys;
+    
+    // partials still rendering when they were requested
+    std::vector<_internal::partial_slot> _partials;
+    size_t _partials_pending;
+    md::callback::async_cb _partials_cb;
+    // sections and fragments holding pending partials
+    std::vector<std::tuple<
+        std::string, std::shared_ptr<std::string>, _internal::partial_refs
+    >> _partials_sections;
+    std::vector<std::tuple<
+        std::string, size_t, std::string, _internal::partial_refs
+    >> _partials_frags;
+    
+    // top level html is written in the output, unless it must be parsed
+    // or follows a pending partial
+    bool _direct_out() const
+    {
+        return _direct && _buffers.size() == 1 && _partials.empty();
+    }
     
     void _append_buffer(md::string_view d)
     {
-        _buffers.top() += d.to_string();
+        if(_direct_out())
+            return _out.append(d.data(), d.size());
+        _buffers.top().append(d.data(), d.size());
     }
     
+    // escapes d directly into the current output
+    void _append_escaped(md::string_view d)
+    {
+        if(_direct_out())
+            return _out.append_escaped(d);
+        std::string& out = _buffers.top();
+        html_escape_to(d, [&out](const char* s, size_t l){
+            out.append(s, l);
+        });
+    }
+    
+    void _write_json(const evmvc::json& data, bool enc)
+    {
+        switch(data.type()){
+            case evmvc::json::value_t::boolean:
+                return write_raw(data.get<bool>());
+            case evmvc::json::value_t::number_integer:
+                return write_raw(data.get<int64_t>());
+            case evmvc::json::value_t::number_unsigned:
+                return write_raw(data.get<uint64_t>());
+            case evmvc::json::value_t::number_float:
+                return write_raw(data.get<double>());
+            default:
+                if(enc)
+                    return _append_escaped(data.dump());
+                return _append_buffer(data.dump());
+        }
+    }
+    
+    void _render(
+        md::string_view path,
+        md::callback::value_cb<const std::string&> cb
+    );
+    void _end_partials();
+    void _append_section(const std::shared_ptr<std::string>& sec);
+    
     void _push_buffer(md::string_view lng)
     {
         _buffers.push("");
         _buffer_lngs.push(lng.to_string());
+        _buffer_merged.push(0);
+        _buffer_partials.emplace();
     }
     
     void _pop_buffer(md::string_view lng);
@@ -33,9 +33,12 @@ inline void view_base::render_view(
     md::string_view path, md::callback::async_cb cb)
 {
     auto self = this->shared_from_this();
-    auto scb = [self, cb](md::callback::cb_error err, const std::string& data){
-        if(err)
+    _render(path,
+    [self, cb](const md::callback::cb_error& err, const std::string& data){
+        if(err){
             cb(err);
+            return;
+        }
         try{
             self->write_raw(data);
         }catch(const std::exception& err){
@@ -43,26 +46,170 @@ inline void view_base::render_view(
             return;
         }
         cb(nullptr);
-    };
+    });
+}
+
+inline void view_base::render_partial(md::string_view path)
+{
+    auto self = this->shared_from_this();
+    size_t idx = _partials.size();
+    _partials.emplace_back();
+    
+    _render(path,
+    [self, idx](const md::callback::cb_error& err, const std::string& data){
+        _internal::partial_slot& p = self->_partials[idx];
+        p.done = true;
+        if(err)
+            p.err = err;
+        else
+            p.data = data;
+        
+        if(!p.async || --self->_partials_pending > 0 || !self->_partials_cb)
+            return;
+        md::callback::async_cb cb = self->_partials_cb;
+        self->_partials_cb = nullptr;
+        self->await_partials(cb);
+    });
+    
+    // rendered synchronously, the output is written in place
+    if(_partials[idx].done){
+        _internal::partial_slot p = std::move(_partials[idx]);
+        _partials.pop_back();
+        if(p.err)
+            throw MD_ERR(
+                "Unable to render the partial '{}'\n{}", path, p.err
+            );
+        this->write_raw(p.data);
+        return;
+    }
+    
+    _partials[idx].async = true;
+    ++_partials_pending;
+    _buffer_partials.top().push_back({_buffers.top().size(), idx});
+}
+
+inline void view_base::await_partials(md::callback::async_cb cb)
+{
+    if(_partials_pending > 0){
+        _partials_cb = cb;
+        return;
+    }
+    
+    for(auto& p : _partials)
+        if(p.err){
+            cb(p.err);
+            return;
+        }
     
+    try{
+        _end_partials();
+    }catch(const std::exception& err){
+        cb(err);
+        return;
+    }
+    cb(nullptr);
+}
+
+inline void view_base::_render(
+    md::string_view path,
+    md::callback::value_cb<const std::string&> cb)
+{
     std::string ps = path.to_string();
     size_t nsp = ps.rfind("::");
     if(nsp == std::string::npos){
         if(*ps.begin() != '/')
             ps = this->path().to_string() + ps;
-            
-        engine()->render_view(this->res, ps, scb);
         
+        engine()->render_view(this->res, ps, cb);
+    
     }else{
         std::string ns = ps.substr(0, nsp);
         std::string p = ps.substr(ns.size() +2);
         if(*p.begin() != '/')
             ps = ns + "::" + this->path().to_string() + p;
         
-        view_engine::render(this->res, ps, scb);
+        view_engine::render(this->res, ps, cb);
     }
 }
 
+inline void view_base::_end_partials()
+{
+    if(!_partials.empty()){
+        _internal::stitch_partials(_out_tail, _out_tail_partials, _partials);
+        for(auto& ps : _partials_sections){
+            auto it = res->sections().find(std::get<0>(ps));
+            // replaced since, the partials are not part of it anymore
+            if(it == res->sections().end() || it->second != std::get<1>(ps))
+                continue;
+            // a copy, the section may already be referenced by the output
+            auto sec = std::make_shared<std::string>(*it->second);
+            _internal::stitch_partials(*sec, std::get<2>(ps), _partials);
+            it->second = sec;
+        }
+        for(auto& f : _partials_frags){
+            _internal::stitch_partials(
+                std::get<2>(f), std::get<3>(f), _partials
+            );
+            _internal::fragments().put(
+                std::get<0>(f), std::get<2>(f), std::get<1>(f),
+                res->get_app()->options().views.fragment_cache_size
+            );
+        }
+    }
+    _out.move(std::move(_out_tail));
+    _out_tail.clear();
+    _out_tail_partials.clear();
+}
+
+inline void view_base::_append_section(
+    const std::shared_ptr<std::string>& sec)
+{
+    for(auto& ps : _partials_sections)
+        if(std::get<1>(ps) == sec){
+            _internal::append_partials(
+                _buffers.top(), _buffer_partials.top(),
+                *sec, std::get<2>(ps)
+            );
+            return;
+        }
+    _append_buffer(*sec);
+}
+
+inline void view_base::reply()
+{
+    if(res->streaming())
+        return res->stream_write(_out.buffer());
+    
+    // nothing sent yet, the output is replied with a Content-Length
+    res->encoding("utf-8").type("html").send(_out.buffer());
+}
+
+inline void view_base::begin_write(md::string_view lng)
+{
+    // the whole output is parsed by the html parser
+    if(_buffers.empty())
+        _direct = !view_engine::has_html_parser();
+    
+    // without html parser a nested html buffer would only be
+    // appended back to its parent, the output is written in place.
+    if(!_buffers.empty() && lng == "html" && _buffer_lngs.top() == "html" &&
+        !view_engine::has_html_parser()
+    ){
+        ++_buffer_merged.top();
+        return;
+    }
+    _push_buffer(lng);
+}
+
+inline void view_base::commit_write(md::string_view lng)
+{
+    if(!_buffer_merged.empty() && _buffer_merged.top() > 0 && lng == "html"){
+        --_buffer_merged.top();
+        return;
+    }
+    _pop_buffer(lng);
+}
+
 inline void view_base::_pop_buffer(md::string_view lng)
 {
     std::string lngc = lng.to_string();
@@ -82,19 +229,64 @@ inline void view_base::_pop_buffer(md::string_view lng)
         lngc = "html";
     }
     
-    // look for a parser
-    evmvc::view_engine::parse_language(lngc, this->res, _buffers.top());
-    
-    std::string tbuf = _buffers.top();
+    std::string tbuf = std::move(_buffers.top());
+    _internal::partial_refs trefs = std::move(_buffer_partials.top());
     _buffers.pop();
     _buffer_lngs.pop();
+    _buffer_merged.pop();
+    _buffer_partials.pop();
+    
+    // look for a parser, the text around the pending partials is parsed
+    // by segment to keep their offsets.
+    if(trefs.empty())
+        evmvc::view_engine::parse_language(lngc, this->res, tbuf);
+    else if(evmvc::view_engine::has_language_parser(lngc)){
+        std::string parsed;
+        size_t beg = 0;
+        for(size_t i = 0; i <= trefs.size(); ++i){
+            size_t end = i < trefs.size() ? trefs[i].offset : tbuf.size();
+            std::string seg = tbuf.substr(beg, end - beg);
+            evmvc::view_engine::parse_language(lngc, this->res, seg);
+            parsed += seg;
+            beg = end;
+            if(i < trefs.size())
+                trefs[i].offset = parsed.size();
+        }
+        tbuf.swap(parsed);
+    }
+    
+    if(lngc == "#" && !trefs.empty()){
+        _partials_frags.emplace_back(
+            _cache_keys.top().first, _cache_keys.top().second, tbuf, trefs
+        );
+        _cache_keys.pop();
+    }else if(lngc == "#"){
+        _internal::fragments().put(
+            _cache_keys.top().first, tbuf, _cache_keys.top().second,
+            res->get_app()->options().views.fragment_cache_size
+        );
+        _cache_keys.pop();
+    }
     
     if(in_section){
-        this->add_section(sec_name, tbuf);
-    }else if(_buffers.size() == 0)
-        _out_buffer += tbuf;
-    else
-        _buffers.top() += tbuf;
+        this->add_section(sec_name, std::move(tbuf));
+        if(!trefs.empty())
+            _partials_sections.emplace_back(
+                sec_name, res->sections()[sec_name], std::move(trefs)
+            );
+    }else if(_buffers.size() == 0){
+        // written by await_partials once stitched
+        _out_tail = std::move(tbuf);
+        _out_tail_partials = std::move(trefs);
+    }else if(_direct_out())
+        _out.move(std::move(tbuf));
+    else if(_buffers.top().empty() && _buffer_partials.top().empty()){
+        _buffers.top().swap(tbuf);
+        _buffer_partials.top().swap(trefs);
+    }else
+        _internal::append_partials(
+            _buffers.top(), _buffer_partials.top(), tbuf, trefs
+        );
 }
 
 
@@ -70,6 +70,18 @@ public:
         lang_parsers().emplace(
             std::make_pair(lng_str, pfn)
         );
+        if(lng_str == "html")
+            _html_parser() = true;
+    }
+    
+    static bool has_html_parser()
+    {
+        return _html_parser();
+    }
+    
+    static bool has_language_parser(const std::string& lang)
+    {
+        return lang_parsers().find(lang) != lang_parsers().end();
     }
     
     static void parse_language(
@@ -91,12 +103,22 @@ public:
         _engines().emplace(
             std::make_pair(ns, engine)
         );
+        _path_engines().clear();
+    }
+    
+    static sp_view_engine find_engine(const std::string& ns)
+    {
+        auto it = _engines().find(ns);
+        if(it == _engines().end())
+            return nullptr;
+        return it->second;
     }
     
     static void render(
         const evmvc::response& res,
         md::string_view path,
-        md::callback::value_cb<const std::string&> cb)
+        md::callback::value_cb<const std::string&> cb,
+        view_output out = view_output::buffer)
     {
         size_t p = path.rfind("::");
         std::string ns = 
@@ -114,16 +136,14 @@ public:
                 ), "");
                 return;
             }
-            it->second->render_view(res, vpath, cb);
+            it->second->render_view(res, vpath, cb, out);
             return;
         }
         
         // search the view in all namespace
-        for(auto it = _engines().begin(); it != _engines().end(); ++it){
-            if(it->second->view_exists(vpath)){
-                it->second->render_view(res, vpath, cb);
-                return;
-            }
+        if(auto e = _find_engine(vpath)){
+            e->render_view(res, vpath, cb, out);
+            return;
         }
         
         cb(MD_ERR(
@@ -150,11 +170,8 @@ public:
         }
         
         // search the view in all namespace
-        for(auto it = _engines().begin(); it != _engines().end(); ++it){
-            if(it->second->view_exists(vpath)){
-                return it->second->get_view(res, vpath);
-            }
-        }
+        if(auto e = _find_engine(vpath))
+            return e->get_view(res, vpath);
         return nullptr;
     }
     
@@ -173,6 +190,27 @@ public:
         const std::string& path,
         md::callback::value_cb<const std::string&> cb
     ) = 0;
+    /**
+     * Unless out is view_output::buffer the outer layout is sent to the
+     * response and the callback receives an empty buffer. The engines
+     * that don't override it render buffered, the output is then sent
+     * by response::render.
+     */
+    virtual void render_view(
+        const evmvc::response& res,
+        const std::string& path,
+        md::callback::value_cb<const std::string&> cb,
+        view_output /*out*/)
+    {
+        this->render_view(res, path, cb);
+    }
+    
+protected:
+    // the views of an engine were replaced
+    static void _views_changed()
+    {
+        _path_engines().clear();
+    }
     
 private:
     static std::unordered_map<std::string, sp_view_engine>& _engines()
@@ -181,6 +219,34 @@ private:
         return _c;
     }
     
+    // engine of the views requested without namespace
+    static std::unordered_map<std::string, sp_view_engine>& _path_engines()
+    {
+        static std::unordered_map<std::string, sp_view_engine> _c;
+        return _c;
+    }
+    
+    static sp_view_engine _find_engine(const std::string& vpath)
+    {
+        auto pit = _path_engines().find(vpath);
+        if(pit != _path_engines().end())
+            return pit->second;
+        
+        for(auto it = _engines().begin(); it != _engines().end(); ++it){
+            if(it->second->view_exists(vpath)){
+                _path_engines().emplace(std::make_pair(vpath, it->second));
+                return it->second;
+            }
+        }
+        return nullptr;
+    }
+    
+    static bool& _html_parser()
+    {
+        static bool _has = false;
+        return _has;
+    }
+    
     static lang_parser_map& lang_parsers()
     {
         static lang_parser_map _lang_parsers;
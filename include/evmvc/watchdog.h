@@ -0,0 +1,180 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _libevmvc_watchdog_h
+#define _libevmvc_watchdog_h
+
+#include "stable_headers.h"
+#include "global.h"
+#include "configuration.h"
+#include "metrics.h"
+
+namespace evmvc {
+
+/*
+    event loop watchdog of a worker, a periodic timer measures the
+    delay of the loop and publishes a heartbeat in the shared metrics,
+    the callback_scope report the callbacks blocking the loop.
+*/
+class loop_watchdog
+{
+public:
+    loop_watchdog()
+        : _ev(nullptr), _last_us(0)
+    {
+    }
+    
+    bool enabled() const { return _ev != nullptr;}
+    int64_t slow_us() const { return (int64_t)_opts.slow_ms * 1000;}
+    
+    // last callback reported as slow
+    const std::string& last_slow() const { return _last_slow;}
+    
+    static int64_t steady_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+    
+    // called in the worker process before its loop is started
+    void start(const watchdog_options& opts, md::log::logger log)
+    {
+        if(!opts.enabled || opts.interval_ms <= 0 || _ev)
+            return;
+        
+        _opts = opts;
+        _log = log;
+        _last_us = steady_us();
+        worker_metrics().heartbeat_ms.store(
+            _last_us / 1000, std::memory_order_relaxed
+        );
+        
+        _ev = event_new(
+            global::ev_base(), -1, EV_PERSIST, loop_watchdog::_on_tick, this
+        );
+        timeval tv = md::date::ms_to_timeval(_opts.interval_ms);
+        event_add(_ev, &tv);
+    }
+    
+    void stop()
+    {
+        if(!_ev)
+            return;
+        event_del(_ev);
+        event_free(_ev);
+        _ev = nullptr;
+        worker_metrics().heartbeat_ms.store(0, std::memory_order_relaxed);
+    }
+    
+    void slow_callback(
+        callback_kind kind, md::string_view name, int id, int64_t us)
+    {
+        worker_metrics().slow_callbacks[(size_t)kind].fetch_add(
+            1, std::memory_order_relaxed
+        );
+        _last_slow = id >= 0 ?
+            fmt::format("{} {}", to_string(kind), id) :
+            fmt::format("{} '{}'", to_string(kind), name);
+        _log->warn(
+            "{} blocked the event loop for {}ms", _last_slow, us / 1000
+        );
+    }
+
+private:
+    void _tick()
+    {
+        int64_t now = steady_us();
+        int64_t lag = now - _last_us - (int64_t)_opts.interval_ms * 1000;
+        if(lag < 0)
+            lag = 0;
+        _last_us = now;
+        
+        worker_metrics().loop_lag.record(lag);
+        worker_metrics().heartbeat_ms.store(
+            now / 1000, std::memory_order_relaxed
+        );
+        if(lag >= slow_us())
+            _log->warn(
+                "event loop lag: {}ms, last slow callback: {}",
+                lag / 1000, _last_slow.empty() ? "none" : _last_slow
+            );
+    }
+    
+    static void _on_tick(int /*fd*/, short /*events*/, void* arg)
+    {
+        ((loop_watchdog*)arg)->_tick();
+    }
+    
+    watchdog_options _opts;
+    md::log::logger _log;
+    event* _ev;
+    int64_t _last_us;
+    std::string _last_slow;
+};
+
+namespace _internal {
+inline loop_watchdog& watchdog()
+{
+    static loop_watchdog _wd;
+    return _wd;
+}
+}//::_internal
+
+/*
+    times a synchronous callback of the loop and reports it
+    when it runs longer than watchdog_options::slow_ms.
+*/
+class callback_scope
+{
+public:
+    callback_scope(callback_kind kind, md::string_view name, int id = -1)
+        : _kind(kind), _name(name), _id(id),
+        _start(
+            _internal::watchdog().enabled() ? loop_watchdog::steady_us() : 0
+        )
+    {
+    }
+    
+    ~callback_scope()
+    {
+        if(_start == 0)
+            return;
+        int64_t us = loop_watchdog::steady_us() - _start;
+        if(us >= _internal::watchdog().slow_us())
+            _internal::watchdog().slow_callback(_kind, _name, _id, us);
+    }
+    
+    callback_scope(const callback_scope&) = delete;
+    callback_scope& operator=(const callback_scope&) = delete;
+
+private:
+    callback_kind _kind;
+    md::string_view _name;
+    int _id;
+    int64_t _start;
+};
+
+}//::evmvc
+#endif //_libevmvc_watchdog_h
@@ -31,8 +31,15 @@ SOFTWARE.
 #include "child_server.h"
 #include "connection.h"
 #include "cmd.h"
+#include "fragment_cache.h"
+#include "log_ring.h"
+#include "metrics.h"
+#include "access_log.h"
+#include "watchdog.h"
+#include "offload.h"
 
 #include <sys/prctl.h>
+#include <sys/uio.h>
 
 #define EVMVC_PIPE_WRITE_FD 1
 #define EVMVC_PIPE_READ_FD 0
@@ -130,6 +137,7 @@ private:
             rcmd_buf = nullptr;
         }
 
+        _close_cmd_queue();
         if(ptoc[EVMVC_PIPE_WRITE_FD] > -1){
             close(ptoc[EVMVC_PIPE_WRITE_FD]);
             ptoc[EVMVC_PIPE_WRITE_FD] = -1;
@@ -175,13 +183,39 @@ private:
             close(ptoc[EVMVC_PIPE_READ_FD]);
             ptoc[EVMVC_PIPE_READ_FD] = -1;
         }
+        _close_cmd_queue();
         if(ctop[EVMVC_PIPE_WRITE_FD] > -1){
             close(ctop[EVMVC_PIPE_WRITE_FD]);
             ctop[EVMVC_PIPE_WRITE_FD] = -1;
         }
     }
 
+    int _cmd_fd() const
+    {
+        return _type == channel_type::child ?
+            ctop[EVMVC_PIPE_WRITE_FD] : ptoc[EVMVC_PIPE_WRITE_FD];
+    }
+
     ssize_t _sendcmd(int cmd_id, const char* payload, size_t payload_len);
+    void _queue_cmd(const struct iovec* iov, int iovcnt, size_t skip);
+    void _flush_cmd_queue();
+    static void _on_cmd_write(int fd, short events, void* arg);
+
+    // the remaining commands are sent while the pipe accepts them
+    void _close_cmd_queue()
+    {
+        if(wcmd_ev){
+            event_del(wcmd_ev);
+            event_free(wcmd_ev);
+            wcmd_ev = nullptr;
+        }
+        if(wcmd_buf){
+            if(_cmd_fd() > -1)
+                evbuffer_write(wcmd_buf, _cmd_fd());
+            evbuffer_free(wcmd_buf);
+            wcmd_buf = nullptr;
+        }
+    }
 
 
     evmvc::worker_t* _worker;
@@ -192,6 +226,9 @@ public:
     int ctop[2] = {-1,-1};
     struct event* rcmd_ev = nullptr;
     struct evbuffer* rcmd_buf = nullptr;
+    // commands waiting for the pipe to be writable
+    struct event* wcmd_ev = nullptr;
+    struct evbuffer* wcmd_buf = nullptr;
     // access control messages (ancillary data) socket
     int usock = -1;
     std::string usock_path = "";
@@ -245,6 +282,29 @@ typedef std::function<bool(shared_command cmd)>
     cmd_parser_fn;
 
 worker active_worker(worker w = nullptr);
+
+namespace _internal {
+typedef std::function<
+    void(const std::string& ns, const std::string& so_path)
+> views_reload_fn;
+
+// loads the views of a namespace from a shared object in the workers,
+// set by the fanjet hot reload of the development builds.
+inline views_reload_fn& views_reload_handler()
+{
+    static views_reload_fn fn;
+    return fn;
+}
+
+// current views library of each namespace, set in the master and
+// inherited by the respawned workers.
+inline std::unordered_map<std::string, std::string>& reloaded_views()
+{
+    static std::unordered_map<std::string, std::string> libs;
+    return libs;
+}
+}//::_internal
+
 class worker_t
     : public std::enable_shared_from_this<worker_t>
 {
@@ -288,8 +348,18 @@ protected:
         _pid(-1),
         _ptype(process_type::unknown),
         _channel(std::make_unique<evmvc::channel>(this)),
+        _metrics(_internal::metrics().acquire()),
         _evsigint(nullptr), _evsigpipe(nullptr)
     {
+        // mapped before the fork, shared with the child process
+        if(_config.worker_log_ring_size > 0)
+            _log_ring = std::make_unique<evmvc::log_ring>(
+                _config.worker_log_ring_size
+            );
+        if(_config.access_log.enabled && _config.access_log.ring_size > 0)
+            _access_ring = std::make_unique<evmvc::log_ring>(
+                _config.access_log.ring_size
+            );
     }
 
 
@@ -300,6 +370,10 @@ public:
         if(running())
             this->stop();
         _channel.release();
+        // the remaining logs are drained by the master
+        _log_ring.reset();
+        _access_ring.reset();
+        _internal::metrics().release(_metrics);
     }
 
     worker_type work_type() const { return _wtype;}
@@ -326,6 +400,23 @@ public:
 
     bool is_child() const { return _ptype == process_type::child;}
 
+    // null when the worker has no shared metrics slot
+    const metrics_block* metrics() const { return _metrics;}
+    // null when the log ring is disabled
+    evmvc::log_ring* log_ring() const { return _log_ring.get();}
+    // null when the access log is disabled
+    evmvc::log_ring* access_ring() const { return _access_ring.get();}
+
+    // the loop of the worker did not tick for watchdog_options::stall_ms
+    bool stalled() const
+    {
+        if(!_metrics || _config.watchdog.stall_ms <= 0)
+            return false;
+        int64_t hb = _metrics->heartbeat_ms.load(std::memory_order_relaxed);
+        return hb > 0 &&
+            loop_watchdog::steady_us() / 1000 - hb > _config.watchdog.stall_ms;
+    }
+
     void set_callbacks(
         md::callback::async_item_cb<evmvc::process_type> started_cb,
         md::callback::async_item_cb<evmvc::process_type> stopped_cb)
@@ -346,6 +437,30 @@ public:
             _ptype = process_type::master;
             _pid = pid;
 
+            if(_log_ring)
+                _log_ring->watch(
+                    global::ev_base(),
+                    [this](
+                        md::log::log_level lvl, md::string_view path,
+                        int64_t time, md::string_view msg
+                    ){
+                        _log->log(path, lvl, msg);
+                    },
+                    _log
+                );
+            if(_access_ring && _internal::access_log())
+                _access_ring->watch(
+                    global::ev_base(),
+                    [](
+                        md::log::log_level /*lvl*/, md::string_view /*path*/,
+                        int64_t time, md::string_view msg
+                    ){
+                        if(auto& w = _internal::access_log())
+                            w->append(time, msg);
+                    },
+                    _log
+                );
+
         }else if(pid == 0){
             // struct sigaction sigint_sa;
             // sigint_sa.sa_handler = worker_t::sig_received;
@@ -358,6 +473,7 @@ public:
             _pid = getpid();
 
             evmvc::active_worker(this->shared_from_this());
+            _internal::metrics().activate(_metrics);
 
             _cmd_parsers.clear();
 
@@ -451,6 +567,8 @@ public:
             // closing worker on the master process
             //_channel->sendcmd(EVMVC_CMD_CLOSE, nullptr, 0);
             _channel.release();
+            _internal::watchdog().stop();
+            _internal::offload().stop();
 
             auto stop_evbase_loop = [force]() -> void{
                 if(force)
@@ -520,6 +638,26 @@ public:
     ssize_t send_log(
         md::log::log_level lvl, md::string_view path, md::string_view msg)
     {
+        // the ring and the channel are only written by the event loop,
+        // the offloaded jobs hand their logs over to it
+        if(!_internal::offload().on_loop()){
+            wp_worker ww = shared_from_this();
+            _internal::offload().post(
+            [ww, lvl, p = path.to_string(), m = msg.to_string()](){
+                if(auto w = ww.lock())
+                    w->send_log(lvl, p, m);
+            });
+            return msg.size();
+        }
+
+        // the oversized messages are sent by pipe, the dropped ones are
+        // counted and reported by the master
+        if(_log_ring){
+            if(_log_ring->write(lvl, path, msg))
+                return msg.size();
+            if(msg.size() <= _log_ring->max_msg_size())
+                return 0;
+        }
         command c(evmvc::CMD_LOG);
         c.write((int)lvl);
         c.write(path);
@@ -576,6 +714,9 @@ protected:
     int _pid;
     process_type _ptype;
     std::unique_ptr<evmvc::channel> _channel;
+    std::unique_ptr<evmvc::log_ring> _log_ring;
+    std::unique_ptr<evmvc::log_ring> _access_ring;
+    metrics_block* _metrics;
     struct event* _evsigint;
     struct event* _evsigpipe;
 
@@ -672,6 +813,11 @@ public:
         );
         event_add(_channel->rcmsg_ev, nullptr);
 
+        // a respawned worker starts with the views reloaded so far
+        if(_internal::views_reload_handler())
+            for(auto& rv : _internal::reloaded_views())
+                _internal::views_reload_handler()(rv.first, rv.second);
+
         for(auto& sc : _config.servers){
             auto s = std::make_shared<child_server_t>(
                 this->shared_from_this(), sc, _log
@@ -680,6 +826,7 @@ public:
             _servers.emplace(s->id(), s);
         }
 
+        _internal::watchdog().start(_config.watchdog, _log);
         event_base_loop(global::ev_base(), 0);
         event_base_free(global::ev_base());
         _log->info("Closing worker");
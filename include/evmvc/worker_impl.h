@@ -192,6 +192,7 @@ inline void worker_t::sig_received(int sig, short events, void *arg)
 
 inline void worker_t::parse_cmd(int cmd_id, const char* p, size_t plen)
 {
+    callback_scope scope(callback_kind::command, "", cmd_id);
     shared_command c = std::make_shared<command>(
         cmd_id, p, plen
     );
@@ -223,6 +224,26 @@ inline void worker_t::parse_cmd(int cmd_id, const char* p, size_t plen)
                     event_base_loopbreak(global::ev_base());
                 break;
             }
+            case evmvc::CMD_FRAGMENTS_INVALIDATE:{
+                std::string prefix = c->read<std::string>();
+                _internal::fragments().invalidate(prefix);
+                if(this->is_child())
+                    break;
+                
+                // forward to the other workers
+                if(auto a = _app.lock())
+                    for(auto& w : a->workers())
+                        if(w.get() != this && w->is_valid())
+                            w->send_cmd(c);
+                break;
+            }
+            case evmvc::CMD_VIEWS_RELOAD:{
+                std::string ns = c->read<std::string>();
+                std::string so_path = c->read<std::string>();
+                if(this->is_child() && _internal::views_reload_handler())
+                    _internal::views_reload_handler()(ns, so_path);
+                break;
+            }
             case evmvc::CMD_LOG:{
                 md::log::log_level lvl = (md::log::log_level)c->read<int>();
                 std::string log_path = c->read<std::string>();
@@ -279,6 +300,22 @@ inline void worker_t::parse_cmd(int cmd_id, const char* p, size_t plen)
 }
 
 
+inline void invalidate_fragments(md::string_view prefix, bool broadcast)
+{
+    _internal::fragments().invalidate(prefix);
+    if(!broadcast)
+        return;
+    
+    auto w = evmvc::active_worker();
+    if(!w || !w->is_child())
+        return;
+    
+    command c(evmvc::CMD_FRAGMENTS_INVALIDATE);
+    c.write(prefix);
+    w->send_cmd(c);
+}
+
+
 inline void http_worker_t::on_http_worker_accept(
     int fd, short events, void* arg)
 {
@@ -356,53 +393,100 @@ inline ssize_t channel::_sendcmd(
         "', to: '" << (_type == channel_type::child ? "Master" : "Child") <<
         "'" << std::endl;
     #endif
-    int fd = _type == channel_type::child ?
-        ctop[EVMVC_PIPE_WRITE_FD] : ptoc[EVMVC_PIPE_WRITE_FD];
-
-    ssize_t tn = 0;
-    ssize_t n = md::files::writen(
-        fd,
-        &cmd_id,
-        sizeof(int)
-    );
-    if(n == -1){
-        std::cerr << fmt::format(
-            "Unable to send cmd id, err: '{}'\n", errno
-        );
-        return -1;
+    int fd = _cmd_fd();
+
+    // the frame header and the payload are sent with a single syscall
+    char head[EVMVC_CMD_HEADER_SIZE];
+    memcpy(head, &cmd_id, sizeof(int));
+    memcpy(head + sizeof(int), &payload_len, sizeof(size_t));
+
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = EVMVC_CMD_HEADER_SIZE;
+    iov[1].iov_base = (void*)payload;
+    iov[1].iov_len = payload_len;
+    int iovcnt = payload_len > 0 ? 2 : 1;
+    size_t len = EVMVC_CMD_HEADER_SIZE + payload_len;
+
+    // queued after the pending commands to keep the order
+    if(wcmd_buf && evbuffer_get_length(wcmd_buf) > 0){
+        _queue_cmd(iov, iovcnt, 0);
+        return len;
     }
-    tn += n;
-    n = md::files::writen(
-        fd,
-        &payload_len,
-        sizeof(size_t)
-    );
+
+    ssize_t n;
+    do{
+        n = writev(fd, iov, iovcnt);
+    }while(n == -1 && errno == EINTR);
+
     if(n == -1){
-        std::cerr << fmt::format(
-            "Unable to send cmd payload length, err: '{}'\n", errno
-        );
-        return -1;
-    }
-    tn += n;
-    if(payload_len > 0){
-        n = md::files::writen(
-            fd,
-            payload,
-            payload_len
-        );
-        if(n == -1){
+        int err = errno;
+        if(err != EAGAIN && err != EWOULDBLOCK){
             std::cerr << fmt::format(
-                "Unable to send cmd payload, err: '{}'\n", errno
+                "Unable to send cmd: '{}', err: '{}'\n", cmd_id, err
             );
             return -1;
         }
-        tn += n;
+        n = 0;
+    }
+
+    if((size_t)n < len)
+        _queue_cmd(iov, iovcnt, n);
+    return len;
+}
+
+inline void channel::_queue_cmd(
+    const struct iovec* iov, int iovcnt, size_t skip)
+{
+    if(!wcmd_buf)
+        wcmd_buf = evbuffer_new();
+    if(!wcmd_ev)
+        wcmd_ev = event_new(
+            global::ev_base(), _cmd_fd(), EV_WRITE,
+            channel::_on_cmd_write, this
+        );
+
+    for(int i = 0; i < iovcnt; ++i){
+        if(skip >= iov[i].iov_len){
+            skip -= iov[i].iov_len;
+            continue;
+        }
+        evbuffer_add(
+            wcmd_buf,
+            (const char*)iov[i].iov_base + skip,
+            iov[i].iov_len - skip
+        );
+        skip = 0;
     }
 
-    // send the command
-    fsync(fd);
+    if(!event_pending(wcmd_ev, EV_WRITE, nullptr))
+        event_add(wcmd_ev, nullptr);
+}
+
+inline void channel::_flush_cmd_queue()
+{
+    // the queued frames are coalesced into writev calls
+    while(evbuffer_get_length(wcmd_buf) > 0){
+        int n = evbuffer_write(wcmd_buf, _cmd_fd());
+        if(n > 0)
+            continue;
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n == -1 && errno != EAGAIN && errno != EWOULDBLOCK){
+            std::cerr << fmt::format(
+                "Unable to send the queued cmds, err: '{}'\n", errno
+            );
+            evbuffer_drain(wcmd_buf, evbuffer_get_length(wcmd_buf));
+            return;
+        }
+        event_add(wcmd_ev, nullptr);
+        return;
+    }
+}
 
-    return tn;
+inline void channel::_on_cmd_write(int fd, short events, void* arg)
+{
+    ((channel*)arg)->_flush_cmd_queue();
 }
 
 
@@ -25,6 +25,7 @@ SOFTWARE.
 #include <gmock/gmock.h>
 #include "evmvc/evmvc.h"
 #include "evmvc/fanjet/fanjet.h"
+#include "evmvc/fanjet/fan_hot_reload.h"
 
 namespace evmvc { namespace tests {
 
@@ -106,5 +107,195 @@ TEST_F(fanjet_test, ast_parser)
     }
 }
 
+TEST_F(fanjet_test, fold_static_writes)
+{
+    std::string src =
+        "s->begin_write(\"html\");s->write_lit(\"<a \\\"\");"
+        "s->commit_write(\"html\");s->begin_write(\"html\");"
+        "s->write_lit(\"b\\n\"\n\"c\");s->write_lit(\"d\");"
+        "s->write_enc(x);s->write_lit(\"e\");"
+        "f(\"g\");s->write_lit(\"h\");s->commit_write(\"html\");";
+    
+    ASSERT_EQ(
+        fanjet::ast::fold_static_writes("s", src),
+        "s->begin_write(\"html\");s->write_lit(\"<a \\\"\"\"b\\n\"\n\"c\"\"d\");"
+        "s->write_enc(x);s->write_lit(\"e\");"
+        "f(\"g\");s->write_lit(\"h\");s->commit_write(\"html\");"
+    );
+}
+
+TEST_F(fanjet_test, view_index)
+{
+    auto engine = std::make_shared<evmvc::fanjet::view_engine>("test");
+    std::string hit;
+    auto reg = [&engine, &hit](const std::string& path){
+        engine->register_view_generator(path,
+        [&hit, path](evmvc::sp_view_engine, const evmvc::response&){
+            hit = path;
+            return nullptr;
+        });
+    };
+    auto resolve = [&engine, &hit](const std::string& path){
+        hit.clear();
+        engine->get_view(nullptr, path);
+        return hit;
+    };
+    
+    reg("home/index");
+    reg("home/partials/nav");
+    reg("partials/nav");
+    reg("layouts/main");
+    reg("home/helpers/main");
+    reg("home/helpers/menu");
+    reg("home/partials/menu");
+    ASSERT_ANY_THROW(reg("home/index"));
+    
+    ASSERT_EQ(resolve("home/index"), "home/index");
+    ASSERT_EQ(resolve("home/nav"), "home/partials/nav");
+    ASSERT_EQ(resolve("home/sub/nav"), "home/partials/nav");
+    ASSERT_EQ(resolve("nav"), "partials/nav");
+    ASSERT_EQ(resolve("other/nav"), "partials/nav");
+    // the closest dir first, then partials, layouts and helpers
+    ASSERT_EQ(resolve("home/main"), "home/helpers/main");
+    ASSERT_EQ(resolve("main"), "layouts/main");
+    ASSERT_EQ(resolve("home/menu"), "home/partials/menu");
+    ASSERT_FALSE(engine->view_exists("home/missing"));
+    
+    // the resolved paths are forgotten once a view is registered
+    reg("home/sub/nav");
+    ASSERT_EQ(resolve("home/sub/nav"), "home/sub/nav");
+}
+
+TEST_F(fanjet_test, fragment_cache)
+{
+    evmvc::fragment_cache fc;
+    fc.put("nav:en", "<nav>en</nav>", 0, 64);
+    fc.put("nav:fr", "<nav>fr</nav>", 0, 64);
+    fc.put("foot", "<footer/>", 60, 64);
+    ASSERT_EQ(fc.count(), 3u);
+    ASSERT_STREQ(fc.get("nav:en")->c_str(), "<nav>en</nav>");
+    
+    // nav:fr is the least recently used
+    fc.put("menu", std::string(20, 'm'), 0, 64);
+    ASSERT_EQ(fc.get("nav:fr"), nullptr);
+    ASSERT_NE(fc.get("nav:en"), nullptr);
+    ASSERT_LE(fc.size(), 64u);
+    
+    ASSERT_EQ(fc.invalidate("nav:"), 1u);
+    ASSERT_EQ(fc.get("nav:en"), nullptr);
+    ASSERT_NE(fc.get("foot"), nullptr);
+    
+    fc.put("big", std::string(100, 'x'), 0, 64);
+    ASSERT_EQ(fc.get("big"), nullptr);
+}
+
+TEST_F(fanjet_test, hot_reload_stale_views)
+{
+    auto dir = evmvc::bfs::temp_directory_path() / evmvc::bfs::unique_path();
+    evmvc::bfs::create_directories(dir / fmt::format("{}-1", getpid()));
+    evmvc::bfs::create_directories(
+        dir / fmt::format("{}-2", std::numeric_limits<int>::max())
+    );
+    evmvc::bfs::create_directories(dir / "examples");
+    
+    // only the generations of the processes no longer running are removed
+    ASSERT_EQ(evmvc::fanjet::remove_stale_views(dir), 1u);
+    ASSERT_TRUE(evmvc::bfs::exists(dir / fmt::format("{}-1", getpid())));
+    ASSERT_TRUE(evmvc::bfs::exists(dir / "examples"));
+    ASSERT_EQ(evmvc::fanjet::remove_stale_views(dir / "missing"), 0u);
+    evmvc::bfs::remove_all(dir);
+}
+
+TEST_F(fanjet_test, hot_reload_library_release)
+{
+    auto gen = [](evmvc::sp_view_engine, const evmvc::response&){
+        return nullptr;
+    };
+    auto cur = std::make_shared<evmvc::fanjet::view_engine>("test");
+    cur->register_view_generator("home/index", gen);
+    
+    std::shared_ptr<void> lib = std::make_shared<int>(0);
+    {
+        auto fresh = std::make_shared<evmvc::fanjet::view_engine>("test");
+        fresh->retain_library(lib);
+        fresh->register_view_generator("home/index", gen);
+        fresh->register_view_generator("home/about", gen);
+        cur->swap_views(*fresh);
+    }
+    ASSERT_GT(lib.use_count(), 1);
+    ASSERT_TRUE(cur->view_exists("home/about"));
+    
+    // replaced, the library is no longer referenced by the engine
+    {
+        auto fresh = std::make_shared<evmvc::fanjet::view_engine>("test");
+        fresh->register_view_generator("home/index", gen);
+        cur->swap_views(*fresh);
+    }
+    ASSERT_EQ(lib.use_count(), 1);
+    ASSERT_FALSE(cur->view_exists("home/about"));
+}
+
+TEST_F(fanjet_test, hot_reload_unload)
+{
+    auto& libs = evmvc::fanjet::_internal::views_libs();
+    auto load = [&libs](const std::string& ns){
+        libs.push_back({
+            ns, "libm.so.6", dlopen("libm.so.6", RTLD_NOW),
+            std::make_shared<int>(0)
+        });
+        return libs.back().ref;
+    };
+    
+    load("a");
+    std::shared_ptr<void> used = load("a");
+    load("b");
+    load("a");
+    
+    // the current library and the ones still used by a view are kept
+    evmvc::fanjet::_internal::unload_views("a");
+    ASSERT_EQ(libs.size(), 3u);
+    ASSERT_EQ(libs[0].ref, used);
+    ASSERT_EQ(libs[1].ns, "b");
+    
+    used.reset();
+    evmvc::fanjet::_internal::unload_views("a");
+    ASSERT_EQ(libs.size(), 2u);
+    ASSERT_EQ(libs[1].ns, "a");
+    
+    for(auto& l : libs)
+        dlclose(l.handle);
+    libs.clear();
+}
+
+TEST_F(fanjet_test, stitch_partials)
+{
+    std::vector<evmvc::_internal::partial_slot> slots(2);
+    slots[0].data = "<nav/>";
+    slots[1].data = "<aside/>";
+    
+    // the page text may hold anything, the partials are placed
+    // by offset only
+    std::string inner = "<p>\x1a" "0\x1a</p>";
+    evmvc::_internal::partial_refs inner_refs = {{6, 1}, {10, 0}};
+    
+    std::string out = "<body>";
+    evmvc::_internal::partial_refs refs = {{6, 0}};
+    evmvc::_internal::append_partials(out, refs, inner, inner_refs);
+    out += "</body>";
+    ASSERT_EQ(refs.size(), 3u);
+    ASSERT_EQ(refs[1].offset, 12u);
+    ASSERT_EQ(refs[2].offset, 16u);
+    
+    evmvc::_internal::stitch_partials(out, refs, slots);
+    ASSERT_STREQ(
+        out.c_str(),
+        "<body><nav/><p>\x1a" "0\x1a<aside/></p><nav/></body>"
+    );
+    
+    std::string empty;
+    evmvc::_internal::stitch_partials(empty, {{0, 1}, {0, 0}}, slots);
+    ASSERT_EQ(empty, "<aside/><nav/>");
+}
+
 
 }} //ns evevmvc::tests
\ No newline at end of file
@@ -0,0 +1,286 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+#if EVMVC_TESTS_BROTLI_DECODER
+#include <brotli/decode.h>
+#endif
+
+namespace evmvc { namespace tests {
+
+
+class compression_test: public testing::Test
+{
+public:
+};
+
+static std::string decompress(evmvc::encoding_type type, evbuffer* buf)
+{
+    std::string in(evbuffer_get_length(buf), '\0');
+    evbuffer_remove(buf, &in[0], in.size());
+    std::string out;
+    char tmp[4096];
+    
+    switch(type){
+        case evmvc::encoding_type::gzip:
+        case evmvc::encoding_type::deflate:{
+            z_stream zs;
+            memset(&zs, 0, sizeof(zs));
+            inflateInit2(&zs,
+                type == evmvc::encoding_type::deflate ?
+                    EVMVC_ZLIB_DEFLATE_WSIZE : EVMVC_ZLIB_GZIP_WSIZE
+            );
+            zs.next_in = (Bytef*)in.data();
+            zs.avail_in = (uInt)in.size();
+            int ret = Z_OK;
+            while(ret == Z_OK){
+                zs.next_out = (Bytef*)tmp;
+                zs.avail_out = sizeof(tmp);
+                ret = inflate(&zs, Z_NO_FLUSH);
+                out.append(tmp, sizeof(tmp) - zs.avail_out);
+            }
+            inflateEnd(&zs);
+            EXPECT_EQ(ret, Z_STREAM_END);
+            break;
+        }
+    #if EVMVC_TESTS_BROTLI_DECODER
+        case evmvc::encoding_type::br:{
+            auto st = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+            size_t avail_in = in.size();
+            const uint8_t* next_in = (const uint8_t*)in.data();
+            auto ret = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+            while(ret == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT){
+                size_t avail_out = sizeof(tmp);
+                uint8_t* next_out = (uint8_t*)tmp;
+                ret = BrotliDecoderDecompressStream(
+                    st, &avail_in, &next_in, &avail_out, &next_out, nullptr
+                );
+                out.append(tmp, sizeof(tmp) - avail_out);
+            }
+            BrotliDecoderDestroyInstance(st);
+            EXPECT_EQ(ret, BROTLI_DECODER_RESULT_SUCCESS);
+            break;
+        }
+    #endif
+    #if EVMVC_HAS_ZSTD
+        case evmvc::encoding_type::zstd:{
+            auto ds = ZSTD_createDStream();
+            ZSTD_inBuffer zin = { in.data(), in.size(), 0 };
+            size_t ret = 1;
+            while(zin.pos < zin.size && !ZSTD_isError(ret)){
+                ZSTD_outBuffer zout = { tmp, sizeof(tmp), 0 };
+                ret = ZSTD_decompressStream(ds, &zout, &zin);
+                out.append(tmp, zout.pos);
+            }
+            ZSTD_freeDStream(ds);
+            EXPECT_EQ(ret, 0u);
+            break;
+        }
+    #endif
+        default:
+            ADD_FAILURE() << "no decoder for " << evmvc::to_string(type);
+    }
+    return out;
+}
+
+TEST_F(compression_test, round_trip)
+{
+    std::vector<evmvc::encoding_type> types = {
+        evmvc::encoding_type::gzip, evmvc::encoding_type::deflate
+    };
+#if EVMVC_TESTS_BROTLI_DECODER
+    types.emplace_back(evmvc::encoding_type::br);
+#endif
+#if EVMVC_HAS_ZSTD
+    types.emplace_back(evmvc::encoding_type::zstd);
+#endif
+    
+    std::string data;
+    for(int i = 0; data.size() < 100000; ++i)
+        data += fmt::format("<li class=\"item\">item {}</li>\n", i);
+    
+    evmvc::compression_options opts;
+    evmvc::compressor_pool pool;
+    evbuffer* out = evbuffer_new();
+    for(auto t : types){
+        auto c = pool.acquire(t, opts);
+        ASSERT_EQ(c->type(), t);
+        c->compress(data.data(), 10000, out, evmvc::compress_flush::none);
+        c->compress(data.data() + 10000, 100, out, evmvc::compress_flush::sync);
+        c->compress(
+            data.data() + 10100, data.size() - 10100, out,
+            evmvc::compress_flush::finish
+        );
+        ASSERT_LT(evbuffer_get_length(out), data.size() / 4);
+        ASSERT_EQ(decompress(t, out), data);
+        
+        // the released compressor is reset and reused
+        evmvc::compressor_t* p = c.get();
+        pool.release(std::move(c), opts.pool_size);
+        c = pool.acquire(t, opts);
+        ASSERT_EQ(c.get(), p);
+        c->compress(
+            data.data(), data.size(), out, evmvc::compress_flush::finish
+        );
+        ASSERT_EQ(decompress(t, out), data);
+        
+        // an empty body still produces a valid stream
+        pool.release(std::move(c), opts.pool_size);
+        c = pool.acquire(t, opts);
+        c->compress(nullptr, 0, out, evmvc::compress_flush::finish);
+        ASSERT_EQ(decompress(t, out), "");
+        
+        // the pool keeps at most pool_size idle compressors
+        auto c2 = pool.acquire(t, opts);
+        pool.release(std::move(c), 1);
+        pool.release(std::move(c2), 1);
+        c = pool.acquire(t, opts);
+        ASSERT_EQ(c.get(), p);
+        c2 = pool.acquire(t, opts);
+        ASSERT_NE(c2.get(), p);
+    }
+    evbuffer_free(out);
+}
+
+TEST_F(compression_test, negotiation)
+{
+    auto encs = [](const char* val){
+        return evmvc::header_t("Accept-Encoding", val).accept_encodings();
+    };
+    auto negotiate = [&encs](const char* val){
+        return evmvc::negotiate_encoding(encs(val));
+    };
+    
+    auto e = encs("gzip;q=0.5, x-gzip;q=0, br;q=0.9, deflate, zstd");
+    ASSERT_EQ(e.size(), 5u);
+    ASSERT_EQ(e[0].type, evmvc::encoding_type::deflate);
+    ASSERT_EQ(e[1].type, evmvc::encoding_type::zstd);
+    ASSERT_EQ(e[2].type, evmvc::encoding_type::br);
+    ASSERT_EQ(e[3].type, evmvc::encoding_type::gzip);
+    ASSERT_EQ(e[4].type, evmvc::encoding_type::gzip);
+    ASSERT_EQ(e[4].weight, 0);
+    
+#if EVMVC_HAS_BROTLI
+    ASSERT_EQ(negotiate("gzip, deflate, br"), evmvc::encoding_type::br);
+#else
+    ASSERT_EQ(negotiate("gzip, deflate, br"), evmvc::encoding_type::gzip);
+#endif
+    ASSERT_EQ(negotiate("deflate, gzip"), evmvc::encoding_type::gzip);
+    ASSERT_EQ(negotiate("br;q=0.1, deflate;q=0.8"),
+        evmvc::encoding_type::deflate
+    );
+    ASSERT_EQ(negotiate("gzip;q=0, deflate"), evmvc::encoding_type::deflate);
+    ASSERT_EQ(negotiate("identity"), evmvc::encoding_type::unsupported);
+    ASSERT_EQ(negotiate("gzip;q=0"), evmvc::encoding_type::unsupported);
+    
+    // "*" stands for the encodings that are not listed
+#if EVMVC_HAS_BROTLI
+    ASSERT_EQ(negotiate("*"), evmvc::encoding_type::br);
+#elif EVMVC_HAS_ZSTD
+    ASSERT_EQ(negotiate("*"), evmvc::encoding_type::zstd);
+#else
+    ASSERT_EQ(negotiate("*"), evmvc::encoding_type::gzip);
+#endif
+    auto e2 = negotiate("gzip;q=0, *");
+    ASSERT_NE(e2, evmvc::encoding_type::gzip);
+    ASSERT_NE(e2, evmvc::encoding_type::unsupported);
+    ASSERT_EQ(negotiate("gzip;q=0, br;q=0, zstd;q=0, *"),
+        evmvc::encoding_type::deflate
+    );
+    ASSERT_EQ(negotiate("gzip;q=0, deflate;q=0, br;q=0, zstd;q=0, *"),
+        evmvc::encoding_type::unsupported
+    );
+    ASSERT_EQ(negotiate("deflate;q=0.5, *;q=0.1"),
+        evmvc::encoding_type::deflate
+    );
+    
+    evmvc::compression_options opts;
+    ASSERT_TRUE(evmvc::compression_eligible(opts, 2048, "text/html"));
+    ASSERT_TRUE(
+        evmvc::compression_eligible(opts, 2048, "application/json")
+    );
+    ASSERT_FALSE(evmvc::compression_eligible(opts, 100, "text/html"));
+    ASSERT_FALSE(evmvc::compression_eligible(opts, 2048, "image/png"));
+    opts.enabled = false;
+    ASSERT_FALSE(evmvc::compression_eligible(opts, 2048, "text/html"));
+}
+
+TEST_F(compression_test, file_reply)
+{
+    std::string data;
+    for(int i = 0; data.size() < EVMVC_READ_BUF_SIZE * 20; ++i)
+        data += fmt::format(
+            "<tr><td>{}</td><td>{}</td></tr>\n", i, i * 7919
+        );
+    
+    auto path = evmvc::bfs::temp_directory_path() / "evmvc-file-reply.html";
+    FILE* f = fopen(path.c_str(), "w+");
+    ASSERT_NE(f, nullptr);
+    fwrite(data.data(), 1, data.size(), f);
+    rewind(f);
+    
+    evmvc::compression_options opts;
+    evmvc::file_reply fr(
+        nullptr, evmvc::wp_connection(), f, nullptr, nullptr
+    );
+    fr.zc = evmvc::_internal::compressors().acquire(
+        evmvc::encoding_type::gzip, opts
+    );
+    fr.zc_flush = evmvc::compress_flush::none;
+    fr.zc_pool_size = opts.pool_size;
+    
+    // every pass must queue output, the next pass is only triggered
+    // by the connection write callback
+    evbuffer* out = evbuffer_new();
+    size_t chunks = 0;
+    bool eof = false;
+    while(!eof){
+        eof = fr.read_chunk();
+        ASSERT_GT(evbuffer_get_length(fr.buffer), 0u);
+        evbuffer_add_buffer(out, fr.buffer);
+        ++chunks;
+    }
+    ASSERT_GT(chunks, 1u);
+    ASSERT_EQ(decompress(evmvc::encoding_type::gzip, out), data);
+    evbuffer_free(out);
+    evmvc::bfs::remove(path);
+}
+
+TEST_F(compression_test, file_reply_read_error)
+{
+    // reading a directory stream fails with EISDIR
+    auto path = evmvc::bfs::temp_directory_path();
+    FILE* f = fopen(path.c_str(), "r");
+    ASSERT_NE(f, nullptr);
+    
+    evmvc::file_reply fr(
+        nullptr, evmvc::wp_connection(), f, nullptr, nullptr
+    );
+    ASSERT_ANY_THROW(fr.read_chunk());
+    ASSERT_EQ(evbuffer_get_length(fr.buffer), 0u);
+}
+
+}} //ns evevmvc::tests
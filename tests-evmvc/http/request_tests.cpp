@@ -0,0 +1,91 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class request_test: public testing::Test
+{
+public:
+};
+
+TEST_F(request_test, http_params)
+{
+    evmvc::http_params_t p;
+    p.parse_urlencoded(std::string(
+        "a=1&b=2&c=3&d=4&e=5&f=6&g=7&h=8&i=9&j=-10&f1=1.5&bb=false&s=hi+there"
+    ));
+    
+    ASSERT_EQ(p.size(), 13u);
+    ASSERT_EQ(p.get<int32_t>("A", 0), 1);
+    ASSERT_EQ(p.get<int32_t>("j", 0), -10);
+    ASSERT_EQ(p.get<double>("f1", 0), 1.5);
+    ASSERT_EQ(p.get<bool>("bb", true), false);
+    ASSERT_STREQ(p.get<const char*>("s", ""), "hi there");
+    ASSERT_STREQ(p.get<std::string>("none", "def").c_str(), "def");
+    
+    evmvc::http_params_t m(std::move(p));
+    ASSERT_EQ(m.size(), 13u);
+    ASSERT_STREQ(m.get<const char*>("s", ""), "hi there");
+    
+    evmvc::http_params_t c(m);
+    ASSERT_EQ(c.size(), 13u);
+    ASSERT_EQ(c.get<int64_t>("i", 0), 9);
+}
+
+TEST_F(request_test, request_arena)
+{
+    std::weak_ptr<std::string> w;
+    {
+        auto ar = std::make_shared<evmvc::request_arena>(256);
+        for(int i = 0; i < 8; ++i){
+            auto s = std::allocate_shared<std::string>(
+                evmvc::arena_allocator<std::string>(ar), 64, 'x'
+            );
+            ASSERT_EQ((uintptr_t)s.get() % alignof(std::string), 0u);
+            w = s;
+        }
+        ASSERT_GT(ar->block_count(), 1u);
+        
+        // the recycled arena is merged in a single block
+        ar->rewind();
+        ASSERT_EQ(ar->block_count(), 1u);
+        ASSERT_EQ(ar->used(), 0u);
+        
+        auto s = std::allocate_shared<std::string>(
+            evmvc::arena_allocator<std::string>(ar), "kept"
+        );
+        w = s;
+        ar.reset();
+        
+        // the allocation keeps the arena alive
+        ASSERT_STREQ(w.lock()->c_str(), "kept");
+    }
+    ASSERT_TRUE(w.expired());
+}
+
+}} //ns evevmvc::tests
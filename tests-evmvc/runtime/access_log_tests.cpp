@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class access_log_test: public testing::Test
+{
+public:
+};
+
+TEST_F(access_log_test, write_record)
+{
+    evmvc::log_ring ring(4096);
+    ASSERT_TRUE(evmvc::write_access_record(
+        ring, 7, evmvc::method::get, "127.0.0.1", 8080, "/a\"b\\c\x01",
+        200, 1234, 56
+    ));
+    
+    std::vector<std::string> recs;
+    ASSERT_EQ(ring.drain([&](
+        md::log::log_level lvl, md::string_view path,
+        int64_t time, md::string_view msg
+    ){
+        // 2019-01-02T03:04:05.123Z
+        recs.emplace_back(evmvc::access_log_writer::to_json(
+            1546398245123000000, msg
+        ));
+    }), 1u);
+    ASSERT_STREQ(
+        recs[0].c_str(),
+        "{\"time\":\"2019-01-02T03:04:05.123Z\",\"id\":7,"
+        "\"method\":\"GET\",\"path\":\"/a\\\"b\\\\c\\u0001\","
+        "\"status\":200,\"bytes\":1234,\"duration_us\":56,"
+        "\"remote\":\"127.0.0.1\",\"port\":8080}\n"
+    );
+}
+
+}} //ns evevmvc::tests
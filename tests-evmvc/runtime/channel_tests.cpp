@@ -0,0 +1,54 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class channel_test: public testing::Test
+{
+public:
+};
+
+TEST_F(channel_test, command_payload)
+{
+    evmvc::command ping(evmvc::CMD_PING);
+    ASSERT_EQ(ping.size(), 0u);
+    ASSERT_EQ(ping.data(), nullptr);
+    
+    evmvc::command c(evmvc::CMD_LOG);
+    c.write(3).write(std::string("/path"));
+    ASSERT_EQ(c.size(), sizeof(int) + sizeof(size_t) + 5);
+    
+    // grows past the inline storage
+    c.write(std::string(EVMVC_CMD_INLINE_SIZE, 'x'));
+    evmvc::command r(c.id(), c.data(), c.size());
+    ASSERT_EQ(r.read<int>(), 3);
+    ASSERT_STREQ(r.read<std::string>().c_str(), "/path");
+    ASSERT_EQ(r.read<std::string>(), std::string(EVMVC_CMD_INLINE_SIZE, 'x'));
+}
+
+}} //ns evevmvc::tests
@@ -0,0 +1,64 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class clock_test: public testing::Test
+{
+public:
+};
+
+TEST_F(clock_test, http_date)
+{
+    ASSERT_STREQ(
+        evmvc::format_http_date(784111777).c_str(),
+        "Sun, 06 Nov 1994 08:49:37 GMT"
+    );
+    ASSERT_STREQ(
+        evmvc::format_http_date(951782400).c_str(),
+        "Tue, 29 Feb 2000 00:00:00 GMT"
+    );
+    
+    int64_t t = 0;
+    for(int64_t v = 0; v < 4102444800; v += 86400 * 7 + 3661){
+        ASSERT_TRUE(evmvc::parse_http_date(evmvc::format_http_date(v), t));
+        ASSERT_EQ(t, v);
+    }
+    ASSERT_FALSE(
+        evmvc::parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", t)
+    );
+    ASSERT_FALSE(evmvc::parse_http_date("Sun, 06 Nox 1994 08:49:37 GMT", t));
+    
+    auto dl = evmvc::_internal::coarse_clock().date_line();
+    ASSERT_EQ(dl.size(), 8u + EVMVC_HTTP_DATE_LEN);
+    ASSERT_TRUE(evmvc::parse_http_date(
+        evmvc::_internal::coarse_clock().date(), t
+    ));
+}
+
+}} //ns evevmvc::tests
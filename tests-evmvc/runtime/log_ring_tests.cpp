@@ -0,0 +1,88 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class log_ring_test: public testing::Test
+{
+public:
+};
+
+TEST_F(log_ring_test, write_drain)
+{
+    evmvc::log_ring ring(1024);
+    ASSERT_EQ(ring.max_msg_size(), 256u);
+    
+    ASSERT_TRUE(ring.write(md::log::log_level::info, "/a", "first"));
+    ASSERT_TRUE(ring.write(md::log::log_level::error, "/b", "second"));
+    ASSERT_TRUE(ring.write(md::log::log_level::info, "/a", "third"));
+    ASSERT_FALSE(ring.write(
+        md::log::log_level::info, "/a", std::string(300, 'x')
+    ));
+    
+    std::vector<std::string> recs;
+    auto fn = [&](
+        md::log::log_level lvl, md::string_view path,
+        int64_t time, md::string_view msg
+    ){
+        recs.emplace_back(path.to_string() + ":" + msg.to_string());
+    };
+    ASSERT_EQ(ring.drain(fn), 3u);
+    ASSERT_STREQ(recs[0].c_str(), "/a:first");
+    ASSERT_STREQ(recs[1].c_str(), "/b:second");
+    ASSERT_STREQ(recs[2].c_str(), "/a:third");
+    
+    // wraps around the end of the ring, full records are dropped
+    size_t written = 0;
+    while(ring.write(md::log::log_level::info, "/c", std::string(200, 'c')))
+        ++written;
+    recs.clear();
+    ASSERT_EQ(ring.drain(fn), written);
+    ASSERT_TRUE(ring.write(md::log::log_level::info, "/c", "last"));
+    ASSERT_EQ(ring.drain(fn), 1u);
+    ASSERT_STREQ(recs.back().c_str(), "/c:last");
+    
+    auto st = ring.get_stats();
+    ASSERT_EQ(st.written, 4u + written);
+    ASSERT_EQ(st.dropped, 1u);
+    ASSERT_EQ(st.oversized, 1u);
+    
+    // the path ids are reused once every slot was assigned
+    ASSERT_TRUE(ring.write(md::log::log_level::info, "", "empty"));
+    for(size_t i = 0; i < EVMVC_LOG_RING_PATHS; ++i){
+        ASSERT_TRUE(ring.write(
+            md::log::log_level::info, fmt::format("/p{}", i), "p"
+        ));
+        ring.drain(fn);
+    }
+    ASSERT_TRUE(ring.write(md::log::log_level::info, "", "again"));
+    ASSERT_EQ(ring.drain(fn), 1u);
+    ASSERT_STREQ(recs.back().c_str(), ":again");
+}
+
+}} //ns evevmvc::tests
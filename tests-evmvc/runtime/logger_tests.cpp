@@ -0,0 +1,72 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class logger_test: public testing::Test
+{
+public:
+};
+
+TEST_F(logger_test, lazy_cookies_logger)
+{
+    auto hdrs = std::make_shared<header_map_t>();
+    hdrs->emplace(std::make_pair(
+        std::string("cookie"), std::vector<std::string>{"a=1; b=2"}
+    ));
+    auto cks = std::make_shared<http_cookies_t>(
+        7, wp_connection(), evmvc::route(), hdrs
+    );
+    
+    ASSERT_TRUE(cks->exists("a"));
+    ASSERT_EQ(cks->get<std::string>(
+        "b", http_cookies_t::encoding::clear), "2"
+    );
+    
+    // without connection nor route, falls back on the default logger
+    md::log::logger log = cks->log();
+    ASSERT_TRUE(log != nullptr);
+    ASSERT_EQ(log, cks->log());
+}
+
+TEST_F(logger_test, lazy_cookies_logger_warn)
+{
+    auto hdrs = std::make_shared<header_map_t>();
+    hdrs->emplace(std::make_pair(
+        std::string("cookie"), std::vector<std::string>{"a=1; =2"}
+    ));
+    auto cks = std::make_shared<http_cookies_t>(
+        8, wp_connection(), evmvc::route(), hdrs
+    );
+    
+    // the invalid value is reported through the lazily created logger
+    ASSERT_FALSE(cks->exists("b"));
+    ASSERT_TRUE(cks->exists("a"));
+}
+
+}} //ns evevmvc::tests
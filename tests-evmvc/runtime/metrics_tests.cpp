@@ -0,0 +1,64 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class metrics_test: public testing::Test
+{
+public:
+};
+
+TEST_F(metrics_test, histogram)
+{
+    using evmvc::histogram_data;
+    for(uint64_t v = 0; v < 100000; ++v){
+        size_t i = histogram_data::bucket_index(v);
+        ASSERT_LT(v, histogram_data::bucket_upper(i));
+        if(i > 0)
+            ASSERT_GE(v, histogram_data::bucket_upper(i -1));
+    }
+    ASSERT_EQ(
+        histogram_data::bucket_index(UINT64_MAX),
+        (size_t)EVMVC_HISTOGRAM_BUCKETS -1
+    );
+    
+    auto h = std::make_unique<histogram_data>();
+    for(uint64_t v = 1; v <= 1000; ++v)
+        h->record(v);
+    
+    evmvc::histogram_snapshot s = {};
+    s.add(*h);
+    ASSERT_EQ(s.count, 1000u);
+    ASSERT_EQ(s.sum, 500500u);
+    // 25% precision
+    ASSERT_GE(s.quantile(0.5), 500u);
+    ASSERT_LE(s.quantile(0.5), 625u);
+    ASSERT_GE(s.quantile(1), 1000u);
+}
+
+}} //ns evevmvc::tests
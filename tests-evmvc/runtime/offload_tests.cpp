@@ -0,0 +1,128 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class offload_test: public testing::Test
+{
+public:
+    // the pool is process wide, the tests must not leak their settings
+    void SetUp()
+    {
+        _opts = evmvc::_internal::offload().options();
+    }
+    
+    void TearDown()
+    {
+        evmvc::_internal::offload().stop();
+        evmvc::_internal::offload().configure(_opts);
+    }
+    
+private:
+    evmvc::offload_options _opts;
+};
+
+TEST_F(offload_test, results)
+{
+    auto& m = evmvc::worker_metrics();
+    auto& pool = evmvc::_internal::offload();
+    uint64_t completed = m.offload_latency.count;
+    
+    evmvc::offload_options opts;
+    opts.threads = 2;
+    pool.configure(opts);
+    
+    int done = 0;
+    int val = 0;
+    std::string err_msg;
+    evmvc::offload<int>([](){ return 42;},
+    [&](const md::callback::cb_error& err, int v){
+        ASSERT_FALSE(err);
+        val = v;
+        if(++done == 2)
+            event_base_loopexit(evmvc::global::ev_base(), nullptr);
+    });
+    evmvc::offload([](){ throw std::runtime_error("offload {} error");},
+    [&](const md::callback::cb_error& err){
+        ASSERT_TRUE(err);
+        err_msg = err.c_str();
+        if(++done == 2)
+            event_base_loopexit(evmvc::global::ev_base(), nullptr);
+    });
+    event_base_dispatch(evmvc::global::ev_base());
+    
+    ASSERT_EQ(val, 42);
+    ASSERT_NE(err_msg.find("offload {} error"), std::string::npos);
+    ASSERT_EQ(m.offload_latency.count, completed +2);
+    ASSERT_EQ(m.offload_queued.load(), 0);
+}
+
+TEST_F(offload_test, send_log)
+{
+    auto& pool = evmvc::_internal::offload();
+    evmvc::offload_options oopts;
+    oopts.threads = 2;
+    pool.configure(oopts);
+    
+    evmvc::app_options opts;
+    auto w = std::make_shared<evmvc::http_worker_t>(
+        evmvc::wp_app(), opts, md::log::default_logger()
+    );
+    ASSERT_NE(w->log_ring(), nullptr);
+    
+    // the records are written to the ring by the event loop
+    bool on_loop = true;
+    evmvc::offload([&](){
+        on_loop = pool.on_loop();
+        for(int i = 0; i < 100; ++i)
+            w->send_log(
+                md::log::log_level::info, "/offload",
+                "offloaded log " + std::to_string(i)
+            );
+    },
+    [&](const md::callback::cb_error& err){
+        ASSERT_FALSE(err);
+        event_base_loopexit(evmvc::global::ev_base(), nullptr);
+    });
+    event_base_dispatch(evmvc::global::ev_base());
+    ASSERT_FALSE(on_loop);
+    
+    std::vector<std::string> msgs;
+    w->log_ring()->drain([&](
+        md::log::log_level lvl, md::string_view path,
+        int64_t time, md::string_view msg
+    ){
+        ASSERT_EQ(path, "/offload");
+        msgs.emplace_back(msg.data(), msg.size());
+    });
+    ASSERT_EQ(msgs.size(), 100U);
+    for(int i = 0; i < 100; ++i)
+        ASSERT_EQ(msgs[i], "offloaded log " + std::to_string(i));
+}
+
+}} //ns evevmvc::tests
@@ -0,0 +1,91 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class timer_wheel_test: public testing::Test
+{
+public:
+};
+
+TEST_F(timer_wheel_test, arm_cancel)
+{
+    size_t fired = 0;
+    auto cb = [](evmvc::wheel_timer* /*t*/, void* arg){
+        ++*(size_t*)arg;
+    };
+    
+    evmvc::wheel_timer a(cb, &fired), b(cb, &fired), c(cb, &fired);
+    a.arm(5);
+    b.arm(1);
+    c.arm(2);
+    ASSERT_EQ(evmvc::_internal::timers().size(), 3u);
+    
+    c.cancel();
+    ASSERT_FALSE(c.armed());
+    b.arm(10);
+    ASSERT_EQ(evmvc::_internal::timers().size(), 2u);
+    
+    auto start = evmvc::timer_wheel::clock_tick();
+    event_base_dispatch(evmvc::global::ev_base());
+    ASSERT_EQ(fired, 2u);
+    ASSERT_FALSE(a.armed() || b.armed());
+    ASSERT_GE(evmvc::timer_wheel::clock_tick() - start, 10u);
+    ASSERT_EQ(evmvc::_internal::timers().size(), 0u);
+}
+
+TEST_F(timer_wheel_test, long_delay)
+{
+    size_t fired = 0;
+    auto cb = [](evmvc::wheel_timer* /*t*/, void* arg){
+        ++*(size_t*)arg;
+    };
+    
+    // longer than the 2^24 ticks covered by the wheel
+    evmvc::timer_wheel tw;
+    evmvc::wheel_timer a(cb, &fired), b(cb, &fired);
+    uint64_t cur = 1000;
+    uint64_t da = (1ull << 24) + 5000;
+    uint64_t db = (1ull << 25) + 3;
+    tw.add(&a, da * EVMVC_TIMER_WHEEL_TICK_MS, cur);
+    tw.add(&b, db * EVMVC_TIMER_WHEEL_TICK_MS, cur);
+    
+    tw.run(cur + da -1);
+    ASSERT_EQ(fired, 0u);
+    tw.run(cur + da);
+    ASSERT_EQ(fired, 1u);
+    ASSERT_FALSE(a.armed());
+    
+    tw.run(cur + db -1);
+    ASSERT_EQ(fired, 1u);
+    tw.run(cur + db);
+    ASSERT_EQ(fired, 2u);
+    ASSERT_EQ(tw.size(), 0u);
+}
+
+}} //ns evevmvc::tests
@@ -0,0 +1,77 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class trace_test: public testing::Test
+{
+public:
+};
+
+TEST_F(trace_test, phases)
+{
+    evmvc::request_trace tr;
+    auto t0 = evmvc::request_trace::clock::now();
+    tr.begin(t0, false);
+    tr.mark(evmvc::trace_mark::headers);
+    ASSERT_EQ(tr.at(evmvc::trace_mark::headers), 0);
+    ASSERT_EQ(tr.phase_us(evmvc::trace_phase::parse), -1);
+    
+    tr.begin(t0 - std::chrono::milliseconds(2), true);
+    tr.mark(evmvc::trace_mark::headers);
+    tr.mark(evmvc::trace_mark::route);
+    tr.mark(evmvc::trace_mark::policies);
+    tr.mark(evmvc::trace_mark::handler);
+    tr.mark(evmvc::trace_mark::render_start);
+    tr.mark(evmvc::trace_mark::first_byte);
+    ASSERT_GE(tr.phase_us(evmvc::trace_phase::parse), 2000);
+    ASSERT_EQ(tr.phase_us(evmvc::trace_phase::handler), -1);
+    
+    std::string st = tr.server_timing();
+    ASSERT_EQ(st.find("parse;dur=2."), 0u);
+    ASSERT_NE(st.find(", policy;dur="), std::string::npos);
+    ASSERT_EQ(st.find("handler"), std::string::npos);
+    
+    // the render in progress ends with the response
+    tr.end();
+    ASSERT_GE(tr.phase_us(evmvc::trace_phase::handler), 0);
+    ASSERT_GE(tr.phase_us(evmvc::trace_phase::render), 0);
+    
+    evbuffer* b = evbuffer_new();
+    evmvc::tracer::chrome_events(
+        b, tr, 10, 3, 7, evmvc::method::get, "/a\"b", 200
+    );
+    std::string ev(evbuffer_get_length(b), '\0');
+    evbuffer_remove(b, &ev[0], ev.size());
+    evbuffer_free(b);
+    ASSERT_EQ(ev.find("{\"name\":\"GET /a\\\"b\",\"cat\":\"request\""), 0u);
+    ASSERT_NE(ev.find("\"args\":{\"id\":7,\"status\":200}"), std::string::npos);
+    ASSERT_EQ(std::count(ev.begin(), ev.end(), '\n'), 6);
+}
+
+}} //ns evevmvc::tests
@@ -0,0 +1,70 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class watchdog_test: public testing::Test
+{
+public:
+};
+
+TEST_F(watchdog_test, slow_callback)
+{
+    auto& m = evmvc::worker_metrics();
+    auto& wd = evmvc::_internal::watchdog();
+    uint64_t slow = m.slow_callbacks[(size_t)evmvc::callback_kind::view];
+    uint64_t ticks = m.loop_lag.count;
+    
+    evmvc::watchdog_options opts;
+    opts.enabled = true;
+    opts.interval_ms = 5;
+    opts.slow_ms = 10;
+    wd.start(opts, md::log::default_logger());
+    ASSERT_GT(m.heartbeat_ms.load(), 0);
+    
+    // blocks the loop between two ticks of the watchdog
+    event* ev = event_new(evmvc::global::ev_base(), -1, 0,
+    [](int, short, void*){
+        evmvc::callback_scope scope(evmvc::callback_kind::view, "home/index");
+        usleep(30000);
+        event_base_loopexit(evmvc::global::ev_base(), nullptr);
+    }, nullptr);
+    timeval tv = md::date::ms_to_timeval(12);
+    event_add(ev, &tv);
+    event_base_dispatch(evmvc::global::ev_base());
+    event_free(ev);
+    
+    ASSERT_EQ(m.slow_callbacks[(size_t)evmvc::callback_kind::view], slow +1);
+    ASSERT_STREQ(wd.last_slow().c_str(), "view 'home/index'");
+    ASSERT_GT(m.loop_lag.count, ticks);
+    
+    wd.stop();
+    ASSERT_EQ(m.heartbeat_ms.load(), 0);
+}
+
+}} //ns evevmvc::tests
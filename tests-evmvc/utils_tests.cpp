@@ -133,4 +133,48 @@ TEST_F(utils_test, html_unescape)
     );
 }
 
+TEST_F(utils_test, html_escape)
+{
+    ASSERT_STREQ(
+        evmvc::html_escape("<a href=\"x?a=1&b='2'\">plain text run</a>").c_str(),
+        "&lt;a href=&quot;x?a=1&amp;b=&#039;2&#039;&quot;&gt;"
+        "plain text run&lt;/a&gt;"
+    );
+
+    // the size is respected, not the null terminator
+    std::string s("ab<\0cd>", 7);
+    ASSERT_EQ(evmvc::html_escape(s), std::string("ab&lt;\0cd&gt;", 13));
+}
+
+TEST_F(utils_test, parse_urlencoded)
+{
+    std::string data =
+        "a=1&b=hello+world&c=%41%42%zz&&d&=x&e=a=b"
+        "&long_plain_key_without_any_escapes=long_value%20end";
+    
+    std::vector<std::pair<std::string, std::string>> pairs;
+    evmvc::parse_urlencoded(
+        &data[0], data.size(),
+        [&pairs](md::string_view k, md::string_view v){
+            EVMVC_COUT k.to_string() << ": " << v.to_string() << std::endl;
+            pairs.emplace_back(k.to_string(), v.to_string());
+        }
+    );
+    
+    ASSERT_EQ(pairs.size(), 7u);
+    ASSERT_STREQ(pairs[0].first.c_str(), "a");
+    ASSERT_STREQ(pairs[0].second.c_str(), "1");
+    ASSERT_STREQ(pairs[1].second.c_str(), "hello world");
+    ASSERT_STREQ(pairs[2].second.c_str(), "AB%zz");
+    ASSERT_STREQ(pairs[3].first.c_str(), "d");
+    ASSERT_STREQ(pairs[3].second.c_str(), "");
+    ASSERT_STREQ(pairs[4].first.c_str(), "");
+    ASSERT_STREQ(pairs[4].second.c_str(), "x");
+    ASSERT_STREQ(pairs[5].second.c_str(), "a=b");
+    ASSERT_STREQ(
+        pairs[6].first.c_str(), "long_plain_key_without_any_escapes"
+    );
+    ASSERT_STREQ(pairs[6].second.c_str(), "long_value end");
+}
+
 }} //ns evevmvc::tests
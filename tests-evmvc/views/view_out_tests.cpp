@@ -0,0 +1,115 @@
+/*
+MIT License
+
+Copyright (c) 2019 Michel Dénommée
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <gmock/gmock.h>
+#include "evmvc/evmvc.h"
+
+namespace evmvc { namespace tests {
+
+
+class view_out_test: public testing::Test
+{
+public:
+};
+
+TEST_F(view_out_test, stream)
+{
+    std::string data;
+    for(int i = 0; i < 64; ++i)
+        data += fmt::format("<li>{}</li>", i);
+    
+    // each flush is sent as a chunk, the output is drained by stream_write
+    evbuffer* sent = evbuffer_new();
+    std::vector<size_t> chunks;
+    evmvc::_internal::view_out out;
+    ASSERT_FALSE(out.streaming());
+    out.stream(256, [sent, &chunks](evbuffer* b){
+        chunks.push_back(evbuffer_get_length(b));
+        evbuffer_add_buffer(sent, b);
+    });
+    ASSERT_TRUE(out.streaming());
+    
+    out.append(data.data(), 100);
+    ASSERT_TRUE(chunks.empty());
+    out.move(data.substr(100, 200));
+    ASSERT_EQ(chunks.size(), 1u);
+    ASSERT_EQ(chunks[0], 300u);
+    out.append_escaped(data.substr(300));
+    out.flush();
+    ASSERT_EQ(out.size(), 0u);
+    
+    size_t len = evbuffer_get_length(sent);
+    std::string res(len, '\0');
+    evbuffer_copyout(sent, &res[0], len);
+    ASSERT_EQ(res, data.substr(0, 300) + evmvc::html_escape(data.substr(300)));
+    evbuffer_free(sent);
+}
+
+TEST_F(view_out_test, layouts_chain)
+{
+    auto str = [](evbuffer* b){
+        std::string s(evbuffer_get_length(b), '\0');
+        evbuffer_copyout(b, &s[0], s.size());
+        return s;
+    };
+    
+    // each layout references the output of its body, which already
+    // references the output of its own body and sections.
+    auto sec = std::make_shared<std::string>(1024, 's');
+    auto body = std::make_shared<evmvc::_internal::view_out>();
+    body->append("<p>", 3);
+    body->reference(sec, sec->data(), sec->size());
+    body->move(std::string(600, 'b'));
+    body->append("</p>", 4);
+    
+    auto inner = std::make_shared<evmvc::_internal::view_out>();
+    inner->append("<main>", 6);
+    inner->splice(body, body->buffer());
+    inner->append("</main>", 7);
+    
+    evmvc::_internal::view_out outer;
+    outer.append("<body>", 6);
+    outer.splice(inner, inner->buffer());
+    outer.append("</body>", 7);
+    
+    std::string expected = "<body><main><p>" + *sec +
+        std::string(600, 'b') + "</p></main></body>";
+    ASSERT_EQ(str(outer.buffer()), expected);
+    
+    // the output keeps the layouts alive until it is written
+    std::weak_ptr<evmvc::_internal::view_out> wbody = body;
+    body.reset();
+    inner.reset();
+    sec.reset();
+    ASSERT_FALSE(wbody.expired());
+    
+    evbuffer* conn = evbuffer_new();
+    evbuffer_add_buffer(conn, outer.buffer());
+    ASSERT_EQ(str(conn), expected);
+    evbuffer_free(conn);
+    ASSERT_TRUE(wbody.expired());
+}
+
+
+}} //ns evevmvc::tests